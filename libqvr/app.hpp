@@ -31,6 +31,7 @@ class QMouseEvent;
 class QWheelEvent;
 class QMatrix4x4;
 template <typename T> class QList;
+template <typename T> class QVector;
 
 class QVRDevice;
 class QVRDeviceEvent;
@@ -269,6 +270,20 @@ public:
      */
     virtual void deserializeStaticData(QDataStream& ds) { Q_UNUSED(ds); }
 
+    /*!
+     * \brief Handle a child process that rejoined after it was relaunched.
+     * \param p         The child process
+     *
+     * Only implement this if you want to support multi-process configurations
+     * and your serializeDynamicData() only transfers data that changed since
+     * the previous frame. The rejoined process missed all previous frames, so
+     * the next call to serializeDynamicData() must transfer the complete dynamic
+     * state again.
+     *
+     * This function is called on the main process before the next frame.
+     */
+    virtual void processRejoined(QVRProcess* p) { Q_UNUSED(p); }
+
     /*!
      * \brief Handle a key press event.
      * \param context   The context that this event originated from
@@ -353,6 +368,27 @@ public:
      */
     virtual void wheelEvent(const QVRRenderContext& context, QWheelEvent* event) { Q_UNUSED(context); Q_UNUSED(event); }
 
+    /*!
+     * \brief Process device samples.
+     * \param samples   The device samples, in the order in which they were taken
+     *
+     * If a device sampling rate is set (see \a QVRManager::QVRManager()), the
+     * \a QVRManager updates suitable devices at that rate in a separate thread,
+     * independent of the frame rate. This function receives all samples that
+     * were taken since the previous frame. Use \a QVRDevice::index() to find
+     * out which device a sample belongs to, and \a QVRDevice::timestamp()
+     * to find out when it was taken.
+     *
+     * The devices returned by \a QVRManager::device() always represent the
+     * latest sample, so this function is only needed to make use of the full
+     * sampling rate, e.g. for pose histories or fast interaction.
+     *
+     * This function is called once before each frame on the main process,
+     * before the device events are handled and before update(). It is not
+     * called if there are no new samples.
+     */
+    virtual void deviceSamples(const QVector<QVRDevice>& samples) { Q_UNUSED(samples); }
+
     /*!
      * \brief Handle a device button press event.
      * \param event     The event
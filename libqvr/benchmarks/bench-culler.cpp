@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro benchmark: view frustum culling.
+ * Tests 100000 bounding spheres and boxes, scattered around the viewer,
+ * against one frustum, once object by object with isSphereVisible() and
+ * isBoxVisible(), and once with the batch functions cullSpheres() and
+ * cullBoxes(). */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+
+#include "culler.hpp"
+
+static float randomFloat(float lo, float hi)
+{
+    return lo + (hi - lo) * (std::rand() / float(RAND_MAX));
+}
+
+int main(void)
+{
+    const int N = 100;
+    const int ObjectCount = 100000;
+
+    QVector<float> x(ObjectCount), y(ObjectCount), z(ObjectCount), radius(ObjectCount);
+    QVector<float> minX(ObjectCount), minY(ObjectCount), minZ(ObjectCount);
+    QVector<float> maxX(ObjectCount), maxY(ObjectCount), maxZ(ObjectCount);
+    std::srand(42);
+    for (int i = 0; i < ObjectCount; i++) {
+        x[i] = randomFloat(-100.0f, 100.0f);
+        y[i] = randomFloat(-100.0f, 100.0f);
+        z[i] = randomFloat(-100.0f, 100.0f);
+        radius[i] = randomFloat(0.1f, 2.0f);
+        minX[i] = x[i] - radius[i];
+        minY[i] = y[i] - radius[i];
+        minZ[i] = z[i] - radius[i];
+        maxX[i] = x[i] + radius[i];
+        maxY[i] = y[i] + radius[i];
+        maxZ[i] = z[i] + radius[i];
+    }
+    QVector<unsigned char> visible(ObjectCount);
+
+    QMatrix4x4 projectionViewMatrix;
+    projectionViewMatrix.perspective(90.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    projectionViewMatrix.lookAt(QVector3D(0.0f, 1.7f, 0.0f), QVector3D(0.0f, 1.7f, -1.0f), QVector3D(0.0f, 1.0f, 0.0f));
+    QVRCuller culler(projectionViewMatrix);
+
+    QElapsedTimer timer;
+    long long visibleCount[4] = { 0, 0, 0, 0 };
+    qint64 nsecs[4];
+
+    timer.start();
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < ObjectCount; j++)
+            visibleCount[0] += culler.isSphereVisible(QVector3D(x[j], y[j], z[j]), radius[j]);
+    nsecs[0] = timer.nsecsElapsed();
+    timer.start();
+    for (int i = 0; i < N; i++)
+        visibleCount[1] += culler.cullSpheres(ObjectCount, x.constData(), y.constData(), z.constData(),
+                radius.constData(), visible.data());
+    nsecs[1] = timer.nsecsElapsed();
+    timer.start();
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < ObjectCount; j++)
+            visibleCount[2] += culler.isBoxVisible(QVector3D(minX[j], minY[j], minZ[j]), QVector3D(maxX[j], maxY[j], maxZ[j]));
+    nsecs[2] = timer.nsecsElapsed();
+    timer.start();
+    for (int i = 0; i < N; i++)
+        visibleCount[3] += culler.cullBoxes(ObjectCount, minX.constData(), minY.constData(), minZ.constData(),
+                maxX.constData(), maxY.constData(), maxZ.constData(), visible.data());
+    nsecs[3] = timer.nsecsElapsed();
+
+    const char* names[4] = { "spheres, one by one", "spheres, batched", "boxes, one by one", "boxes, batched" };
+    for (int k = 0; k < 4; k++) {
+        std::printf("%-20s %.2f ns per object (%lld visible)\n", names[k],
+                nsecs[k] / double(N) / ObjectCount, visibleCount[k] / N);
+    }
+    return 0;
+}
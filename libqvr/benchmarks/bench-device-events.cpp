@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro benchmark: device event generation in the main process.
+ * Compares the previous change detection (compare every button and analog
+ * through the accessors, then copy the whole device into a list of last
+ * states) with QVRDeviceEventDetector as used by QVRManager (one XOR of the
+ * button bits and one memcmp of the analog values per device). Both enqueue
+ * their events into an event queue, which is emptied after each frame like
+ * the main loop does. The setup is 32 devices with the maximum number of
+ * buttons (QVR_Button_Unknown, since buttons are packed into 32 bits) and
+ * 8 analogs, in a frame where nothing changed and in a frame where one button
+ * and one analog of every device changed. */
+
+#include <cstdio>
+
+#include <QElapsedTimer>
+#include <QList>
+
+#include "event.hpp"
+#include "benchdevice.hpp"
+
+static const int DeviceCount = 32;
+static const int ButtonCount = QVR_Button_Unknown;
+static const int AnalogCount = QVR_Analog_Unknown;
+
+static QVRDevice makeDevice(int index, quint32 buttons, float analog)
+{
+    QVRDeviceWireData w;
+    QVRBenchInitDeviceWireData(&w, index, ButtonCount, AnalogCount);
+    w.buttons = buttons;
+    for (int i = 0; i < AnalogCount; i++)
+        w.analogs[i] = analog;
+    return QVRBenchDevice(w);
+}
+
+static void legacyDetect(const QList<QVRDevice>& devices, QList<QVRDevice>& lastStates,
+        QVREventRing* queue)
+{
+    for (int d = 0; d < devices.size(); d++) {
+        for (int b = 0; b < devices[d].buttonCount(); b++) {
+            if (lastStates[d].isButtonPressed(b) != devices[d].isButtonPressed(b)) {
+                QVRDeviceEvent e(devices[d], b, -1);
+                if (devices[d].isButtonPressed(b))
+                    queue->enqueue(QVREvent(QVR_Event_DeviceButtonPress, e));
+                else
+                    queue->enqueue(QVREvent(QVR_Event_DeviceButtonRelease, e));
+            }
+        }
+        for (int a = 0; a < devices[d].analogCount(); a++) {
+            if (lastStates[d].analogValue(a) != devices[d].analogValue(a)) {
+                queue->enqueue(QVREvent(QVR_Event_DeviceAnalogChange,
+                            QVRDeviceEvent(devices[d], -1, a)));
+            }
+        }
+        lastStates[d] = devices[d];
+    }
+}
+
+static int drain(QVREventRing* queue)
+{
+    int events = queue->size();
+    while (!queue->empty())
+        queue->dequeue();
+    return events;
+}
+
+int main(void)
+{
+    const int N = 100000;
+    QList<QVRDevice> frames[2];
+    for (int d = 0; d < DeviceCount; d++) {
+        frames[0].append(makeDevice(d, 0x0, 0.0f));
+        frames[1].append(makeDevice(d, 0x1, 0.5f));
+    }
+
+    for (int changing = 0; changing <= 1; changing++) {
+        QElapsedTimer timer;
+        QVREventRing queue;
+        long long events = 0;
+
+        QList<QVRDevice> lastStates = frames[0];
+        timer.start();
+        for (int i = 0; i < N; i++) {
+            legacyDetect(frames[changing ? i % 2 : 0], lastStates, &queue);
+            events += drain(&queue);
+        }
+        qint64 legacyNsecs = timer.nsecsElapsed();
+
+        QVRDeviceEventDetector detector;
+        for (int d = 0; d < DeviceCount; d++)
+            detector.addDevice(frames[0][d]);
+        timer.start();
+        for (int i = 0; i < N; i++) {
+            const QList<QVRDevice>& devices = frames[changing ? i % 2 : 0];
+            for (int d = 0; d < devices.size(); d++)
+                detector.detect(d, devices[d], &queue);
+            events += drain(&queue);
+        }
+        qint64 packedNsecs = timer.nsecsElapsed();
+
+        std::printf("%d devices x %d buttons x %d analogs, %s:\n",
+                DeviceCount, ButtonCount, AnalogCount,
+                changing ? "all devices change" : "no changes");
+        std::printf("  per-element compare + copy: %.1f ns per frame\n", legacyNsecs / double(N));
+        std::printf("  QVRDeviceEventDetector:     %.1f ns per frame\n", packedNsecs / double(N));
+        std::printf("  (%lld events)\n", events);
+    }
+    return 0;
+}
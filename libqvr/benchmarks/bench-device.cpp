@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro benchmark: serialization of QVRDevice for IPC.
+ * Compares the fixed-layout wire format with the previous field-by-field
+ * QDataStream encoding (floats as doubles, length-prefixed QVectors) for a
+ * gamepad-like device with 18 buttons and 6 analogs. */
+
+#include <cstdio>
+
+#include <QByteArray>
+#include <QBuffer>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include "benchdevice.hpp"
+
+static void writeLegacy(QDataStream& ds, const QVRDevice& d,
+        const signed char* buttonsMap, const signed char* analogsMap)
+{
+    QVector<bool> buttons(d.buttonCount());
+    for (int i = 0; i < d.buttonCount(); i++)
+        buttons[i] = d.isButtonPressed(i);
+    QVector<float> analogs(d.analogCount());
+    for (int i = 0; i < d.analogCount(); i++)
+        analogs[i] = d.analogValue(i);
+    ds << d.index() << d.position() << d.orientation() << d.velocity() << d.angularVelocity()
+        << buttons << analogs;
+    ds.writeRawData(reinterpret_cast<const char*>(buttonsMap), QVR_Button_Unknown);
+    ds.writeRawData(reinterpret_cast<const char*>(analogsMap), QVR_Analog_Unknown);
+}
+
+static void readLegacy(QDataStream& ds, int* index, QVector3D* p, QQuaternion* o,
+        QVector3D* v, QVector3D* av, QVector<bool>* buttons, QVector<float>* analogs,
+        signed char* buttonsMap, signed char* analogsMap)
+{
+    ds >> *index >> *p >> *o >> *v >> *av >> *buttons >> *analogs;
+    ds.readRawData(reinterpret_cast<char*>(buttonsMap), QVR_Button_Unknown);
+    ds.readRawData(reinterpret_cast<char*>(analogsMap), QVR_Analog_Unknown);
+}
+
+int main(void)
+{
+    const int N = 1000000;
+
+    // Create a device with 18 buttons and 6 analogs via the wire format
+    QVRDeviceWireData w;
+    QVRBenchInitDeviceWireData(&w, 0, 18, 6);
+    w.buttons = 0x15;
+    for (int i = 0; i < 6; i++)
+        w.analogs[i] = 0.1f * i;
+    QVRDevice device = QVRBenchDevice(w);
+
+    QByteArray buf;
+    buf.reserve(4096);
+    QElapsedTimer timer;
+
+    // Legacy encoding
+    qint64 legacyBytes = 0;
+    timer.start();
+    for (int i = 0; i < N; i++) {
+        buf.resize(0);
+        QBuffer b(&buf);
+        b.open(QIODevice::WriteOnly);
+        QDataStream ds(&b);
+        writeLegacy(ds, device, w.buttonsMap, w.analogsMap);
+        legacyBytes = buf.size();
+    }
+    qint64 legacyWriteNsecs = timer.nsecsElapsed();
+    {
+        int index;
+        QVector3D p, v, av;
+        QQuaternion o;
+        signed char bm[QVR_Button_Unknown], am[QVR_Analog_Unknown];
+        timer.start();
+        for (int i = 0; i < N; i++) {
+            QVector<bool> buttons;
+            QVector<float> analogs;
+            QDataStream ds(buf);
+            readLegacy(ds, &index, &p, &o, &v, &av, &buttons, &analogs, bm, am);
+        }
+    }
+    qint64 legacyReadNsecs = timer.nsecsElapsed();
+
+    // Wire format
+    qint64 wireBytes = 0;
+    timer.start();
+    for (int i = 0; i < N; i++) {
+        buf.resize(0);
+        QBuffer b(&buf);
+        b.open(QIODevice::WriteOnly);
+        QDataStream ds(&b);
+        ds << device;
+        wireBytes = buf.size();
+    }
+    qint64 wireWriteNsecs = timer.nsecsElapsed();
+    QVRDevice target = device;
+    timer.start();
+    for (int i = 0; i < N; i++) {
+        QDataStream ds(buf);
+        ds >> target;
+    }
+    qint64 wireReadNsecs = timer.nsecsElapsed();
+
+    std::printf("legacy encoding: %lld bytes, %.1f ns write, %.1f ns read per device\n",
+            static_cast<long long>(legacyBytes),
+            legacyWriteNsecs / double(N), legacyReadNsecs / double(N));
+    std::printf("wire format:     %lld bytes, %.1f ns write, %.1f ns read per device\n",
+            static_cast<long long>(wireBytes),
+            wireWriteNsecs / double(N), wireReadNsecs / double(N));
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro benchmark: off-axis projections for screen walls.
+ * Compares the previous per-view computation (QVector3D math and
+ * QQuaternion::fromDirection(), as formerly done in QVRWindow) with the
+ * batched QVROffAxisSolver, for 64 screen walls with 2 eyes each. */
+
+#include <cstdio>
+
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QVector3D>
+
+#include "offaxis.hpp"
+
+static const int WallCount = 64;
+static const int EyeCount = 2;
+
+static float perViewComputation(const QVector3D& wallBl, const QVector3D& wallBr, const QVector3D& wallTl,
+        const QVector3D& eyePosition, float n, float f)
+{
+    QVector3D bl = wallBl - eyePosition;
+    QVector3D br = wallBr - eyePosition;
+    QVector3D tl = wallTl - eyePosition;
+    QVector3D planeRight = (br - bl).normalized();
+    QVector3D planeUp = (tl - bl).normalized();
+    QVector3D planeNormal = QVector3D::crossProduct(planeUp, planeRight);
+    float planeDistance = QVector3D::dotProduct(planeNormal, bl);
+    float width = (br - bl).length();
+    float height = (tl - bl).length();
+    float l = -QVector3D::dotProduct(-bl, planeRight);
+    float r = width + l;
+    float b = -QVector3D::dotProduct(-bl, planeUp);
+    float t = height + b;
+    float q = n / planeDistance;
+    QVRFrustum frustum(l * q, r * q, b * q, t * q, n, f);
+    QVector3D eyeProjection = -QVector3D::dotProduct(-bl, planeNormal) * planeNormal;
+    QQuaternion viewRot = QQuaternion::fromDirection(-eyeProjection, planeUp);
+    QMatrix4x4 viewMatrixPure;
+    viewMatrixPure.rotate(viewRot.inverted());
+    viewMatrixPure.translate(-eyePosition);
+    return frustum.leftPlane() + viewMatrixPure(0, 3);
+}
+
+int main(void)
+{
+    const int N = 20000;
+    const float n = 0.1f, f = 100.0f;
+
+    // Walls on a circle around the origin, eyes near the center
+    QVector3D wallBl[WallCount], wallBr[WallCount], wallTl[WallCount];
+    for (int w = 0; w < WallCount; w++) {
+        QQuaternion rot = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, w * 360.0f / WallCount);
+        wallBl[w] = rot.rotatedVector(QVector3D(-0.5f, 0.0f, -2.0f));
+        wallBr[w] = rot.rotatedVector(QVector3D(+0.5f, 0.0f, -2.0f));
+        wallTl[w] = rot.rotatedVector(QVector3D(-0.5f, 2.0f, -2.0f));
+    }
+    QVector3D eye[EyeCount] = { QVector3D(-0.032f, 1.7f, 0.1f), QVector3D(+0.032f, 1.7f, 0.1f) };
+
+    QElapsedTimer timer;
+    float sum = 0.0f;
+
+    timer.start();
+    for (int i = 0; i < N; i++)
+        for (int w = 0; w < WallCount; w++)
+            for (int e = 0; e < EyeCount; e++)
+                sum += perViewComputation(wallBl[w], wallBr[w], wallTl[w], eye[e], n, f);
+    qint64 perViewNsecs = timer.nsecsElapsed();
+
+    QVROffAxisSolver solver;
+    timer.start();
+    for (int i = 0; i < N; i++) {
+        solver.clear();
+        for (int w = 0; w < WallCount; w++)
+            for (int e = 0; e < EyeCount; e++)
+                solver.addView(wallBl[w], wallBr[w], wallTl[w], eye[e]);
+        solver.solve();
+        for (int v = 0; v < WallCount * EyeCount; v++)
+            sum += solver.frustum(v, n, f).leftPlane() + solver.viewMatrixPure(v)(0, 3);
+    }
+    qint64 batchedNsecs = timer.nsecsElapsed();
+
+    std::printf("%d walls x %d eyes:\n", WallCount, EyeCount);
+    std::printf("  per view: %.2f us per frame\n", perViewNsecs / 1e3 / N);
+    std::printf("  batched:  %.2f us per frame\n", batchedNsecs / 1e3 / N);
+    std::printf("  (checksum %g)\n", sum);
+    return 0;
+}
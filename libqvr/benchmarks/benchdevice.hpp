@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_BENCHDEVICE_HPP
+#define QVR_BENCHDEVICE_HPP
+
+/* Shared fixture of the device benchmarks. Devices are created via the wire
+ * format, since the device internals are private. */
+
+#include <cstring>
+
+#include <QByteArray>
+#include <QDataStream>
+
+#include "device.hpp"
+#include "devicewire.hpp"
+
+/* Initialize the wire data of a device at the origin with the given number of
+ * buttons and analogs, all released or zero, each mapped to its own index. */
+static inline void QVRBenchInitDeviceWireData(QVRDeviceWireData* w,
+        int index, int buttonCount, int analogCount)
+{
+    std::memset(w, 0, sizeof(*w));
+    w->index = index;
+    w->orientation[0] = 1.0f;
+    w->buttonCount = buttonCount;
+    w->analogCount = analogCount;
+    for (int i = 0; i < QVR_Button_Unknown; i++)
+        w->buttonsMap[i] = (i < buttonCount ? i : -1);
+    for (int i = 0; i < QVR_Analog_Unknown; i++)
+        w->analogsMap[i] = (i < analogCount ? i : -1);
+}
+
+/* Create a device from its wire data. */
+static inline QVRDevice QVRBenchDevice(const QVRDeviceWireData& w)
+{
+    QByteArray a(reinterpret_cast<const char*>(&w), sizeof(w));
+    QDataStream ds(a);
+    QVRDevice d;
+    ds >> d;
+    return d;
+}
+
+#endif
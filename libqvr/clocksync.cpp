@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#include "clocksync.hpp"
+
+
+/* Number of recent exchanges that the estimator considers */
+static const int QVRClockMaxSamples = 32;
+/* Exchanges with a delay of up to twice the minimum delay plus this tolerance
+ * are considered good enough */
+static const qint64 QVRClockDelayToleranceNsecs = 50000;
+/* Drift is only estimated from good exchanges that span at least this time */
+static const qint64 QVRClockMinDriftSpanNsecs = 10000000000;
+/* Larger drift estimates are considered bogus; real clocks drift much less */
+static const double QVRClockMaxDrift = 500e-6;
+
+QVRClusterClock::QVRClusterClock() :
+    _sequence(0),
+    _offset(0),
+    _driftBits(0), // bit pattern of 0.0
+    _reference(0)
+{
+}
+
+void QVRClusterClock::set(qint64 offset, double drift, qint64 reference)
+{
+    qint64 driftBits;
+    std::memcpy(&driftBits, &drift, sizeof(qint64));
+    // The first increment is ordered, so the stores below cannot move before it,
+    // and the second one is ordered, so they cannot move after it.
+    _sequence.fetchAndAddOrdered(1);
+    _offset.store(offset);
+    _driftBits.store(driftBits);
+    _reference.store(reference);
+    _sequence.fetchAndAddOrdered(1);
+}
+
+qint64 QVRClusterClock::toClusterTime(qint64 localNsecs) const
+{
+    qint64 offset;
+    qint64 driftBits;
+    qint64 reference;
+    int sequence;
+    do {
+        sequence = _sequence.loadAcquire();
+        offset = _offset.load();
+        driftBits = _driftBits.load();
+        reference = _reference.load();
+        // keep the loads above from moving after the second sequence load
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != _sequence.load());
+    double drift;
+    std::memcpy(&drift, &driftBits, sizeof(double));
+    return localNsecs + offset + static_cast<qint64>(drift * (localNsecs - reference));
+}
+
+QVRClockEstimator::QVRClockEstimator()
+{
+    _samples.reserve(QVRClockMaxSamples + 1);
+    _selected.reserve(QVRClockMaxSamples);
+}
+
+void QVRClockEstimator::addSample(qint64 t1, qint64 t2, qint64 t3, qint64 t4)
+{
+    Sample s;
+    s.childTime = t2 + (t3 - t2) / 2;
+    s.offset = ((t1 - t2) + (t4 - t3)) / 2;
+    s.delay = (t4 - t1) - (t3 - t2);
+    _samples.append(s);
+    if (_samples.size() > QVRClockMaxSamples)
+        _samples.removeFirst();
+}
+
+void QVRClockEstimator::estimate(qint64* offset, double* drift, qint64* reference, qint64* delay)
+{
+    Q_ASSERT(isValid());
+
+    // Select the exchanges with a short delay
+    qint64 minDelay = std::numeric_limits<qint64>::max();
+    int minDelayIndex = 0;
+    for (int i = 0; i < _samples.size(); i++) {
+        if (_samples[i].delay < minDelay) {
+            minDelay = _samples[i].delay;
+            minDelayIndex = i;
+        }
+    }
+    _selected.clear();
+    for (int i = 0; i < _samples.size(); i++)
+        if (_samples[i].delay <= 2 * minDelay + QVRClockDelayToleranceNsecs)
+            _selected.append(_samples[i]);
+
+    *reference = _samples.last().childTime;
+    *delay = minDelay;
+    *offset = _samples[minDelayIndex].offset;
+    *drift = 0.0;
+
+    // Fit offset = a + b * (childTime - reference) to the selected exchanges
+    if (_selected.size() >= 4
+            && _selected.last().childTime - _selected.first().childTime >= QVRClockMinDriftSpanNsecs) {
+        double meanX = 0.0, meanY = 0.0;
+        for (int i = 0; i < _selected.size(); i++) {
+            meanX += _selected[i].childTime - *reference;
+            meanY += _selected[i].offset - _samples[minDelayIndex].offset;
+        }
+        meanX /= _selected.size();
+        meanY /= _selected.size();
+        double sxy = 0.0, sxx = 0.0;
+        for (int i = 0; i < _selected.size(); i++) {
+            double dx = (_selected[i].childTime - *reference) - meanX;
+            double dy = (_selected[i].offset - _samples[minDelayIndex].offset) - meanY;
+            sxy += dx * dy;
+            sxx += dx * dx;
+        }
+        double b = sxy / sxx;
+        if (b >= -QVRClockMaxDrift && b <= QVRClockMaxDrift) {
+            *drift = b;
+            *offset = _samples[minDelayIndex].offset + static_cast<qint64>(meanY - b * meanX);
+        }
+    }
+}
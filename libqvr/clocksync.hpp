@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_CLOCKSYNC_HPP
+#define QVR_CLOCKSYNC_HPP
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QVector>
+
+/* Clock synchronization between the main process and its child processes.
+ *
+ * The cluster time is the QVRTimer time of the main process. Each child process
+ * maps its own QVRTimer time t to cluster time as
+ *   t + offset + drift * (t - reference)
+ * where offset, drift, and reference are estimated by the main process from
+ * NTP-like exchanges of timestamps over the IPC channel: the main process sends
+ * T1, the child notes its receive time T2 and its reply time T3, and the main
+ * process notes the arrival time T4 of the reply. Then the child's offset to
+ * main is ((T1 - T2) + (T4 - T3)) / 2, and the round trip delay is
+ * (T4 - T1) - (T3 - T2). Exchanges with a short delay give the best offsets,
+ * so the estimator prefers those.
+ *
+ * These interfaces are only used internally. */
+
+/* The mapping of the local QVRTimer to cluster time. It can be updated by one
+ * thread while other threads use it. This is a sequence lock: readers retry if
+ * an update happened while they read. The fields are atomic (with relaxed
+ * ordering) so that concurrent reads and writes are not a data race; the drift
+ * is stored as the bit pattern of the double. */
+class QVRClusterClock
+{
+private:
+    QAtomicInt _sequence; // odd while an update is in progress
+    QAtomicInteger<qint64> _offset;
+    QAtomicInteger<qint64> _driftBits;
+    QAtomicInteger<qint64> _reference;
+
+public:
+    QVRClusterClock();
+
+    void set(qint64 offset, double drift, qint64 reference);
+    qint64 toClusterTime(qint64 localNsecs) const;
+};
+
+/* Estimation of the clock offset and drift of one child process, on the main
+ * process. */
+class QVRClockEstimator
+{
+private:
+    struct Sample {
+        qint64 childTime; // midpoint of T2 and T3
+        qint64 offset;
+        qint64 delay;
+    };
+    QVector<Sample> _samples; // the most recent samples, oldest first
+    QVector<Sample> _selected;
+
+public:
+    QVRClockEstimator();
+
+    /* Add the timestamps of one exchange. T1 and T4 are in main process time,
+     * T2 and T3 in child process time. */
+    void addSample(qint64 t1, qint64 t2, qint64 t3, qint64 t4);
+
+    /* Whether there are enough samples for an estimate. */
+    bool isValid() const { return _samples.size() > 0; }
+
+    /* Estimate the offset and drift for mapping child time to cluster time
+     * (see QVRClusterClock). The delay is the smallest recent round trip delay,
+     * which bounds the error of the offset. */
+    void estimate(qint64* offset, double* drift, qint64* reference, qint64* delay);
+};
+
+#endif
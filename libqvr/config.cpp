@@ -25,6 +25,7 @@
 #include <cstring>
 
 #include <QFile>
+#include <QDataStream>
 #include <QTextStream>
 
 #include "config.hpp"
@@ -718,3 +719,115 @@ bool QVRConfig::readFromFile(const QString& filename)
     }
     return true;
 }
+
+/* Serialization of configurations. This is used by the main process to send
+ * its configuration to child processes, so that these do not have to read
+ * and parse the configuration file themselves. Enumerations are written as
+ * 32 bit integers. */
+
+QDataStream &operator<<(QDataStream& ds, const QVRDeviceConfig& c)
+{
+    ds << c._id << c._processIndex
+        << static_cast<qint32>(c._trackingType) << c._trackingParameters
+        << static_cast<qint32>(c._buttonsType) << c._buttonsParameters
+        << static_cast<qint32>(c._analogsType) << c._analogsParameters;
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRDeviceConfig& c)
+{
+    qint32 trackingType, buttonsType, analogsType;
+    ds >> c._id >> c._processIndex
+        >> trackingType >> c._trackingParameters
+        >> buttonsType >> c._buttonsParameters
+        >> analogsType >> c._analogsParameters;
+    c._trackingType = static_cast<QVRDeviceTrackingType>(trackingType);
+    c._buttonsType = static_cast<QVRDeviceButtonsType>(buttonsType);
+    c._analogsType = static_cast<QVRDeviceAnalogsType>(analogsType);
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream& ds, const QVRObserverConfig& c)
+{
+    ds << c._id
+        << static_cast<qint32>(c._navigationType) << c._navigationParameters
+        << static_cast<qint32>(c._trackingType) << c._trackingParameters
+        << c._initialNavigationPosition << c._initialNavigationForwardDirection << c._initialNavigationUpDirection
+        << c._initialEyeDistance
+        << c._initialTrackingPosition << c._initialTrackingForwardDirection << c._initialTrackingUpDirection;
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRObserverConfig& c)
+{
+    qint32 navigationType, trackingType;
+    ds >> c._id
+        >> navigationType >> c._navigationParameters
+        >> trackingType >> c._trackingParameters
+        >> c._initialNavigationPosition >> c._initialNavigationForwardDirection >> c._initialNavigationUpDirection
+        >> c._initialEyeDistance
+        >> c._initialTrackingPosition >> c._initialTrackingForwardDirection >> c._initialTrackingUpDirection;
+    c._navigationType = static_cast<QVRNavigationType>(navigationType);
+    c._trackingType = static_cast<QVRTrackingType>(trackingType);
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream& ds, const QVRWindowConfig& c)
+{
+    ds << c._id << c._observerIndex
+        << static_cast<qint32>(c._outputMode) << c._outputPlugin
+        << c._initialDisplayScreen << c._initialFullscreen << c._initialPosition << c._initialSize
+        << c._screenIsFixedToObserver
+        << c._screenCornerBottomLeft << c._screenCornerBottomRight << c._screenCornerTopLeft
+        << c._screenIsGivenByCenter << c._screenCenter
+        << c._renderResolutionFactor;
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRWindowConfig& c)
+{
+    qint32 outputMode;
+    ds >> c._id >> c._observerIndex
+        >> outputMode >> c._outputPlugin
+        >> c._initialDisplayScreen >> c._initialFullscreen >> c._initialPosition >> c._initialSize
+        >> c._screenIsFixedToObserver
+        >> c._screenCornerBottomLeft >> c._screenCornerBottomRight >> c._screenCornerTopLeft
+        >> c._screenIsGivenByCenter >> c._screenCenter
+        >> c._renderResolutionFactor;
+    c._outputMode = static_cast<QVROutputMode>(outputMode);
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream& ds, const QVRProcessConfig& c)
+{
+    ds << c._id
+        << static_cast<qint32>(c._ipc) << c._address
+        << c._launcher << c._display
+        << c._syncToVBlank << c._decoupledRendering
+        << c._windowConfigs;
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRProcessConfig& c)
+{
+    qint32 ipc;
+    ds >> c._id
+        >> ipc >> c._address
+        >> c._launcher >> c._display
+        >> c._syncToVBlank >> c._decoupledRendering
+        >> c._windowConfigs;
+    c._ipc = static_cast<QVRIpcType>(ipc);
+    return ds;
+}
+
+QDataStream &operator<<(QDataStream& ds, const QVRConfig& c)
+{
+    ds << c._deviceConfigs << c._observerConfigs << c._processConfigs;
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRConfig& c)
+{
+    ds >> c._deviceConfigs >> c._observerConfigs >> c._processConfigs;
+    return ds;
+}
@@ -32,6 +32,8 @@
 #include <QList>
 #include <QFlags>
 
+class QDataStream;
+
 
 /*!
  * \brief Device tracking method.
@@ -290,6 +292,8 @@ private:
     QString _analogsParameters;
 
     friend class QVRConfig;
+    friend QDataStream &operator<<(QDataStream& ds, const QVRDeviceConfig& c);
+    friend QDataStream &operator>>(QDataStream& ds, QVRDeviceConfig& c);
 
 public:
     /*! \brief Constructor. */
@@ -450,6 +454,8 @@ private:
     QVector3D _initialTrackingUpDirection;
 
     friend class QVRConfig;
+    friend QDataStream &operator<<(QDataStream& ds, const QVRObserverConfig& c);
+    friend QDataStream &operator>>(QDataStream& ds, QVRObserverConfig& c);
 
 public:
     /*! \brief Default eye height: average human height minus average human offset to eye. */
@@ -569,6 +575,8 @@ private:
     float _renderResolutionFactor;
 
     friend class QVRConfig;
+    friend QDataStream &operator<<(QDataStream& ds, const QVRWindowConfig& c);
+    friend QDataStream &operator>>(QDataStream& ds, QVRWindowConfig& c);
 
 public:
     /*! \brief Constructor */
@@ -654,6 +662,8 @@ private:
     QList<QVRWindowConfig> _windowConfigs;
 
     friend class QVRConfig;
+    friend QDataStream &operator<<(QDataStream& ds, const QVRProcessConfig& c);
+    friend QDataStream &operator>>(QDataStream& ds, QVRProcessConfig& c);
 
 public:
     /*! \brief Constructor */
@@ -722,6 +732,9 @@ private:
     // Each process config has a list of associated window configs.
     QList<QVRProcessConfig> _processConfigs;
 
+    friend QDataStream &operator<<(QDataStream& ds, const QVRConfig& c);
+    friend QDataStream &operator>>(QDataStream& ds, QVRConfig& c);
+
 public:
     /*! \brief Constructor. */
     QVRConfig();
@@ -776,4 +789,54 @@ public:
     const QList<QVRProcessConfig>& processConfigs() const { return _processConfigs; }
 };
 
+/*!
+ * \brief Writes the device configuration \a c to the stream \a ds.
+ */
+QDataStream &operator<<(QDataStream& ds, const QVRDeviceConfig& c);
+
+/*!
+ * \brief Reads the device configuration \a c from the stream \a ds.
+ */
+QDataStream &operator>>(QDataStream& ds, QVRDeviceConfig& c);
+
+/*!
+ * \brief Writes the observer configuration \a c to the stream \a ds.
+ */
+QDataStream &operator<<(QDataStream& ds, const QVRObserverConfig& c);
+
+/*!
+ * \brief Reads the observer configuration \a c from the stream \a ds.
+ */
+QDataStream &operator>>(QDataStream& ds, QVRObserverConfig& c);
+
+/*!
+ * \brief Writes the window configuration \a c to the stream \a ds.
+ */
+QDataStream &operator<<(QDataStream& ds, const QVRWindowConfig& c);
+
+/*!
+ * \brief Reads the window configuration \a c from the stream \a ds.
+ */
+QDataStream &operator>>(QDataStream& ds, QVRWindowConfig& c);
+
+/*!
+ * \brief Writes the process configuration \a c to the stream \a ds.
+ */
+QDataStream &operator<<(QDataStream& ds, const QVRProcessConfig& c);
+
+/*!
+ * \brief Reads the process configuration \a c from the stream \a ds.
+ */
+QDataStream &operator>>(QDataStream& ds, QVRProcessConfig& c);
+
+/*!
+ * \brief Writes the configuration \a c to the stream \a ds.
+ */
+QDataStream &operator<<(QDataStream& ds, const QVRConfig& c);
+
+/*!
+ * \brief Reads the configuration \a c from the stream \a ds.
+ */
+QDataStream &operator>>(QDataStream& ds, QVRConfig& c);
+
 #endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "culler.hpp"
+#include "rendercontext.hpp"
+
+
+QVRCuller::QVRCuller() : _viewCount(0)
+{
+}
+
+QVRCuller::QVRCuller(const QVRRenderContext& context, const QMatrix4x4& modelMatrix) :
+    _viewCount(context.viewCount())
+{
+    for (int v = 0; v < _viewCount; v++)
+        setPlanes(v, context.frustum(v).toMatrix4x4() * context.viewMatrix(v) * modelMatrix);
+}
+
+QVRCuller::QVRCuller(const QVRRenderContext& context, int view, const QMatrix4x4& modelMatrix) :
+    _viewCount(1)
+{
+    setPlanes(0, context.frustum(view).toMatrix4x4() * context.viewMatrix(view) * modelMatrix);
+}
+
+QVRCuller::QVRCuller(const QMatrix4x4& projectionViewModelMatrix) :
+    _viewCount(1)
+{
+    setPlanes(0, projectionViewModelMatrix);
+}
+
+void QVRCuller::setPlanes(int view, const QMatrix4x4& m)
+{
+    // Extract the planes from the rows of the matrix (Gribb/Hartmann)
+    QVector4D r0 = m.row(0), r1 = m.row(1), r2 = m.row(2), r3 = m.row(3);
+    QVector4D p[6] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2 };
+    for (int i = 0; i < 6; i++) {
+        float l = p[i].toVector3D().length();
+        if (l > 0.0f)
+            p[i] /= l;
+        _planes[view][i][0] = p[i].x();
+        _planes[view][i][1] = p[i].y();
+        _planes[view][i][2] = p[i].z();
+        _planes[view][i][3] = p[i].w();
+    }
+}
+
+bool QVRCuller::isSphereVisible(const QVector3D& center, float radius) const
+{
+    float x = center.x(), y = center.y(), z = center.z();
+    unsigned char visible;
+    cullSpheres(1, &x, &y, &z, &radius, &visible);
+    return visible;
+}
+
+bool QVRCuller::isBoxVisible(const QVector3D& boxMin, const QVector3D& boxMax) const
+{
+    float minX = boxMin.x(), minY = boxMin.y(), minZ = boxMin.z();
+    float maxX = boxMax.x(), maxY = boxMax.y(), maxZ = boxMax.z();
+    unsigned char visible;
+    cullBoxes(1, &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &visible);
+    return visible;
+}
+
+/* Both batch tests below use the same scheme: an object is inside a frustum
+ * if it is not completely on the outer side of any of its planes, and it is
+ * visible if it is inside at least one frustum. The objects are processed in
+ * blocks; for each block, the planes are the outer loop and the objects are
+ * the inner loop, so that the inner loop is a simple pass over the coordinate
+ * arrays that compilers can vectorize. */
+
+static const int QVRCullBlockSize = 256;
+
+int QVRCuller::cullSpheres(int n, const float* x, const float* y, const float* z, const float* radius,
+        unsigned char* visible) const
+{
+    int vis[QVRCullBlockSize];    // inside of any view
+    int inside[QVRCullBlockSize]; // inside of the current view
+    int visibleCount = 0;
+    for (int begin = 0; begin < n; begin += QVRCullBlockSize) {
+        int m = qMin(n - begin, QVRCullBlockSize);
+        const float* bx = x + begin;
+        const float* by = y + begin;
+        const float* bz = z + begin;
+        const float* br = radius + begin;
+        for (int j = 0; j < m; j++)
+            vis[j] = 0;
+        for (int v = 0; v < _viewCount; v++) {
+            for (int j = 0; j < m; j++)
+                inside[j] = 1;
+            for (int p = 0; p < 6; p++) {
+                float pa = _planes[v][p][0];
+                float pb = _planes[v][p][1];
+                float pc = _planes[v][p][2];
+                float pd = _planes[v][p][3];
+                for (int j = 0; j < m; j++)
+                    inside[j] &= (pa * bx[j] + pb * by[j] + pc * bz[j] + pd >= -br[j]);
+            }
+            for (int j = 0; j < m; j++)
+                vis[j] |= inside[j];
+        }
+        unsigned char* bvisible = visible + begin;
+        for (int j = 0; j < m; j++) {
+            bvisible[j] = vis[j];
+            visibleCount += vis[j];
+        }
+    }
+    return visibleCount;
+}
+
+int QVRCuller::cullBoxes(int n, const float* minX, const float* minY, const float* minZ,
+        const float* maxX, const float* maxY, const float* maxZ,
+        unsigned char* visible) const
+{
+    // A box is on the inner side of a plane if the distance of its center
+    // plus its half extent projected onto the plane normal is >= 0.
+    float cx[QVRCullBlockSize], cy[QVRCullBlockSize], cz[QVRCullBlockSize]; // centers
+    float ex[QVRCullBlockSize], ey[QVRCullBlockSize], ez[QVRCullBlockSize]; // half extents
+    int vis[QVRCullBlockSize];    // inside of any view
+    int inside[QVRCullBlockSize]; // inside of the current view
+    int visibleCount = 0;
+    for (int begin = 0; begin < n; begin += QVRCullBlockSize) {
+        int m = qMin(n - begin, QVRCullBlockSize);
+        for (int j = 0; j < m; j++) {
+            cx[j] = 0.5f * (minX[begin + j] + maxX[begin + j]);
+            cy[j] = 0.5f * (minY[begin + j] + maxY[begin + j]);
+            cz[j] = 0.5f * (minZ[begin + j] + maxZ[begin + j]);
+            ex[j] = 0.5f * (maxX[begin + j] - minX[begin + j]);
+            ey[j] = 0.5f * (maxY[begin + j] - minY[begin + j]);
+            ez[j] = 0.5f * (maxZ[begin + j] - minZ[begin + j]);
+            vis[j] = 0;
+        }
+        for (int v = 0; v < _viewCount; v++) {
+            for (int j = 0; j < m; j++)
+                inside[j] = 1;
+            for (int p = 0; p < 6; p++) {
+                float pa = _planes[v][p][0];
+                float pb = _planes[v][p][1];
+                float pc = _planes[v][p][2];
+                float pd = _planes[v][p][3];
+                float qa = std::abs(pa);
+                float qb = std::abs(pb);
+                float qc = std::abs(pc);
+                for (int j = 0; j < m; j++) {
+                    float d = pa * cx[j] + pb * cy[j] + pc * cz[j] + pd;
+                    float r = qa * ex[j] + qb * ey[j] + qc * ez[j];
+                    inside[j] &= (d >= -r);
+                }
+            }
+            for (int j = 0; j < m; j++)
+                vis[j] |= inside[j];
+        }
+        unsigned char* bvisible = visible + begin;
+        for (int j = 0; j < m; j++) {
+            bvisible[j] = vis[j];
+            visibleCount += vis[j];
+        }
+    }
+    return visibleCount;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_CULLER_HPP
+#define QVR_CULLER_HPP
+
+#include <QVector3D>
+#include <QMatrix4x4>
+
+class QVRRenderContext;
+
+/*!
+ * \brief View frustum culling helper.
+ *
+ * A culler holds the clipping planes of one or two view frusta and tests
+ * bounding spheres and axis-aligned bounding boxes against them. An object
+ * is considered visible if it is at least partially inside at least one
+ * of the frusta. This allows to cull objects once for both views of a stereo
+ * frame, and then render the remaining objects for each view.
+ *
+ * The tests are conservative: objects that are reported as invisible are
+ * guaranteed to be outside of all frusta, but objects near the corners of a
+ * frustum may be reported as visible even though they are not.
+ *
+ * Example:
+ * \code{.cpp}
+ * QVRCuller culler(context, modelMatrix);
+ * culler.cullBoxes(n, minX, minY, minZ, maxX, maxY, maxZ, visible);
+ * for (int view = 0; view < context.viewCount(); view++) {
+ *     // setup view...
+ *     for (int i = 0; i < n; i++)
+ *         if (visible[i])
+ *             render_object(i);
+ * }
+ * \endcode
+ *
+ * For large numbers of objects, use the functions that work on arrays of bounds,
+ * cullSpheres() and cullBoxes(). Their bounds are passed as separate arrays for
+ * each coordinate, so that many objects can be tested against each plane in
+ * one pass.
+ */
+class QVRCuller
+{
+private:
+    int _viewCount;
+    float _planes[2][6][4]; // for each view: left, right, bottom, top, near, far (normalized, pointing inside)
+
+    void setPlanes(int view, const QMatrix4x4& projectionViewModelMatrix);
+
+public:
+    /*! \brief Constructs a culler without frusta, which considers all objects invisible. */
+    QVRCuller();
+
+    /*!
+     * \brief Constructs a culler for all views of a render context.
+     * \param context           The render context
+     * \param modelMatrix       The model matrix that transforms the bounds into world space
+     *
+     * For stereo render contexts, this culler will test against both views at once.
+     */
+    QVRCuller(const QVRRenderContext& context, const QMatrix4x4& modelMatrix = QMatrix4x4());
+
+    /*!
+     * \brief Constructs a culler for one view of a render context.
+     * \param context           The render context
+     * \param view              The view
+     * \param modelMatrix       The model matrix that transforms the bounds into world space
+     */
+    QVRCuller(const QVRRenderContext& context, int view, const QMatrix4x4& modelMatrix = QMatrix4x4());
+
+    /*!
+     * \brief Constructs a culler from a combined projection, view, and model matrix.
+     * \param projectionViewModelMatrix The matrix that transforms the bounds into clip space
+     */
+    QVRCuller(const QMatrix4x4& projectionViewModelMatrix);
+
+    /*! \brief Returns the number of frusta that this culler tests against. */
+    int viewCount() const { return _viewCount; }
+
+    /*!
+     * \brief Returns the clipping planes of \a view.
+     *
+     * The six planes are given in the order left, right, bottom, top, near, far.
+     * Each plane is stored as (a, b, c, d), with the normal (a, b, c) of unit length
+     * pointing inside the frustum, so that a*x + b*y + c*z + d is the signed distance of
+     * a point (x, y, z) to the plane.
+     */
+    const float* planes(int view) const { Q_ASSERT(view >= 0 && view < viewCount()); return &(_planes[view][0][0]); }
+
+    /*! \brief Returns whether the sphere with the given \a center and \a radius is visible. */
+    bool isSphereVisible(const QVector3D& center, float radius) const;
+
+    /*! \brief Returns whether the axis-aligned box from \a boxMin to \a boxMax is visible. */
+    bool isBoxVisible(const QVector3D& boxMin, const QVector3D& boxMax) const;
+
+    /*!
+     * \brief Tests \a n spheres at once.
+     * \param n         The number of spheres
+     * \param x         The x coordinates of the centers
+     * \param y         The y coordinates of the centers
+     * \param z         The z coordinates of the centers
+     * \param radius    The radii
+     * \param visible   Receives 1 for each visible sphere and 0 for each invisible sphere
+     * \return          The number of visible spheres
+     */
+    int cullSpheres(int n, const float* x, const float* y, const float* z, const float* radius,
+            unsigned char* visible) const;
+
+    /*!
+     * \brief Tests \a n axis-aligned boxes at once.
+     * \param n         The number of boxes
+     * \param minX      The minimum x coordinates
+     * \param minY      The minimum y coordinates
+     * \param minZ      The minimum z coordinates
+     * \param maxX      The maximum x coordinates
+     * \param maxY      The maximum y coordinates
+     * \param maxZ      The maximum z coordinates
+     * \param visible   Receives 1 for each visible box and 0 for each invisible box
+     * \return          The number of visible boxes
+     */
+    int cullBoxes(int n, const float* minX, const float* minY, const float* minZ,
+            const float* maxX, const float* maxY, const float* maxZ,
+            unsigned char* visible) const;
+};
+
+#endif
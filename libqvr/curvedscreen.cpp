@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <QtMath>
+#include <QDataStream>
+#include <QQuaternion>
+#include <QOpenGLShaderProgram>
+
+#include "curvedscreen.hpp"
+#include "rendercontext.hpp"
+
+
+QVRCurvedScreen::QVRCurvedScreen() :
+    _shape(Cylinder), _center(0.0f, 0.0f, 0.0f), _up(0.0f, 1.0f, 0.0f), _radius(1.0f)
+{
+    _params[0] = 0.0f;
+    _params[1] = static_cast<float>(M_PI);
+    _params[2] = static_cast<float>(M_PI_2);
+    _params[3] = 0.0f;
+}
+
+QVRCurvedScreen QVRCurvedScreen::cylinder(const QVector3D& center, const QVector3D& up, float radius,
+        float phiCenter, float phiRange, float thetaRange)
+{
+    QVRCurvedScreen s;
+    s._shape = Cylinder;
+    s._center = center;
+    s._up = up.normalized();
+    s._radius = radius;
+    s._params[0] = phiCenter;
+    s._params[1] = phiRange;
+    s._params[2] = thetaRange;
+    s._params[3] = 0.0f;
+    return s;
+}
+
+QVRCurvedScreen QVRCurvedScreen::sphereSection(const QVector3D& center, const QVector3D& up, float radius,
+        float phiCenter, float phiRange, float thetaCenter, float thetaRange)
+{
+    QVRCurvedScreen s;
+    s._shape = SphereSection;
+    s._center = center;
+    s._up = up.normalized();
+    s._radius = radius;
+    s._params[0] = phiCenter;
+    s._params[1] = phiRange;
+    s._params[2] = thetaCenter;
+    s._params[3] = thetaRange;
+    return s;
+}
+
+QVRCurvedScreen QVRCurvedScreen::dome(const QVector3D& center, const QVector3D& up, float radius,
+        float aperture)
+{
+    QVRCurvedScreen s;
+    s._shape = Dome;
+    s._center = center;
+    s._up = up.normalized();
+    s._radius = radius;
+    s._params[0] = aperture;
+    s._params[1] = 0.0f;
+    s._params[2] = 0.0f;
+    s._params[3] = 0.0f;
+    return s;
+}
+
+QMatrix4x4 QVRCurvedScreen::modelMatrix() const
+{
+    QMatrix4x4 M;
+    M.translate(_center);
+    M.rotate(QQuaternion::rotationTo(QVector3D(0.0f, 1.0f, 0.0f), _up));
+    M.scale(_radius);
+    return M;
+}
+
+float QVRCurvedScreen::aspectRatio() const
+{
+    switch (_shape) {
+    case Cylinder:
+        return _params[1] / (2.0f * std::tan(0.5f * _params[2]));
+    case SphereSection:
+        return _params[1] * std::cos(_params[2]) / _params[3];
+    case Dome:
+        break;
+    }
+    return 1.0f;
+}
+
+QVector3D QVRCurvedScreen::position(float s, float t) const
+{
+    QVector3D p;
+    if (_shape == Cylinder) {
+        float phi = _params[0] + (s - 0.5f) * _params[1];
+        p = QVector3D(std::sin(phi), std::tan(0.5f * _params[2]) * (2.0f * t - 1.0f), -std::cos(phi));
+    } else if (_shape == SphereSection) {
+        float phi = _params[0] + (s - 0.5f) * _params[1];
+        float theta = _params[2] + (t - 0.5f) * _params[3];
+        p = QVector3D(std::cos(theta) * std::sin(phi), std::sin(theta), -std::cos(theta) * std::cos(phi));
+    } else {
+        float x = 2.0f * s - 1.0f;
+        float y = 2.0f * t - 1.0f;
+        float r = std::sqrt(x * x + y * y);
+        if (r > 0.0f) {
+            x /= r;
+            y /= r;
+        }
+        float rho = qMin(r, 1.0f) * 0.5f * _params[0];
+        p = QVector3D(std::sin(rho) * x, std::cos(rho), -std::sin(rho) * y);
+    }
+    return modelMatrix() * p;
+}
+
+float QVRCurvedScreen::pixelsPerRadian(const QVRRenderContext& context, int view)
+{
+    // Near the view direction, one unit on the near plane at distance n
+    // corresponds to 1/n radians.
+    const QVRFrustum& f = context.frustum(view);
+    QSize size = context.textureSize(view);
+    float n = f.nearPlane();
+    float ppr = 0.0f;
+    if (f.rightPlane() > f.leftPlane())
+        ppr = size.width() * n / (f.rightPlane() - f.leftPlane());
+    if (f.topPlane() > f.bottomPlane())
+        ppr = qMax(ppr, size.height() * n / (f.topPlane() - f.bottomPlane()));
+    return ppr;
+}
+
+static int segments(float range, float pixelsPerRadian, float maxPixelError)
+{
+    // A chord spanning the angle a deviates from the unit circle by 1 - cos(a/2);
+    // seen from a distance of 1, this is (1 - cos(a/2)) * pixelsPerRadian pixels.
+    const int maxSegments = 1024;
+    float relError = (pixelsPerRadian > 0.0f ? maxPixelError / pixelsPerRadian : 1.0f);
+    if (relError >= 1.0f)
+        return 1;
+    float a = 2.0f * std::acos(1.0f - relError);
+    float n = std::ceil(std::abs(range) / a);
+    return (n < 1.0f ? 1 : n > maxSegments ? maxSegments : static_cast<int>(n));
+}
+
+void QVRCurvedScreen::tessellation(float pixelsPerRadian, float maxPixelError, int* columns, int* rows) const
+{
+    switch (_shape) {
+    case Cylinder:
+        *columns = segments(_params[1], pixelsPerRadian, maxPixelError);
+        *rows = 1;
+        break;
+    case SphereSection:
+        *columns = segments(_params[1], pixelsPerRadian, maxPixelError);
+        *rows = segments(_params[3], pixelsPerRadian, maxPixelError);
+        break;
+    case Dome:
+        *columns = segments(_params[0], pixelsPerRadian, maxPixelError);
+        *rows = *columns;
+        break;
+    }
+}
+
+void QVRCurvedScreen::tessellation(const QVRRenderContext& context, float maxPixelError, int* columns, int* rows) const
+{
+    float ppr = 0.0f;
+    for (int v = 0; v < context.viewCount(); v++)
+        ppr = qMax(ppr, pixelsPerRadian(context, v));
+    tessellation(ppr, maxPixelError, columns, rows);
+}
+
+void QVRCurvedScreen::mesh(int columns, int rows, QVector<QVector3D>& positions,
+        QVector<QVector2D>& texCoords, QVector<unsigned int>& indices) const
+{
+    positions.clear();
+    texCoords.clear();
+    indices.clear();
+    positions.reserve((columns + 1) * (rows + 1));
+    texCoords.reserve((columns + 1) * (rows + 1));
+    indices.reserve(6 * columns * rows);
+    for (int r = 0; r <= rows; r++) {
+        float t = r / static_cast<float>(rows);
+        for (int c = 0; c <= columns; c++) {
+            float s = c / static_cast<float>(columns);
+            positions.append(position(s, t));
+            texCoords.append(QVector2D(s, t));
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            unsigned int bl = r * (columns + 1) + c;
+            unsigned int br = bl + 1;
+            unsigned int tl = bl + (columns + 1);
+            unsigned int tr = tl + 1;
+            indices.append(bl);
+            indices.append(br);
+            indices.append(tl);
+            indices.append(br);
+            indices.append(tr);
+            indices.append(tl);
+        }
+    }
+}
+
+QString QVRCurvedScreen::glslFunctions()
+{
+    return QString(
+            "uniform int qvr_curved_screen_shape;\n"
+            "uniform int qvr_curved_screen_columns;\n"
+            "uniform int qvr_curved_screen_rows;\n"
+            "uniform vec4 qvr_curved_screen_params;\n"
+            "uniform mat4 qvr_curved_screen_matrix;\n"
+            "\n"
+            "vec4 qvr_curved_screen_vertex(out vec2 texcoord)\n"
+            "{\n"
+            "    // Each mesh cell consists of two triangles with six vertices\n"
+            "    int cell = gl_VertexID / 6;\n"
+            "    int corner = gl_VertexID - 6 * cell;\n"
+            "    int dx = (corner == 1 || corner == 3 || corner == 4) ? 1 : 0;\n"
+            "    int dy = (corner == 2 || corner == 4 || corner == 5) ? 1 : 0;\n"
+            "    int row = cell / qvr_curved_screen_columns;\n"
+            "    int col = cell - row * qvr_curved_screen_columns;\n"
+            "    float s = float(col + dx) / float(qvr_curved_screen_columns);\n"
+            "    float t = float(row + dy) / float(qvr_curved_screen_rows);\n"
+            "    texcoord = vec2(s, t);\n"
+            "    vec4 p = qvr_curved_screen_params;\n"
+            "    vec3 pos;\n"
+            "    if (qvr_curved_screen_shape == 0) {\n"
+            "        float phi = p.x + (s - 0.5) * p.y;\n"
+            "        pos = vec3(sin(phi), tan(0.5 * p.z) * (2.0 * t - 1.0), -cos(phi));\n"
+            "    } else if (qvr_curved_screen_shape == 1) {\n"
+            "        float phi = p.x + (s - 0.5) * p.y;\n"
+            "        float theta = p.z + (t - 0.5) * p.w;\n"
+            "        pos = vec3(cos(theta) * sin(phi), sin(theta), -cos(theta) * cos(phi));\n"
+            "    } else {\n"
+            "        vec2 xy = 2.0 * vec2(s, t) - 1.0;\n"
+            "        float r = length(xy);\n"
+            "        vec2 dir = (r > 0.0 ? xy / r : vec2(0.0));\n"
+            "        float rho = min(r, 1.0) * 0.5 * p.x;\n"
+            "        pos = vec3(sin(rho) * dir.x, cos(rho), -sin(rho) * dir.y);\n"
+            "    }\n"
+            "    return qvr_curved_screen_matrix * vec4(pos, 1.0);\n"
+            "}\n");
+}
+
+void QVRCurvedScreen::setUniforms(QOpenGLShaderProgram& prg, int columns, int rows) const
+{
+    prg.setUniformValue("qvr_curved_screen_shape", static_cast<int>(_shape));
+    prg.setUniformValue("qvr_curved_screen_columns", columns);
+    prg.setUniformValue("qvr_curved_screen_rows", rows);
+    prg.setUniformValue("qvr_curved_screen_params", QVector4D(_params[0], _params[1], _params[2], _params[3]));
+    prg.setUniformValue("qvr_curved_screen_matrix", modelMatrix());
+}
+
+QDataStream &operator<<(QDataStream& ds, const QVRCurvedScreen& s)
+{
+    ds << static_cast<int>(s._shape) << s._center << s._up << s._radius
+        << s._params[0] << s._params[1] << s._params[2] << s._params[3];
+    return ds;
+}
+
+QDataStream &operator>>(QDataStream& ds, QVRCurvedScreen& s)
+{
+    int shape;
+    ds >> shape >> s._center >> s._up >> s._radius
+        >> s._params[0] >> s._params[1] >> s._params[2] >> s._params[3];
+    s._shape = static_cast<QVRCurvedScreen::Shape>(shape);
+    return ds;
+}
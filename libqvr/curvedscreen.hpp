@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_CURVEDSCREEN_HPP
+#define QVR_CURVEDSCREEN_HPP
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <QString>
+
+class QDataStream;
+class QOpenGLShaderProgram;
+class QVRRenderContext;
+
+/*!
+ * \brief Curved screen geometry with adaptive tessellation.
+ *
+ * A curved screen is a section of a cylinder, a section of a sphere, or a dome
+ * (a spherical cap around the up axis). Its geometry is defined in a canonical
+ * space with the center at the origin, the up axis along +y, the forward
+ * direction along -z, and radius 1. The model matrix (see modelMatrix())
+ * transforms this into the virtual world.
+ *
+ * Azimuth angles are measured from the forward direction towards +x, and
+ * elevation angles from the horizontal plane towards the up axis. All angles
+ * are in radians.
+ *
+ * The screen is parameterized by texture coordinates (s, t) in [0,1]x[0,1],
+ * where (0,0) is the bottom left corner as seen from the center. A dome
+ * uses fisheye (azimuthal equidistant) texture coordinates: the center of the
+ * texture is the zenith, and the top of the texture points forward.
+ *
+ * The number of mesh segments is chosen so that the deviation of the mesh from
+ * the true curved surface stays below a given error in pixels (see
+ * tessellation()). Since this depends on the resolution and field of view of
+ * each view, the mesh can be generated on the GPU from the vertex ID
+ * alone, without any vertex buffers, so that each view can use its own
+ * tessellation at no cost:
+ * \code{.cpp}
+ * // At initialization: insert the GLSL functions into your vertex shader
+ * QString vs = "#version 330\n" + QVRCurvedScreen::glslFunctions() + myVertexShaderMain;
+ * // For each view: pick the tessellation and draw
+ * int columns, rows;
+ * screen.tessellation(context, 0.5f, &columns, &rows);
+ * screen.setUniforms(prg, columns, rows);
+ * glBindVertexArray(emptyVao);
+ * glDrawArrays(GL_TRIANGLES, 0, QVRCurvedScreen::vertexCount(columns, rows));
+ * \endcode
+ * In the vertex shader, qvr_curved_screen_vertex() returns the model
+ * coordinates of the current vertex (with the model matrix already applied)
+ * and its texture coordinates.
+ * Alternatively, mesh() generates the geometry on the CPU.
+ */
+class QVRCurvedScreen
+{
+public:
+    /*! \brief Shape of a curved screen */
+    enum Shape {
+        /*! \brief Section of a cylinder */
+        Cylinder = 0,
+        /*! \brief Section of a sphere, bounded by azimuth and elevation ranges */
+        SphereSection = 1,
+        /*! \brief Spherical cap around the up axis, with fisheye texture coordinates */
+        Dome = 2
+    };
+
+private:
+    Shape _shape;
+    QVector3D _center;
+    QVector3D _up;
+    float _radius;
+    float _params[4]; // cylinder: phiCenter, phiRange, thetaRange, unused
+                      // sphere section: phiCenter, phiRange, thetaCenter, thetaRange
+                      // dome: aperture, unused, unused, unused
+
+    friend QDataStream &operator<<(QDataStream& ds, const QVRCurvedScreen& s);
+    friend QDataStream &operator>>(QDataStream& ds, QVRCurvedScreen& s);
+
+public:
+    /*! \brief Constructs a half cylinder of radius 1 around the origin. */
+    QVRCurvedScreen();
+
+    /*!
+     * \brief Constructs a section of a cylinder.
+     * \param center            The center of the cylinder at eye height of the screen center
+     * \param up                The cylinder axis
+     * \param radius            The radius
+     * \param phiCenter         The azimuth of the screen center
+     * \param phiRange          The azimuth range covered by the screen
+     * \param thetaRange        The vertical aperture of the screen as seen from the center
+     */
+    static QVRCurvedScreen cylinder(const QVector3D& center, const QVector3D& up, float radius,
+            float phiCenter, float phiRange, float thetaRange);
+
+    /*!
+     * \brief Constructs a section of a sphere.
+     * \param center            The center of the sphere
+     * \param up                The up direction
+     * \param radius            The radius
+     * \param phiCenter         The azimuth of the screen center
+     * \param phiRange          The azimuth range covered by the screen
+     * \param thetaCenter       The elevation of the screen center
+     * \param thetaRange        The elevation range covered by the screen
+     */
+    static QVRCurvedScreen sphereSection(const QVector3D& center, const QVector3D& up, float radius,
+            float phiCenter, float phiRange, float thetaCenter, float thetaRange);
+
+    /*!
+     * \brief Constructs a dome.
+     * \param center            The center of the sphere
+     * \param up                The direction of the zenith
+     * \param radius            The radius
+     * \param aperture          The aperture angle of the dome, e.g. pi for a hemisphere
+     */
+    static QVRCurvedScreen dome(const QVector3D& center, const QVector3D& up, float radius,
+            float aperture);
+
+    /*! \brief Returns the shape. */
+    Shape shape() const { return _shape; }
+    /*! \brief Returns the center. */
+    const QVector3D& center() const { return _center; }
+    /*! \brief Returns the up direction. */
+    const QVector3D& up() const { return _up; }
+    /*! \brief Returns the radius. */
+    float radius() const { return _radius; }
+
+    /*! \brief Returns the matrix that transforms the canonical screen into the virtual world. */
+    QMatrix4x4 modelMatrix() const;
+
+    /*! \brief Returns the aspect ratio of the screen as seen from its center. */
+    float aspectRatio() const;
+
+    /*! \brief Returns the position of the screen point with texture coordinates (\a s, \a t). */
+    QVector3D position(float s, float t) const;
+
+    /*!
+     * \brief Returns the number of pixels per radian in the center of a view.
+     * \param context           The render context
+     * \param view              The view
+     */
+    static float pixelsPerRadian(const QVRRenderContext& context, int view);
+
+    /*!
+     * \brief Picks a tessellation.
+     * \param pixelsPerRadian   The angular resolution, see pixelsPerRadian()
+     * \param maxPixelError     The maximum deviation of the mesh from the curved surface, in pixels
+     * \param columns           Returns the number of mesh columns
+     * \param rows              Returns the number of mesh rows
+     *
+     * The deviation is estimated for viewers at a distance from the screen that
+     * is comparable to its radius.
+     */
+    void tessellation(float pixelsPerRadian, float maxPixelError, int* columns, int* rows) const;
+
+    /*!
+     * \brief Picks a tessellation that is suitable for all views of a render context.
+     * \param context           The render context
+     * \param maxPixelError     The maximum deviation of the mesh from the curved surface, in pixels
+     * \param columns           Returns the number of mesh columns
+     * \param rows              Returns the number of mesh rows
+     */
+    void tessellation(const QVRRenderContext& context, float maxPixelError, int* columns, int* rows) const;
+
+    /*!
+     * \brief Generates a mesh on the CPU.
+     * \param columns           The number of mesh columns
+     * \param rows              The number of mesh rows
+     * \param positions         Returns the vertex positions
+     * \param texCoords         Returns the vertex texture coordinates
+     * \param indices           Returns the triangle vertex indices
+     */
+    void mesh(int columns, int rows, QVector<QVector3D>& positions,
+            QVector<QVector2D>& texCoords, QVector<unsigned int>& indices) const;
+
+    /*!
+     * \brief Returns GLSL code for vertex generation on the GPU.
+     *
+     * The code declares the uniforms set by setUniforms() and the function
+     * `vec4 qvr_curved_screen_vertex(out vec2 texcoord)`. It works with
+     * GLSL 3.30 and GLSL ES 3.00.
+     */
+    static QString glslFunctions();
+
+    /*!
+     * \brief Sets the uniforms of the GLSL code returned by glslFunctions().
+     * \param prg               The shader program, which must be bound
+     * \param columns           The number of mesh columns
+     * \param rows              The number of mesh rows
+     */
+    void setUniforms(QOpenGLShaderProgram& prg, int columns, int rows) const;
+
+    /*! \brief Returns the number of vertices to draw as GL_TRIANGLES for GPU vertex generation. */
+    static int vertexCount(int columns, int rows) { return 6 * columns * rows; }
+};
+
+/*! \brief Writes the curved screen \a s to the stream \a ds. */
+QDataStream &operator<<(QDataStream& ds, const QVRCurvedScreen& s);
+/*! \brief Reads the curved screen \a s from the stream \a ds. */
+QDataStream &operator>>(QDataStream& ds, QVRCurvedScreen& s);
+
+#endif
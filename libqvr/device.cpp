@@ -24,9 +24,11 @@
 
 #include <cstring>
 #include <QtMath>
+#include <QDataStream>
 
 #include "manager.hpp"
 #include "device.hpp"
+#include "devicewire.hpp"
 #include "logging.hpp"
 #include "internalglobals.hpp"
 
@@ -209,6 +211,7 @@ static const int QVRDeviceMaxAnalogs = QVR_Analog_Unknown;
 
 QVRDevice::QVRDevice() :
     _index(-1),
+    _timestamp(-1),
     _internals(NULL)
 {
     for (int i = 0; i < QVRDeviceMaxButtons; i++)
@@ -218,7 +221,8 @@ QVRDevice::QVRDevice() :
 }
 
 QVRDevice::QVRDevice(int deviceIndex) :
-    _index(deviceIndex)
+    _index(deviceIndex),
+    _timestamp(-1)
 {
     for (int i = 0; i < QVRDeviceMaxButtons; i++)
         _buttonsMap[i] = -1;
@@ -529,9 +533,8 @@ QVRDevice::QVRDevice(int deviceIndex) :
     case QVR_Device_Analogs_Static:
         {
             QStringList args = config().analogsParameters().split(' ', Qt::SkipEmptyParts);
-            _analogs.resize(args.length());
             int n = qMin(QVRDeviceMaxAnalogs, args.length() / 2);
-            _buttons.resize(n);
+            _analogs.resize(n);
             for (int i = 0; i < _analogs.length(); i++) {
                 QString name = args[2 * i + 0];
                 QVRAnalog anlg;
@@ -682,8 +685,11 @@ QVRDevice::QVRDevice(int deviceIndex) :
 QVRDevice::QVRDevice(const QVRDevice& d) : _internals(NULL)
 {
     _index = d._index;
+    _timestamp = d._timestamp;
     _position = d._position;
     _orientation = d._orientation;
+    _velocity = d._velocity;
+    _angularVelocity = d._angularVelocity;
     std::memcpy(_buttonsMap, d._buttonsMap, sizeof(_buttonsMap));
     _buttons = d._buttons;
     std::memcpy(_analogsMap, d._analogsMap, sizeof(_analogsMap));
@@ -713,8 +719,11 @@ QVRDevice::~QVRDevice()
 const QVRDevice& QVRDevice::operator=(const QVRDevice& d)
 {
     _index = d._index;
+    _timestamp = d._timestamp;
     _position = d._position;
     _orientation = d._orientation;
+    _velocity = d._velocity;
+    _angularVelocity = d._angularVelocity;
     std::memcpy(_buttonsMap, d._buttonsMap, sizeof(_buttonsMap));
     _buttons = d._buttons;
     std::memcpy(_analogsMap, d._analogsMap, sizeof(_analogsMap));
@@ -1056,21 +1065,69 @@ void QVRDevice::update()
             _angularVelocity = QVRAngularVelocityFromDiffQuaternion(
                     _orientation * _internals->lastOrientation.conjugated(), secs);
         }
+        _timestamp = QVRClusterTime();
     }
 }
 
+static_assert(QVR_Button_Unknown <= 32, "too many buttons for a 32 bit button field");
+
+quint32 QVRDevice::buttonBits() const
+{
+    quint32 bits = 0;
+    for (int i = 0; i < _buttons.length(); i++)
+        if (_buttons[i])
+            bits |= (quint32(1) << i);
+    return bits;
+}
+
 QDataStream &operator<<(QDataStream& ds, const QVRDevice& d)
 {
-    ds << d._index << d._position << d._orientation << d._velocity << d._angularVelocity << d._buttons << d._analogs;
-    ds.writeRawData(reinterpret_cast<const char*>(d._buttonsMap), sizeof(d._buttonsMap));
-    ds.writeRawData(reinterpret_cast<const char*>(d._analogsMap), sizeof(d._analogsMap));
+    QVRDeviceWireData w;
+    std::memset(&w, 0, sizeof(w));
+    w.timestamp = d._timestamp;
+    w.index = d._index;
+    w.position[0] = d._position.x();
+    w.position[1] = d._position.y();
+    w.position[2] = d._position.z();
+    w.orientation[0] = d._orientation.scalar();
+    w.orientation[1] = d._orientation.x();
+    w.orientation[2] = d._orientation.y();
+    w.orientation[3] = d._orientation.z();
+    w.velocity[0] = d._velocity.x();
+    w.velocity[1] = d._velocity.y();
+    w.velocity[2] = d._velocity.z();
+    w.angularVelocity[0] = d._angularVelocity.x();
+    w.angularVelocity[1] = d._angularVelocity.y();
+    w.angularVelocity[2] = d._angularVelocity.z();
+    w.buttons = d.buttonBits();
+    std::memcpy(w.analogs, d._analogs.constData(), d._analogs.size() * sizeof(float));
+    w.buttonCount = d._buttons.size();
+    w.analogCount = d._analogs.size();
+    std::memcpy(w.buttonsMap, d._buttonsMap, sizeof(w.buttonsMap));
+    std::memcpy(w.analogsMap, d._analogsMap, sizeof(w.analogsMap));
+    ds.writeRawData(reinterpret_cast<const char*>(&w), sizeof(w));
     return ds;
 }
 
 QDataStream &operator>>(QDataStream& ds, QVRDevice& d)
 {
-    ds >> d._index >> d._position >> d._orientation >> d._velocity >> d._angularVelocity >> d._buttons >> d._analogs;
-    ds.readRawData(reinterpret_cast<char*>(d._buttonsMap), sizeof(d._buttonsMap));
-    ds.readRawData(reinterpret_cast<char*>(d._analogsMap), sizeof(d._analogsMap));
+    QVRDeviceWireData w;
+    if (ds.readRawData(reinterpret_cast<char*>(&w), sizeof(w)) != sizeof(w)) {
+        ds.setStatus(QDataStream::ReadPastEnd);
+        return ds;
+    }
+    d._timestamp = w.timestamp;
+    d._index = w.index;
+    d._position = QVector3D(w.position[0], w.position[1], w.position[2]);
+    d._orientation = QQuaternion(w.orientation[0], w.orientation[1], w.orientation[2], w.orientation[3]);
+    d._velocity = QVector3D(w.velocity[0], w.velocity[1], w.velocity[2]);
+    d._angularVelocity = QVector3D(w.angularVelocity[0], w.angularVelocity[1], w.angularVelocity[2]);
+    d._buttons.resize(qBound(0, int(w.buttonCount), QVRDeviceMaxButtons));
+    for (int i = 0; i < d._buttons.size(); i++)
+        d._buttons[i] = (w.buttons >> i) & 1;
+    d._analogs.resize(qBound(0, int(w.analogCount), QVRDeviceMaxAnalogs));
+    std::memcpy(d._analogs.data(), w.analogs, d._analogs.size() * sizeof(float));
+    std::memcpy(d._buttonsMap, w.buttonsMap, sizeof(d._buttonsMap));
+    std::memcpy(d._analogsMap, w.analogsMap, sizeof(d._analogsMap));
     return ds;
 }
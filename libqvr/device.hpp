@@ -52,6 +52,7 @@ class QVRDevice
 {
 private:
     int _index;
+    qint64 _timestamp;
 
     QVector3D _position;
     QQuaternion _orientation;
@@ -68,7 +69,10 @@ private:
     friend QDataStream &operator>>(QDataStream& ds, QVRDevice& d);
 
     friend class QVRManager;
+    friend class QVRDeviceSampler;
+    friend class QVRDeviceEventDetector;
     void update();
+    quint32 buttonBits() const; // bit i is set if button i is pressed
 
 public:
     /**
@@ -135,6 +139,14 @@ public:
         return _angularVelocity;
     }
 
+    /*! \brief Returns the time at which the current state was sampled, in
+     * nanoseconds of the QVR timer of the main process, or -1 if the device
+     * was not updated yet. */
+    qint64 timestamp() const
+    {
+        return _timestamp;
+    }
+
     /*! \brief Returns the position and orientation as a matrix. */
     QMatrix4x4 matrix() const
     {
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QElapsedTimer>
+
+#include "devicesampler.hpp"
+#include "config.hpp"
+#include "manager.hpp"
+
+
+/* The sample queue can hold at least this many seconds worth of samples,
+ * so that a slow frame does not lose samples. */
+static const float QVRDeviceSamplerQueueSeconds = 0.25f;
+
+QVRDeviceSampler::QVRDeviceSampler(const QList<QVRDevice*>& devices, int rate) :
+    _devices(devices),
+    _periodNsecs(1000000000 / rate),
+    _samples(qMax(64, static_cast<int>(QVRDeviceSamplerQueueSeconds * rate * devices.size()))),
+    _droppedSamples(0),
+    _exitWanted(0)
+{
+}
+
+QVRDeviceSampler::~QVRDeviceSampler()
+{
+    _exitWanted.storeRelease(1);
+    wait();
+    for (int i = 0; i < _devices.size(); i++)
+        delete _devices[i];
+}
+
+bool QVRDeviceSampler::canSample(const QVRDeviceConfig& config)
+{
+    return config.processIndex() == 0
+        && (config.trackingType() == QVR_Device_Tracking_None
+                || config.trackingType() == QVR_Device_Tracking_Static
+                || config.trackingType() == QVR_Device_Tracking_VRPN)
+        && (config.buttonsType() == QVR_Device_Buttons_None
+                || config.buttonsType() == QVR_Device_Buttons_Static
+                || config.buttonsType() == QVR_Device_Buttons_VRPN)
+        && (config.analogsType() == QVR_Device_Analogs_None
+                || config.analogsType() == QVR_Device_Analogs_Static
+                || config.analogsType() == QVR_Device_Analogs_VRPN);
+}
+
+void QVRDeviceSampler::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 nextSampleTime = 0;
+    while (!_exitWanted.loadAcquire()) {
+        for (int i = 0; i < _devices.size(); i++) {
+            _devices[i]->update();
+            if (!_samples.push(*(_devices[i])))
+                _droppedSamples.fetchAndAddRelaxed(1);
+        }
+        nextSampleTime += _periodNsecs;
+        qint64 now = timer.nsecsElapsed();
+        if (nextSampleTime > now) {
+            QThread::usleep((nextSampleTime - now) / 1000);
+        } else {
+            // We fell behind. Do not try to catch up with a burst of samples.
+            nextSampleTime = now;
+        }
+    }
+}
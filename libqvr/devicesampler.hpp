@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_DEVICESAMPLER_HPP
+#define QVR_DEVICESAMPLER_HPP
+
+#include <QThread>
+#include <QList>
+
+#include "device.hpp"
+#include "ringbuffer.hpp"
+
+class QVRDeviceConfig;
+
+/* A thread that updates devices at a fixed rate, independent of the frame
+ * rate, and queues a copy of each device state as a sample.
+ *
+ * The sampler takes ownership of the devices it is given; from then on only
+ * the sampler thread calls QVRDevice::update() on them. The main thread pops
+ * the samples once per frame.
+ *
+ * Only devices whose state comes from sources that can be queried from any
+ * thread can be sampled; see canSample(). Oculus, OpenVR, Google VR, and
+ * gamepad devices depend on global state that is updated by the main thread
+ * or on Qt objects that live in the main thread.
+ *
+ * This is only used internally. */
+class QVRDeviceSampler : public QThread
+{
+private:
+    QList<QVRDevice*> _devices;
+    qint64 _periodNsecs;
+    QVRRingBuffer<QVRDevice> _samples;
+    QAtomicInt _droppedSamples;
+    QAtomicInt _exitWanted;
+
+protected:
+    void run() override;
+
+public:
+    QVRDeviceSampler(const QList<QVRDevice*>& devices, int rate);
+    ~QVRDeviceSampler();
+
+    static bool canSample(const QVRDeviceConfig& config);
+
+    int capacity() const { return _samples.capacity(); }
+
+    /* To be called from the main thread only. Returns false if there are no more samples. */
+    bool popSample(QVRDevice* sample) { return _samples.pop(sample); }
+    /* Return the number of samples that were dropped because the queue was full,
+     * and reset it to zero. */
+    int takeDroppedSampleCount() { return _droppedSamples.fetchAndStoreRelaxed(0); }
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_DEVICEWIRE_HPP
+#define QVR_DEVICEWIRE_HPP
+
+#include <QtGlobal>
+
+#include "device.hpp"
+
+/* Fixed-layout representation of the device state for serialization.
+ * This is written and read with a single raw copy instead of field-by-field
+ * QDataStream operations. It is internal to libqvr, so the layout of the
+ * public QVRDevice class is not affected. Deserializing into a device that
+ * already has the right number of buttons and analogs does not allocate
+ * memory. All processes run the same binary, so native byte order and float
+ * format are used. */
+struct QVRDeviceWireData {
+    qint64 timestamp;
+    qint32 index;
+    float position[3];
+    float orientation[4]; // scalar, x, y, z
+    float velocity[3];
+    float angularVelocity[3];
+    quint32 buttons; // bit i is set if button i is pressed
+    float analogs[QVR_Analog_Unknown];
+    qint8 buttonCount;
+    qint8 analogCount;
+    signed char buttonsMap[QVR_Button_Unknown];
+    signed char analogsMap[QVR_Analog_Unknown];
+};
+
+#endif
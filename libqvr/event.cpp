@@ -22,9 +22,13 @@
  * SOFTWARE.
  */
 
+#include <cstring>
+
+#include <QtAlgorithms>
 #include <QDataStream>
 
 #include "event.hpp"
+#include "logging.hpp"
 
 
 QVREvent::QVREvent() :
@@ -72,109 +76,371 @@ QVREvent::QVREvent(QVREventType t, const QVRDeviceEvent& e) :
     deviceEvent(e)
 {}
 
-QDataStream &operator<<(QDataStream& ds, const QVREvent& e)
+QVREventRing::QVREventRing(int capacity) :
+    _events(capacity),
+    _head(0),
+    _size(0)
+{
+}
+
+bool QVREventRing::coalesce(const QVREvent& e)
+{
+    if (_size == 0)
+        return false;
+    QVREvent& last = _events[(_head + _size - 1) % _events.size()];
+    if (last.type != e.type
+            || last.context.processIndex() != e.context.processIndex()
+            || last.context.windowIndex() != e.context.windowIndex())
+        return false;
+    if (e.type == QVR_Event_MouseMove) {
+        if (last.mouseEvent.buttons() != e.mouseEvent.buttons()
+                || last.mouseEvent.modifiers() != e.mouseEvent.modifiers())
+            return false;
+        last.context = e.context;
+        last.mouseEvent = e.mouseEvent;
+        return true;
+    } else if (e.type == QVR_Event_Wheel) {
+        if (last.wheelEvent.buttons() != e.wheelEvent.buttons()
+                || last.wheelEvent.modifiers() != e.wheelEvent.modifiers()
+                || last.wheelEvent.phase() != e.wheelEvent.phase()
+                || last.wheelEvent.inverted() != e.wheelEvent.inverted())
+            return false;
+        QPoint pixelDelta = last.wheelEvent.pixelDelta() + e.wheelEvent.pixelDelta();
+        QPoint angleDelta = last.wheelEvent.angleDelta() + e.wheelEvent.angleDelta();
+        last.context = e.context;
+        last.wheelEvent = QWheelEvent(e.wheelEvent.position(), e.wheelEvent.globalPosition(),
+                pixelDelta, angleDelta, e.wheelEvent.buttons(), e.wheelEvent.modifiers(),
+                e.wheelEvent.phase(), e.wheelEvent.inverted());
+        return true;
+    }
+    return false;
+}
+
+void QVREventRing::grow()
+{
+    QVector<QVREvent> events(2 * _events.size());
+    for (int i = 0; i < _size; i++)
+        events[i] = _events[(_head + i) % _events.size()];
+    _events.swap(events);
+    _head = 0;
+    QVR_DEBUG("event queue was full; grew it to %d events", _events.size());
+}
+
+void QVREventRing::enqueue(const QVREvent& e)
+{
+    if (coalesce(e))
+        return;
+    if (_size == _events.size())
+        grow();
+    _events[(_head + _size) % _events.size()] = e;
+    _size++;
+}
+
+void QVREventRing::dequeue()
+{
+    Q_ASSERT(_size > 0);
+    _head = (_head + 1) % _events.size();
+    _size--;
+}
+
+QVRDeviceEventDetector::QVRDeviceEventDetector() :
+    _lastButtons(),
+    _lastAnalogs()
+{
+}
+
+void QVRDeviceEventDetector::addDevice(const QVRDevice& dev)
+{
+    _lastButtons.append(dev.buttonBits());
+    for (int a = 0; a < QVR_Analog_Unknown; a++)
+        _lastAnalogs.append(a < dev.analogCount() ? dev._analogs[a] : 0.0f);
+}
+
+void QVRDeviceEventDetector::detect(int d, const QVRDevice& dev, QVREventRing* queue)
+{
+    quint32 buttons = dev.buttonBits();
+    quint32 changedButtons = buttons ^ _lastButtons[d];
+    float* lastAnalogs = _lastAnalogs.data() + d * QVR_Analog_Unknown;
+    bool analogsChanged = (std::memcmp(lastAnalogs, dev._analogs.constData(),
+                dev.analogCount() * sizeof(float)) != 0);
+    if (!changedButtons && !analogsChanged)
+        return;
+    while (changedButtons) {
+        int b = qCountTrailingZeroBits(changedButtons);
+        changedButtons &= changedButtons - 1;
+        queue->enqueue(QVREvent((buttons & (quint32(1) << b))
+                    ? QVR_Event_DeviceButtonPress : QVR_Event_DeviceButtonRelease,
+                    QVRDeviceEvent(dev, b, -1)));
+    }
+    if (analogsChanged) {
+        for (int a = 0; a < dev.analogCount(); a++) {
+            if (lastAnalogs[a] != dev._analogs[a]) {
+                queue->enqueue(QVREvent(QVR_Event_DeviceAnalogChange,
+                            QVRDeviceEvent(dev, -1, a)));
+            }
+        }
+        std::memcpy(lastAnalogs, dev._analogs.constData(), dev.analogCount() * sizeof(float));
+    }
+    _lastButtons[d] = buttons;
+}
+
+/* Fixed-layout payloads of the compact event encoding. */
+
+
+struct QVRKeyEventWireData {
+    qint32 type;
+    qint32 key;
+    qint32 modifiers;
+};
+
+struct QVRMouseEventWireData {
+    double localPos[2];
+    qint32 type;
+    qint32 button;
+    qint32 buttons;
+    qint32 modifiers;
+};
+
+struct QVRWheelEventWireData {
+    double position[2];
+    double globalPosition[2];
+    qint32 pixelDelta[2];
+    qint32 angleDelta[2];
+    qint32 buttons;
+    qint32 modifiers;
+    qint32 phase;
+    qint32 inverted;
+};
+
+static const unsigned char QVREventTagHasContext = 0x80;
+
+static void QVRRectToWire(const QRect& r, qint32* w)
 {
-    ds << static_cast<int>(e.type);
+    w[0] = r.x();
+    w[1] = r.y();
+    w[2] = r.width();
+    w[3] = r.height();
+}
+
+static void QVRVector3DToWire(const QVector3D& v, float* w)
+{
+    w[0] = v.x();
+    w[1] = v.y();
+    w[2] = v.z();
+}
+
+static void QVRQuaternionToWire(const QQuaternion& q, float* w)
+{
+    w[0] = q.scalar();
+    w[1] = q.x();
+    w[2] = q.y();
+    w[3] = q.z();
+}
+
+static void QVRRenderContextToWire(const QVRRenderContext& rc, QVRRenderContextWireData* w)
+{
+    std::memset(w, 0, sizeof(*w));
+    w->trackingTimestamp = rc.trackingTimestamp();
+    w->processIndex = rc.processIndex();
+    w->windowIndex = rc.windowIndex();
+    QVRRectToWire(rc.windowGeometry(), w->windowGeometry);
+    QVRRectToWire(rc.screenGeometry(), w->screenGeometry);
+    QVRVector3DToWire(rc.navigationPosition(), w->navigationPosition);
+    QVRQuaternionToWire(rc.navigationOrientation(), w->navigationOrientation);
+    QVRVector3DToWire(rc.screenWallBottomLeft(), w->screenWall[0]);
+    QVRVector3DToWire(rc.screenWallBottomRight(), w->screenWall[1]);
+    QVRVector3DToWire(rc.screenWallTopLeft(), w->screenWall[2]);
+    w->outputMode = rc.outputMode();
+    w->viewCount = rc.viewCount();
+    for (int i = 0; i < rc.viewCount(); i++) {
+        w->eye[i] = rc.eye(i);
+        w->textureSize[i][0] = rc.textureSize(i).width();
+        w->textureSize[i][1] = rc.textureSize(i).height();
+        QVRVector3DToWire(rc.trackingPosition(i), w->trackingPosition[i]);
+        QVRQuaternionToWire(rc.trackingOrientation(i), w->trackingOrientation[i]);
+        rc.frustum(i).getClippingPlanes(w->frustum[i]);
+        std::memcpy(w->viewMatrix[i], rc.viewMatrix(i).constData(), 16 * sizeof(float));
+        std::memcpy(w->viewMatrixPure[i], rc.viewMatrixPure(i).constData(), 16 * sizeof(float));
+    }
+}
+
+void QVRRenderContextFromWire(const QVRRenderContextWireData& w, QVRRenderContext& rc)
+{
+    rc._trackingTimestamp = w.trackingTimestamp;
+    rc._processIndex = w.processIndex;
+    rc._windowIndex = w.windowIndex;
+    rc._windowGeometry = QRect(w.windowGeometry[0], w.windowGeometry[1], w.windowGeometry[2], w.windowGeometry[3]);
+    rc._screenGeometry = QRect(w.screenGeometry[0], w.screenGeometry[1], w.screenGeometry[2], w.screenGeometry[3]);
+    rc._navigationPosition = QVector3D(w.navigationPosition[0], w.navigationPosition[1], w.navigationPosition[2]);
+    rc._navigationOrientation = QQuaternion(w.navigationOrientation[0], w.navigationOrientation[1],
+            w.navigationOrientation[2], w.navigationOrientation[3]);
+    for (int i = 0; i < 3; i++)
+        rc._screenWall[i] = QVector3D(w.screenWall[i][0], w.screenWall[i][1], w.screenWall[i][2]);
+    rc._outputMode = static_cast<QVROutputMode>(w.outputMode);
+    rc._viewCount = qBound(0, int(w.viewCount), 2);
+    for (int i = 0; i < rc._viewCount; i++) {
+        rc._eye[i] = static_cast<QVREye>(w.eye[i]);
+        rc._textureSize[i] = QSize(w.textureSize[i][0], w.textureSize[i][1]);
+        rc._trackingPosition[i] = QVector3D(w.trackingPosition[i][0], w.trackingPosition[i][1], w.trackingPosition[i][2]);
+        rc._trackingOrientation[i] = QQuaternion(w.trackingOrientation[i][0], w.trackingOrientation[i][1],
+                w.trackingOrientation[i][2], w.trackingOrientation[i][3]);
+        rc._frustum[i] = QVRFrustum(w.frustum[i]);
+        std::memcpy(rc._viewMatrix[i].data(), w.viewMatrix[i], 16 * sizeof(float));
+        std::memcpy(rc._viewMatrixPure[i].data(), w.viewMatrixPure[i], 16 * sizeof(float));
+    }
+}
+
+QVREventWriter::QVREventWriter() :
+    _haveLastContext(false)
+{
+}
+
+void QVREventWriter::reset()
+{
+    _haveLastContext = false;
+}
+
+void QVREventWriter::write(QDataStream& ds, const QVREvent& e)
+{
+    bool isDeviceEvent = (e.type == QVR_Event_DeviceButtonPress
+            || e.type == QVR_Event_DeviceButtonRelease
+            || e.type == QVR_Event_DeviceAnalogChange);
+    unsigned char tag = static_cast<unsigned char>(e.type);
+    QVRRenderContextWireData context;
+    if (!isDeviceEvent) {
+        QVRRenderContextToWire(e.context, &context);
+        if (!_haveLastContext || std::memcmp(&context, &_lastContext, sizeof(context)) != 0) {
+            tag |= QVREventTagHasContext;
+            std::memcpy(&_lastContext, &context, sizeof(context));
+            _haveLastContext = true;
+        }
+    }
+    ds.writeRawData(reinterpret_cast<const char*>(&tag), 1);
+    if (tag & QVREventTagHasContext)
+        ds.writeRawData(reinterpret_cast<const char*>(&context), sizeof(context));
+
     switch (e.type) {
     case QVR_Event_KeyPress:
     case QVR_Event_KeyRelease:
-        ds << e.context
-            << static_cast<int>(e.keyEvent.type())
-            << e.keyEvent.key()
-            << static_cast<int>(e.keyEvent.modifiers());
+        {
+            QVRKeyEventWireData w;
+            w.type = e.keyEvent.type();
+            w.key = e.keyEvent.key();
+            w.modifiers = e.keyEvent.modifiers();
+            ds.writeRawData(reinterpret_cast<const char*>(&w), sizeof(w));
+        }
         break;
     case QVR_Event_MouseMove:
     case QVR_Event_MousePress:
     case QVR_Event_MouseRelease:
     case QVR_Event_MouseDoubleClick:
-        ds << e.context
-            << static_cast<int>(e.mouseEvent.type())
-            << e.mouseEvent.localPos()
-            << static_cast<int>(e.mouseEvent.button())
-            << static_cast<int>(e.mouseEvent.buttons())
-            << static_cast<int>(e.mouseEvent.modifiers());
+        {
+            QVRMouseEventWireData w;
+            w.localPos[0] = e.mouseEvent.localPos().x();
+            w.localPos[1] = e.mouseEvent.localPos().y();
+            w.type = e.mouseEvent.type();
+            w.button = e.mouseEvent.button();
+            w.buttons = e.mouseEvent.buttons();
+            w.modifiers = e.mouseEvent.modifiers();
+            ds.writeRawData(reinterpret_cast<const char*>(&w), sizeof(w));
+        }
         break;
     case QVR_Event_Wheel:
-        ds << e.context
-            << e.wheelEvent.position()
-            << e.wheelEvent.globalPosition()
-            << e.wheelEvent.pixelDelta()
-            << e.wheelEvent.angleDelta()
-            << static_cast<int>(e.wheelEvent.buttons())
-            << static_cast<int>(e.wheelEvent.modifiers())
-            << static_cast<int>(e.wheelEvent.phase())
-            << static_cast<int>(e.wheelEvent.inverted());
+        {
+            QVRWheelEventWireData w;
+            w.position[0] = e.wheelEvent.position().x();
+            w.position[1] = e.wheelEvent.position().y();
+            w.globalPosition[0] = e.wheelEvent.globalPosition().x();
+            w.globalPosition[1] = e.wheelEvent.globalPosition().y();
+            w.pixelDelta[0] = e.wheelEvent.pixelDelta().x();
+            w.pixelDelta[1] = e.wheelEvent.pixelDelta().y();
+            w.angleDelta[0] = e.wheelEvent.angleDelta().x();
+            w.angleDelta[1] = e.wheelEvent.angleDelta().y();
+            w.buttons = e.wheelEvent.buttons();
+            w.modifiers = e.wheelEvent.modifiers();
+            w.phase = e.wheelEvent.phase();
+            w.inverted = e.wheelEvent.inverted();
+            ds.writeRawData(reinterpret_cast<const char*>(&w), sizeof(w));
+        }
         break;
     case QVR_Event_DeviceButtonPress:
     case QVR_Event_DeviceButtonRelease:
     case QVR_Event_DeviceAnalogChange:
-        ds << e.deviceEvent.device()
-            << e.deviceEvent.buttonIndex()
-            << e.deviceEvent.analogIndex();
+        {
+            qint32 indices[2] = { e.deviceEvent.buttonIndex(), e.deviceEvent.analogIndex() };
+            ds << e.deviceEvent.device();
+            ds.writeRawData(reinterpret_cast<const char*>(indices), sizeof(indices));
+        }
+        break;
     }
-    return ds;
 }
 
-QDataStream &operator>>(QDataStream& ds, QVREvent& e)
+QVREventReader::QVREventReader()
+{
+}
+
+void QVREventReader::reset()
 {
-    int type;
-    ds >> type;
-    e.type = static_cast<QVREventType>(type);
+    _lastContext = QVRRenderContext();
+}
 
-    int ke[3];
-    int me[4];
-    QPointF mepf;
-    QPointF wepf[2];
-    QPoint wep[2];
-    int we[4];
-    QVRDevice d;
-    int de[2];
+void QVREventReader::read(QDataStream& ds, QVREvent& e)
+{
+    unsigned char tag;
+    ds.readRawData(reinterpret_cast<char*>(&tag), 1);
+    if (tag & QVREventTagHasContext) {
+        QVRRenderContextWireData context;
+        ds.readRawData(reinterpret_cast<char*>(&context), sizeof(context));
+        QVRRenderContextFromWire(context, _lastContext);
+    }
+    e.type = static_cast<QVREventType>(tag & ~QVREventTagHasContext);
 
     switch (e.type) {
     case QVR_Event_KeyPress:
     case QVR_Event_KeyRelease:
-        ds >> e.context
-            >> ke[0]
-            >> ke[1]
-            >> ke[2];
-        e.keyEvent = QKeyEvent(static_cast<QEvent::Type>(ke[0]), ke[1], static_cast<Qt::KeyboardModifier>(ke[2]));
+        {
+            QVRKeyEventWireData w;
+            ds.readRawData(reinterpret_cast<char*>(&w), sizeof(w));
+            e.context = _lastContext;
+            e.keyEvent = QKeyEvent(static_cast<QEvent::Type>(w.type), w.key,
+                    static_cast<Qt::KeyboardModifiers>(w.modifiers));
+        }
         break;
     case QVR_Event_MouseMove:
     case QVR_Event_MousePress:
     case QVR_Event_MouseRelease:
     case QVR_Event_MouseDoubleClick:
-        ds >> e.context
-            >> me[0]
-            >> mepf
-            >> me[1]
-            >> me[2]
-            >> me[3];
-        e.mouseEvent = QMouseEvent(static_cast<QEvent::Type>(me[0]), mepf,
-                static_cast<Qt::MouseButton>(me[1]), static_cast<Qt::MouseButtons>(me[2]),
-                static_cast<Qt::KeyboardModifier>(me[3]));
+        {
+            QVRMouseEventWireData w;
+            ds.readRawData(reinterpret_cast<char*>(&w), sizeof(w));
+            e.context = _lastContext;
+            e.mouseEvent = QMouseEvent(static_cast<QEvent::Type>(w.type), QPointF(w.localPos[0], w.localPos[1]),
+                    static_cast<Qt::MouseButton>(w.button), static_cast<Qt::MouseButtons>(w.buttons),
+                    static_cast<Qt::KeyboardModifiers>(w.modifiers));
+        }
         break;
     case QVR_Event_Wheel:
-        ds >> e.context
-            >> wepf[0]
-            >> wepf[1]
-            >> wep[0]
-            >> wep[1]
-            >> we[0]
-            >> we[1]
-            >> we[2]
-            >> we[3];
-        e.wheelEvent = QWheelEvent(wepf[0], wepf[1], wep[0], wep[1], 
-                static_cast<Qt::MouseButtons>(we[0]), static_cast<Qt::KeyboardModifier>(we[1]),
-                static_cast<Qt::ScrollPhase>(we[3]), static_cast<bool>(we[4]));
+        {
+            QVRWheelEventWireData w;
+            ds.readRawData(reinterpret_cast<char*>(&w), sizeof(w));
+            e.context = _lastContext;
+            e.wheelEvent = QWheelEvent(QPointF(w.position[0], w.position[1]),
+                    QPointF(w.globalPosition[0], w.globalPosition[1]),
+                    QPoint(w.pixelDelta[0], w.pixelDelta[1]), QPoint(w.angleDelta[0], w.angleDelta[1]),
+                    static_cast<Qt::MouseButtons>(w.buttons), static_cast<Qt::KeyboardModifiers>(w.modifiers),
+                    static_cast<Qt::ScrollPhase>(w.phase), static_cast<bool>(w.inverted));
+        }
         break;
     case QVR_Event_DeviceButtonPress:
     case QVR_Event_DeviceButtonRelease:
     case QVR_Event_DeviceAnalogChange:
-        ds >> d
-            >> de[0]
-            >> de[1];
-        e.deviceEvent = QVRDeviceEvent(d, de[0], de[1]);
+        {
+            QVRDevice d;
+            qint32 indices[2];
+            ds >> d;
+            ds.readRawData(reinterpret_cast<char*>(indices), sizeof(indices));
+            e.deviceEvent = QVRDeviceEvent(d, indices[0], indices[1]);
+        }
         break;
     }
-    return ds;
 }
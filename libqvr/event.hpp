@@ -28,6 +28,7 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QMatrix4x4>
+#include <QVector>
 
 #include "device.hpp"
 #include "rendercontext.hpp"
@@ -64,7 +65,103 @@ public:
     QVREvent(QVREventType t, const QVRDeviceEvent& e);
 };
 
-QDataStream &operator<<(QDataStream& ds, const QVREvent& e);
-QDataStream &operator>>(QDataStream& ds, QVREvent& e);
+/* A bounded FIFO queue of events, backed by a preallocated ring buffer.
+ * Consecutive mouse move events and consecutive wheel events from the same
+ * window are coalesced when they are enqueued, since only the latest pointer
+ * position and the accumulated wheel delta are of interest. No other events
+ * are ever merged or dropped: if the queue is full, its capacity is doubled. */
+class QVREventRing
+{
+private:
+    QVector<QVREvent> _events;
+    int _head;
+    int _size;
+
+    bool coalesce(const QVREvent& e);
+    void grow();
+
+public:
+    QVREventRing(int capacity = 512);
+
+    bool empty() const { return _size == 0; }
+    int size() const { return _size; }
+    void enqueue(const QVREvent& e);
+    const QVREvent& front() const { return _events[_head]; }
+    void dequeue();
+};
+
+/* Generation of device button and analog events from successive states of
+ * a set of devices. The common case is that nothing changed, so the packed
+ * button bits and the raw analog values of a device are first compared as a
+ * whole, and only then the details are examined. */
+class QVRDeviceEventDetector
+{
+private:
+    QVector<quint32> _lastButtons; // packed button states of the last check
+    QVector<float> _lastAnalogs;   // analog values of the last check, QVR_Analog_Unknown per device
+
+public:
+    QVRDeviceEventDetector();
+
+    // Add a device with the given initial state; devices are indexed in the
+    // order in which they are added
+    void addDevice(const QVRDevice& dev);
+    // Enqueue events for all changes of the device since the last check
+    void detect(int deviceIndex, const QVRDevice& dev, QVREventRing* queue);
+};
+
+/* Compact binary encoding of events for inter-process communication.
+ * Each event is a one-byte tag (the event type, plus a flag that says
+ * whether a render context follows) and a fixed-layout payload. The render
+ * context is only written if it differs from the one of the previous event
+ * in the same stream; all events of one window in one frame share it.
+ * A writer and the reader of the same stream must be reset at the same
+ * point, e.g. at the start of each serialized event list.
+ * All processes run the same binary, so native byte order is used. */
+
+struct QVRRenderContextWireData {
+    qint64 trackingTimestamp;
+    qint32 processIndex;
+    qint32 windowIndex;
+    qint32 windowGeometry[4];
+    qint32 screenGeometry[4];
+    float navigationPosition[3];
+    float navigationOrientation[4]; // scalar, x, y, z
+    float screenWall[3][3];
+    qint32 outputMode;
+    qint32 viewCount;
+    qint32 eye[2];
+    qint32 textureSize[2][2];
+    float trackingPosition[2][3];
+    float trackingOrientation[2][4]; // scalar, x, y, z
+    float frustum[2][6];
+    float viewMatrix[2][16]; // column-major
+    float viewMatrixPure[2][16]; // column-major
+};
+
+class QVREventWriter
+{
+private:
+    QVRRenderContextWireData _lastContext;
+    bool _haveLastContext;
+
+public:
+    QVREventWriter();
+
+    void reset();
+    void write(QDataStream& ds, const QVREvent& e);
+};
+
+class QVREventReader
+{
+private:
+    QVRRenderContext _lastContext;
+
+public:
+    QVREventReader();
+
+    void reset();
+    void read(QDataStream& ds, QVREvent& e);
+};
 
 #endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QGuiApplication>
+#include <QScreen>
+
+#include "framescheduler.hpp"
+#include "internalglobals.hpp"
+
+
+// Remaining wait time below which we spin instead of sleep
+static const qint64 QVRFrameSchedulerSpinNsecs = 2000000;
+// Safety margin for the vsync policy, as a fraction of the refresh period
+static const float QVRFrameSchedulerVSyncMargin = 0.15f;
+
+QVRFrameScheduler::QVRFrameScheduler() :
+    _policy(Free),
+    _periodNsecs(0),
+    _frameStartNsecs(-1),
+    _lastSwapNsecs(-1),
+    _workNsecs(0)
+{
+}
+
+bool QVRFrameScheduler::setPolicy(const QString& spec)
+{
+    if (spec == "free") {
+        _policy = Free;
+        _periodNsecs = 0;
+    } else if (spec == "vsync") {
+        _policy = VSync;
+        // initial guess; this is replaced by measurements
+        QScreen* screen = QGuiApplication::primaryScreen();
+        qreal rate = (screen ? screen->refreshRate() : 60.0);
+        _periodNsecs = static_cast<qint64>(1e9 / (rate > 0.0 ? rate : 60.0));
+    } else if (spec.startsWith("fixed:")) {
+        bool ok;
+        double rate = spec.mid(6).toDouble(&ok);
+        if (!ok || rate <= 0.0)
+            return false;
+        _policy = Fixed;
+        _periodNsecs = static_cast<qint64>(1e9 / rate);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+qint64 QVRFrameScheduler::nextFrameStart() const
+{
+    if (_policy == Fixed && _frameStartNsecs >= 0) {
+        return _frameStartNsecs + _periodNsecs;
+    } else if (_policy == VSync && _lastSwapNsecs >= 0 && _periodNsecs > 0) {
+        qint64 margin = static_cast<qint64>(QVRFrameSchedulerVSyncMargin * _periodNsecs);
+        return _lastSwapNsecs + _periodNsecs - _workNsecs - margin;
+    }
+    return -1;
+}
+
+void QVRFrameScheduler::waitForFrameStart()
+{
+    qint64 target = nextFrameStart();
+    qint64 now = QVRTimer.nsecsElapsed();
+    if (target >= 0) {
+        if (_policy == Fixed && now > target + _periodNsecs) {
+            // We missed more than a complete frame. Do not try to catch up,
+            // since that would render a burst of frames.
+            target = now;
+        }
+        while (now < target) {
+            qint64 remaining = target - now;
+            if (remaining > QVRFrameSchedulerSpinNsecs) {
+                // Coarse wait: handle events for at most the time we have, then sleep
+                int eventMsecs = (remaining - QVRFrameSchedulerSpinNsecs) / 1000000;
+                if (eventMsecs > 0)
+                    QGuiApplication::processEvents(QEventLoop::AllEvents, eventMsecs);
+                now = QVRTimer.nsecsElapsed();
+                remaining = target - now;
+                if (remaining > QVRFrameSchedulerSpinNsecs)
+                    QThread::usleep((remaining - QVRFrameSchedulerSpinNsecs) / 1000);
+            } else {
+                // Fine wait
+                QThread::yieldCurrentThread();
+            }
+            now = QVRTimer.nsecsElapsed();
+        }
+    }
+    _frameStartNsecs = (_policy == Fixed && target >= 0 ? target : now);
+}
+
+void QVRFrameScheduler::frameSwapped()
+{
+    if (_policy != VSync)
+        return;
+    qint64 now = QVRTimer.nsecsElapsed();
+    if (_frameStartNsecs >= 0) {
+        // Measure the time from frame start to buffer swap completion. A frame
+        // that was started as planned and made it in time completes at the
+        // refresh, after the safety margin that we deliberately left; that
+        // margin is not part of the work.
+        qint64 work = now - _frameStartNsecs;
+        qint64 plannedSwap = (_lastSwapNsecs >= 0 && _periodNsecs > 0 ? _lastSwapNsecs + _periodNsecs : -1);
+        if (plannedSwap >= 0 && now < plannedSwap + _periodNsecs / 2)
+            work -= static_cast<qint64>(QVRFrameSchedulerVSyncMargin * _periodNsecs);
+        // adapt quickly to longer frames, slowly to shorter ones
+        if (work > _workNsecs)
+            _workNsecs = work;
+        else
+            _workNsecs += (work - _workNsecs) / 16;
+    }
+    if (_lastSwapNsecs >= 0) {
+        // Measure the refresh period. An interval may span several refreshes
+        // if we missed one; only intervals close to a single period are used.
+        qint64 interval = now - _lastSwapNsecs;
+        if (interval > _periodNsecs / 2 && interval < _periodNsecs * 3 / 2)
+            _periodNsecs += (interval - _periodNsecs) / 16;
+    }
+    _lastSwapNsecs = now;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_FRAMESCHEDULER_HPP
+#define QVR_FRAMESCHEDULER_HPP
+
+#include <QtGlobal>
+
+class QString;
+
+/* Decides when the main process starts the next frame.
+ *
+ * Policies:
+ * - free: start each frame as soon as the previous one is done (the default).
+ * - fixed:<hz>: start frames at a fixed rate. Waiting is done by sleeping until
+ *   shortly before the deadline and spinning for the rest, since sleeping alone
+ *   is too imprecise on most systems.
+ * - vsync: align frame starts with the display refresh. The refresh period is
+ *   measured from the buffer swap completion times, and each frame starts as
+ *   late as possible so that it is done just before the next refresh, based on
+ *   the measured time from frame start to buffer swap. This minimizes latency.
+ *
+ * While waiting, Qt events are processed, but never longer than the wait time,
+ * so that event processing cannot delay frames.
+ *
+ * All times are QVRTimer nanoseconds.
+ *
+ * This is only used internally. */
+class QVRFrameScheduler
+{
+public:
+    enum Policy { Free, Fixed, VSync };
+
+private:
+    Policy _policy;
+    qint64 _periodNsecs;       // fixed: target period; vsync: measured refresh period (0 if unknown)
+    qint64 _frameStartNsecs;   // start of the current frame, or -1
+    qint64 _lastSwapNsecs;     // vsync: completion of the last buffer swap, or -1
+    qint64 _workNsecs;         // vsync: measured time from frame start to buffer swap completion
+
+    qint64 nextFrameStart() const;
+
+public:
+    QVRFrameScheduler();
+
+    /* Set the policy from a string of the form free, fixed:<hz>, or vsync.
+     * Returns false if the string is invalid; the policy is unchanged then. */
+    bool setPolicy(const QString& spec);
+    Policy policy() const { return _policy; }
+
+    /* Wait until the next frame should start, processing Qt events meanwhile. */
+    void waitForFrameStart();
+    /* Report that the buffer swaps of the current frame are complete. */
+    void frameSwapped();
+};
+
+#endif
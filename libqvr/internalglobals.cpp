@@ -84,10 +84,18 @@ void QVRMatrixToPose(const QMatrix4x4& matrix, QQuaternion* orientation, QVector
 }
 
 /* Global event queue */
-QQueue<QVREvent>* QVREventQueue = NULL;
+QVREventRing* QVREventQueue = NULL;
 
 /* Global timer */
 QElapsedTimer QVRTimer;
+QVRClusterClock QVRClusterTimer;
+qint64 QVRClusterTime()
+{
+    return QVRClusterTimer.toClusterTime(QVRTimer.nsecsElapsed());
+}
+
+/* Global latency probe */
+QVRLatencyHistogram* QVRLatencyProbe = NULL;
 
 /* Global renderable device model data */
 QList<QVector<float>> QVRDeviceModelVertexPositions;
@@ -27,7 +27,6 @@
 #include <QMatrix4x4>
 #include <QQuaternion>
 #include <QVector3D>
-#include <QQueue>
 #include <QElapsedTimer>
 #include <QList>
 #include <QVector>
@@ -36,7 +35,9 @@
 #include <QSizeF>
 
 #include "event.hpp"
+#include "clocksync.hpp"
 class QVRManager;
+class QVRLatencyHistogram;
 
 
 /* Global manager instance (singleton) */
@@ -53,10 +54,18 @@ void QVRGetScreenInfo();
 void QVRMatrixToPose(const QMatrix4x4& matrix, QQuaternion* orientation, QVector3D* position);
 
 /* Global event queue */
-extern QQueue<QVREvent>* QVREventQueue;
+extern QVREventRing* QVREventQueue;
 
 /* Global timer */
 extern QElapsedTimer QVRTimer;
+/* Global cluster time: the QVRTimer time of the main process, in nanoseconds.
+ * Child processes map their QVRTimer to it via clock synchronization with the
+ * main process. Use this for all timestamps that are compared across processes. */
+extern QVRClusterClock QVRClusterTimer;
+qint64 QVRClusterTime();
+
+/* Global latency probe (NULL unless --qvr-latency-probe is given) */
+extern QVRLatencyHistogram* QVRLatencyProbe;
 
 /* Global renderable device model data */
 extern QList<QVector<float>> QVRDeviceModelVertexPositions;
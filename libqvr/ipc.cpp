@@ -33,17 +33,24 @@
 #include <QUuid>
 #include <QThread>
 #include <QElapsedTimer>
+#include <QProcess>
 
 #include "event.hpp"
 #include "app.hpp"
 #include "device.hpp"
 #include "observer.hpp"
+#include "config.hpp"
 #include "logging.hpp"
+#include "trace.hpp"
+#include "internalglobals.hpp"
 #include "ipc.hpp"
 
 
 int QVRTimeoutMsecs = -1; // the default is to never timeout
 
+/* Time after which replies to clock synchronization commands are overdue. */
+static const int QVRClockSyncPollMsecs = 100;
+
 /* QVRSharedMemoryDevice
  *
  * This implements a sequential device with one writer and n>=1 readers as a ringbuffer
@@ -85,7 +92,8 @@ public:
     virtual bool open(OpenMode /* mode */) { return false; } // you need to use openWriter() or openReader()
     bool openWriter();
     bool openReader(int readerIndex);
-    bool waitForReaderConnection(int readerIndex);
+    bool isReaderConnected(int readerIndex) const { return _readerConnected[readerIndex]; }
+    void disconnectReader(int readerIndex) { _readerConnected[readerIndex] = 0; } // ignore a reader that died
     virtual bool isSequential() const { return true; }
     virtual qint64 bytesAvailable() const { return bytesAvailable(writePos(), _reader); }
     virtual bool waitForReadyRead(int msecs);
@@ -125,20 +133,6 @@ bool QVRSharedMemoryDevice::openReader(int readerIndex)
     return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
 }
 
-bool QVRSharedMemoryDevice::waitForReaderConnection(int i)
-{
-    Q_ASSERT(i >= 0 && i < _readers);
-    if (QVRTimeoutMsecs <= 0) {
-        while (_readerConnected[i] == 0)
-            QThread::msleep(10);
-        return true;
-    } else {
-        if (_readerConnected[i] == 0)
-            QThread::msleep(QVRTimeoutMsecs);
-        return _readerConnected[i];
-    }
-}
-
 int QVRSharedMemoryDevice::bytesAvailable(int wP, int readerIndex) const
 {
     int rP = readPos(readerIndex);
@@ -152,8 +146,10 @@ int QVRSharedMemoryDevice::bytesAvailable(int wP, int readerIndex) const
 int QVRSharedMemoryDevice::bytesAvailableForWriting() const
 {
     int wP = writePos();
-    int maxBytesAvailable = bytesAvailable(wP, 0);
-    for (int i = 1; i < _readers; i++) {
+    int maxBytesAvailable = 0;
+    for (int i = 0; i < _readers; i++) {
+        if (!_readerConnected[i])
+            continue;
         int ba = bytesAvailable(wP, i);
         if (ba > maxBytesAvailable)
             maxBytesAvailable = ba;
@@ -266,29 +262,38 @@ qint64 QVRSharedMemoryDevice::writeData(const char* data, qint64 maxSize)
 static const int QVRSharedMemoryServerDeviceSize = 1024 * 1024; // Shared memory size for server->client device
 static const int QVRSharedMemoryClientDeviceSize = 2048; // Shared memory size for client->server device
 
-static void QVRGetSharedMemServerConfigs(int* serverDeviceCount, int* coupledClientCount,
+// The shared memory starts with the serialized configuration of the main process,
+// preceded by its size. The devices follow, aligned to 8 bytes.
+static int QVRSharedMemoryConfigAreaSize(int serializedConfigSize)
+{
+    return (sizeof(int) + serializedConfigSize + 7) / 8 * 8;
+}
+
+static void QVRGetSharedMemServerConfigs(const QVRConfig& config, int processIndex,
+        int* serverDeviceCount, int* coupledClientCount,
         int* serverIndexForThisProcess, int* coupledClientIndexForThisProcess)
 {
+    const QList<QVRProcessConfig>& processConfigs = config.processConfigs();
     *serverDeviceCount = 0;
     *coupledClientCount = 0;
     *serverIndexForThisProcess = 0;
     *coupledClientIndexForThisProcess = 0;
-    for (int p = 1; p < QVRManager::processCount(); p++) {
-        if (QVRManager::processConfig(p).decoupledRendering()) {
+    for (int p = 1; p < processConfigs.size(); p++) {
+        if (processConfigs[p].decoupledRendering()) {
             (*serverDeviceCount)++;
         } else {
             if (*coupledClientCount == 0)
                 (*serverDeviceCount)++;
-            if (p == QVRManager::processIndex())
+            if (p == processIndex)
                 (*coupledClientIndexForThisProcess) = (*coupledClientCount);
             (*coupledClientCount)++;
         }
     }
-    if (QVRManager::processConfig(QVRManager::processIndex()).decoupledRendering()) {
+    if (processConfigs[processIndex].decoupledRendering()) {
         if (*coupledClientCount > 0)
             *serverIndexForThisProcess = 1;
-        for (int p = 1; p < QVRManager::processIndex(); p++)
-            if (QVRManager::processConfig(p).decoupledRendering())
+        for (int p = 1; p < processIndex; p++)
+            if (processConfigs[p].decoupledRendering())
                 (*serverIndexForThisProcess)++;
     }
 }
@@ -392,7 +397,7 @@ QIODevice* QVRClient::outputDevice()
     return dev;
 }
 
-bool QVRClient::start(const QString& serverName)
+bool QVRClient::start(const QString& serverName, QVRConfig* config)
 {
     Q_ASSERT(!_tcpSocket);
     Q_ASSERT(!_localSocket);
@@ -414,6 +419,8 @@ bool QVRClient::start(const QString& serverName)
         int pI = QVRManager::processIndex();
         QVRWriteData(outputDevice(), reinterpret_cast<char*>(&pI), sizeof(pI));
         flush();
+        if (!receiveConfig(config))
+            return false;
     } else if (args.length() == 2 && args[0] == "local") {
         QLocalSocket* socket = new QLocalSocket;
         socket->connectToServer(args[1]);
@@ -427,6 +434,8 @@ bool QVRClient::start(const QString& serverName)
         int pI = QVRManager::processIndex();
         QVRWriteData(outputDevice(), reinterpret_cast<char*>(&pI), sizeof(pI));
         flush();
+        if (!receiveConfig(config))
+            return false;
     } else if (args.length() == 2 && args[0] == "shmem") {
         QSharedMemory* sharedMem = new QSharedMemory(args[1]);
         if (!sharedMem->attach(QSharedMemory::ReadWrite)) {
@@ -436,24 +445,37 @@ bool QVRClient::start(const QString& serverName)
         }
         QVR_INFO("connected to shared memory %s", qPrintable(args[1]));
         _sharedMem = sharedMem;
+        int serializedConfigSize;
+        std::memcpy(&serializedConfigSize, sharedMem->constData(), sizeof(int));
+        QDataStream ds(QByteArray::fromRawData(static_cast<const char*>(sharedMem->constData()) + sizeof(int),
+                    serializedConfigSize));
+        ds >> *config;
+        int pI = QVRManager::processIndex();
+        if (ds.status() != QDataStream::Ok || pI >= config->processConfigs().size()) {
+            QVR_FATAL("invalid configuration in shared memory %s", qPrintable(args[1]));
+            return false;
+        }
+        char* devicesArea = static_cast<char*>(sharedMem->data())
+            + QVRSharedMemoryConfigAreaSize(serializedConfigSize);
+        bool decoupledRendering = config->processConfigs()[pI].decoupledRendering();
         int serverDeviceCount;
         int coupledClientCount;
         int serverIndexForThisProcess;
         int coupledClientIndexForThisProcess;
-        QVRGetSharedMemServerConfigs(
+        QVRGetSharedMemServerConfigs(*config, pI,
                 &serverDeviceCount,
                 &coupledClientCount,
                 &serverIndexForThisProcess,
                 &coupledClientIndexForThisProcess);
         _sharedMemServerDevice = new QVRSharedMemoryDevice(
-                QVRManager::processConfig().decoupledRendering() ? 1 : coupledClientCount,
-                static_cast<char*>(sharedMem->data()) + serverIndexForThisProcess * QVRSharedMemoryServerDeviceSize,
+                decoupledRendering ? 1 : coupledClientCount,
+                devicesArea + serverIndexForThisProcess * QVRSharedMemoryServerDeviceSize,
                 QVRSharedMemoryServerDeviceSize);
-        _sharedMemServerDevice->openReader(QVRManager::processConfig().decoupledRendering() ? 0
+        _sharedMemServerDevice->openReader(decoupledRendering ? 0
                 : coupledClientIndexForThisProcess);
         _sharedMemClientDevice = new QVRSharedMemoryDevice(1,
-                static_cast<char*>(sharedMem->data()) + serverDeviceCount * QVRSharedMemoryServerDeviceSize
-                + (QVRManager::processIndex() - 1) * QVRSharedMemoryClientDeviceSize,
+                devicesArea + serverDeviceCount * QVRSharedMemoryServerDeviceSize
+                + (pI - 1) * QVRSharedMemoryClientDeviceSize,
                 QVRSharedMemoryClientDeviceSize);
         _sharedMemClientDevice->openWriter();
     } else {
@@ -463,20 +485,47 @@ bool QVRClient::start(const QString& serverName)
     return true;
 }
 
+bool QVRClient::receiveConfig(QVRConfig* config)
+{
+    QVRClientCmd cmd;
+    if (!receiveCmd(&cmd, true) || cmd != QVRClientCmdConfig) {
+        QVR_FATAL("cannot receive configuration from main");
+        return false;
+    }
+    QVRReadData(inputDevice(), _data);
+    QDataStream ds(_data);
+    ds >> *config;
+    if (ds.status() != QDataStream::Ok || QVRManager::processIndex() >= config->processConfigs().size()) {
+        QVR_FATAL("received invalid configuration from main");
+        return false;
+    }
+    return true;
+}
+
 void QVRClient::sendReplyUpdateDevices(int n, const QByteArray& serializedDevices)
 {
+    QVR_TRACE_SCOPE("client send devices");
     QVRWriteData(outputDevice(), reinterpret_cast<char*>(&n), sizeof(n));
     QVRWriteData(outputDevice(), serializedDevices);
 }
 
-void QVRClient::sendCmdSync(int n, const QByteArray& serializedEvents)
+void QVRClient::sendCmdSync(int n, qint64 swapNsecs, const QByteArray& serializedEvents)
 {
+    QVR_TRACE_SCOPE("client send sync");
     QVRWriteData(outputDevice(), reinterpret_cast<char*>(&n), sizeof(n));
+    QVRWriteData(outputDevice(), reinterpret_cast<char*>(&swapNsecs), sizeof(swapNsecs));
     QVRWriteData(outputDevice(), serializedEvents);
 }
 
+void QVRClient::sendReplyClockSync(qint64 receiveNsecs)
+{
+    qint64 data[2] = { receiveNsecs, QVRTimer.nsecsElapsed() };
+    QVRWriteData(outputDevice(), reinterpret_cast<char*>(data), sizeof(data));
+}
+
 void QVRClient::flush()
 {
+    QVR_TRACE_SCOPE("client flush");
     if (_tcpSocket)
         _tcpSocket->flush();
     else if (_localSocket)
@@ -485,12 +534,15 @@ void QVRClient::flush()
 
 bool QVRClient::receiveCmd(QVRClientCmd* cmd, bool waitForIt)
 {
-    if (waitForIt && inputDevice()->bytesAvailable() == 0)
+    if (waitForIt && inputDevice()->bytesAvailable() == 0) {
+        QVR_TRACE_SCOPE("client wait for command");
         inputDevice()->waitForReadyRead(QVRTimeoutMsecs);
+    }
     char c;
     bool r = inputDevice()->getChar(&c);
     if (r) {
         switch (c) {
+        case 'c': *cmd = QVRClientCmdConfig; break;
         case 'i': *cmd = QVRClientCmdInit; break;
         case 'u': *cmd = QVRClientCmdUpdateDevices; break;
         case 'd': *cmd = QVRClientCmdDevice; break;
@@ -498,14 +550,18 @@ bool QVRClient::receiveCmd(QVRClientCmd* cmd, bool waitForIt)
         case 'o': *cmd = QVRClientCmdObserver; break;
         case 'r': *cmd = QVRClientCmdRender; break;
         case 'q': *cmd = QVRClientCmdQuit; break;
+        case 't': *cmd = QVRClientCmdClockSync; break;
+        case 'k': *cmd = QVRClientCmdClock; break;
         default:  *cmd = QVRClientCmdInvalid; break;
         }
     }
     return r;
 }
 
-void QVRClient::receiveCmdInitArgs(QVRApp* app)
+void QVRClient::receiveCmdInitArgs(QVRApp* app, bool* rejoin)
 {
+    QVRReadData(inputDevice(), _data);
+    *rejoin = (_data.size() == 1 && _data[0] != 0);
     QVRReadData(inputDevice(), _data);
     QDataStream ds(_data);
     app->deserializeStaticData(ds);
@@ -534,6 +590,7 @@ void QVRClient::receiveCmdObserverArgs(QVRObserver* obs)
 
 void QVRClient::receiveCmdRenderArgs(float* n, float* f, QVRApp* app)
 {
+    QVR_TRACE_SCOPE("client receive render");
     QVRReadData(inputDevice(), _data);
     Q_ASSERT(_data.size() == 2 * sizeof(float));
     std::memcpy(n, _data.data(), sizeof(float));
@@ -543,12 +600,35 @@ void QVRClient::receiveCmdRenderArgs(float* n, float* f, QVRApp* app)
     app->deserializeDynamicData(ds);
 }
 
+bool QVRClient::receiveCmdClockArgs(int processIndex, qint64* offset, double* drift, qint64* reference)
+{
+    QVRReadData(inputDevice(), _data);
+    QDataStream ds(_data);
+    qint32 processCount;
+    ds >> processCount;
+    bool valid = false;
+    for (int p = 0; p < processCount; p++) {
+        bool v;
+        qint64 o, r;
+        double d;
+        ds >> v >> o >> d >> r;
+        if (p == processIndex && v) {
+            *offset = o;
+            *drift = d;
+            *reference = r;
+            valid = true;
+        }
+    }
+    return valid;
+}
+
 /* The QVR Server */
 
 QVRServer::QVRServer() :
     _tcpServer(NULL),
     _localServer(NULL),
-    _sharedMem(NULL)
+    _sharedMem(NULL),
+    _sharedMemHaveCoupledClients(false)
 {
     _data.reserve(QVRSharedMemoryClientDeviceSize);
 }
@@ -581,7 +661,7 @@ QIODevice* QVRServer::inputDevice(int i)
     return dev;
 }
 
-bool QVRServer::startTcp(const QString& address)
+bool QVRServer::startTcp(const QByteArray& serializedConfig, const QString& address)
 {
     QTcpServer* server = new QTcpServer;
     QHostAddress hostAddress;
@@ -601,10 +681,11 @@ bool QVRServer::startTcp(const QString& address)
     QVR_INFO("started tcp server on %s port %d",
             qPrintable(server->serverAddress().toString()), server->serverPort());
     _tcpServer = server;
+    _serializedConfig = serializedConfig;
     return true;
 }
 
-bool QVRServer::startLocal()
+bool QVRServer::startLocal(const QByteArray& serializedConfig)
 {
     QString name = QString("qvr-") + QUuid::createUuid().toString().mid(1, 36);
     QLocalServer* server = new QLocalServer;
@@ -615,17 +696,18 @@ bool QVRServer::startLocal()
         return false;
     }
     _localServer = server;
+    _serializedConfig = serializedConfig;
     return true;
 }
 
-bool QVRServer::startSharedMemory()
+bool QVRServer::startSharedMemory(const QByteArray& serializedConfig)
 {
     int clientCount = QVRManager::processCount() - 1;
     int serverDeviceCount;
     int coupledClientCount;
     int serverIndexForThisProcess;
     int coupledClientIndexForThisProcess;
-    QVRGetSharedMemServerConfigs(
+    QVRGetSharedMemServerConfigs(QVRManager::config(), 0,
             &serverDeviceCount,
             &coupledClientCount,
             &serverIndexForThisProcess,
@@ -633,7 +715,9 @@ bool QVRServer::startSharedMemory()
 
     QString name = QUuid::createUuid().toString().mid(1, 36);
     QSharedMemory* sharedMemory = new QSharedMemory(name);
-    bool r = sharedMemory->create(serverDeviceCount * QVRSharedMemoryServerDeviceSize
+    int configAreaSize = QVRSharedMemoryConfigAreaSize(serializedConfig.size());
+    bool r = sharedMemory->create(configAreaSize
+            + serverDeviceCount * QVRSharedMemoryServerDeviceSize
             + clientCount * QVRSharedMemoryClientDeviceSize);
     if (!r) {
         QVR_FATAL("cannot initialize shared memory: %s", qPrintable(sharedMemory->errorString()));
@@ -642,29 +726,39 @@ bool QVRServer::startSharedMemory()
     }
     _sharedMem = sharedMemory;
 
+    // write the configuration; clients read it when they attach
+    int serializedConfigSize = serializedConfig.size();
+    std::memcpy(_sharedMem->data(), &serializedConfigSize, sizeof(int));
+    std::memcpy(static_cast<char*>(_sharedMem->data()) + sizeof(int), serializedConfig.constData(), serializedConfigSize);
+    char* devicesArea = static_cast<char*>(_sharedMem->data()) + configAreaSize;
+
     // create server devices: one for all coupled clients (if any), and one for each decoupled client
     _sharedMemHaveCoupledClients = (coupledClientCount > 0);
     if (coupledClientCount > 0) {
         _sharedMemServerDevices.append(new QVRSharedMemoryDevice(coupledClientCount,
-                    static_cast<char*>(_sharedMem->data()), QVRSharedMemoryServerDeviceSize));
+                    devicesArea, QVRSharedMemoryServerDeviceSize));
         _sharedMemServerDevices.last()->openWriter();
     }
     _sharedMemServerForClientMap.resize(clientCount);
+    _sharedMemReaderForClientMap.resize(clientCount);
     int decoupledProcessServerIndex = (_sharedMemHaveCoupledClients ? 1 : 0);
+    int coupledClientIndex = 0;
     for (int p = 1; p < QVRManager::processCount(); p++) {
         if (QVRManager::processConfig(p).decoupledRendering()) {
-            _sharedMemServerDevices.append(new QVRSharedMemoryDevice(1, static_cast<char*>(_sharedMem->data())
+            _sharedMemServerDevices.append(new QVRSharedMemoryDevice(1, devicesArea
                         + _sharedMemServerDevices.length() * QVRSharedMemoryServerDeviceSize,
                         QVRSharedMemoryServerDeviceSize));
             _sharedMemServerDevices.last()->openWriter();
             _sharedMemServerForClientMap[p - 1] = decoupledProcessServerIndex++;
+            _sharedMemReaderForClientMap[p - 1] = 0;
         } else {
             _sharedMemServerForClientMap[p - 1] = 0;
+            _sharedMemReaderForClientMap[p - 1] = coupledClientIndex++;
         }
     }
     // create client devices
     for (int p = 1; p < QVRManager::processCount(); p++) {
-        _sharedMemClientDevices.append(new QVRSharedMemoryDevice(1, static_cast<char*>(_sharedMem->data())
+        _sharedMemClientDevices.append(new QVRSharedMemoryDevice(1, devicesArea
                     + serverDeviceCount * QVRSharedMemoryServerDeviceSize
                     + (p - 1) * QVRSharedMemoryClientDeviceSize,
                     QVRSharedMemoryClientDeviceSize));
@@ -696,75 +790,286 @@ QString QVRServer::name()
     return s;
 }
 
-bool QVRServer::waitForClients()
+void QVRServer::sendConfig(QIODevice* dev)
+{
+    const char cmd = 'c';
+    QVRWriteData(dev, &cmd, sizeof(char));
+    QVRWriteData(dev, _serializedConfig);
+    if (_tcpServer)
+        static_cast<QTcpSocket*>(dev)->flush();
+    else
+        static_cast<QLocalSocket*>(dev)->flush();
+}
+
+bool QVRServer::waitForClients(QVector<qint64>* connectNsecs)
 {
+    // All clients connect and complete their handshake concurrently, in
+    // whatever order they come in. We poll all of them until they are done.
     int clientCount = QVRManager::processCount() - 1;
-    if (_tcpServer) {
-        _tcpSockets.resize(clientCount);
-        for (int i = 0; i < clientCount; i++) {
-            QTcpSocket* socket = _tcpServer->nextPendingConnection();
-            if (!socket) {
-                if (!_tcpServer->waitForNewConnection(QVRTimeoutMsecs)) {
-                    QVR_FATAL("client did not connect");
-                    return false;
-                }
-                socket = _tcpServer->nextPendingConnection();
-                Q_ASSERT(socket);
-            }
-            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
-            int clientProcessIndex;
-            QVRReadData(socket, reinterpret_cast<char*>(&clientProcessIndex), sizeof(int));
-            if (clientProcessIndex < 1 || clientProcessIndex >= QVRManager::processCount()) {
-                QVR_FATAL("client sent invalid process index");
-                delete socket;
+    if (connectNsecs)
+        connectNsecs->fill(-1, clientCount);
+    QElapsedTimer timer;
+    timer.start();
+    int connectedClients = 0;
+    if (_tcpServer || _localServer) {
+        if (_tcpServer)
+            _tcpSockets.fill(NULL, clientCount);
+        else
+            _localSockets.fill(NULL, clientCount);
+        QList<QIODevice*> pendingSockets; // accepted, but handshake not complete
+        while (connectedClients < clientCount) {
+            if (QVRTimeoutMsecs > 0 && timer.elapsed() > QVRTimeoutMsecs) {
+                QVR_FATAL("%d of %d clients did not connect", clientCount - connectedClients, clientCount);
                 return false;
             }
-            QVR_DEBUG("client with process index %d connected", clientProcessIndex);
-            _tcpSockets[clientProcessIndex - 1] = socket;
-        }
-    } else if (_localServer) {
-        _localSockets.resize(clientCount);
-        for (int i = 0; i < clientCount; i++) {
-            QLocalSocket* socket = _localServer->nextPendingConnection();
-            if (!socket) {
-                if (!_localServer->waitForNewConnection(QVRTimeoutMsecs)) {
-                    QVR_FATAL("client did not connect");
-                    return false;
+            // accept new connections
+            int waitMsecs = (pendingSockets.isEmpty() ? 10 : 0);
+            if (_tcpServer) {
+                _tcpServer->waitForNewConnection(waitMsecs);
+                while (QTcpSocket* socket = _tcpServer->nextPendingConnection()) {
+                    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+                    pendingSockets.append(socket);
                 }
-                socket = _localServer->nextPendingConnection();
-                Q_ASSERT(socket);
+            } else {
+                _localServer->waitForNewConnection(waitMsecs);
+                while (QLocalSocket* socket = _localServer->nextPendingConnection())
+                    pendingSockets.append(socket);
             }
-            int clientProcessIndex;
-            QVRReadData(socket, reinterpret_cast<char*>(&clientProcessIndex), sizeof(int));
-            if (clientProcessIndex < 1 || clientProcessIndex >= QVRManager::processCount()) {
-                QVR_FATAL("client sent invalid process index");
-                delete socket;
-                return false;
+            // complete the handshakes for which the process index has arrived
+            for (int i = 0; i < pendingSockets.size(); i++) {
+                QIODevice* socket = pendingSockets[i];
+                if (socket->bytesAvailable() < static_cast<qint64>(sizeof(int)))
+                    socket->waitForReadyRead(1);
+                if (socket->bytesAvailable() < static_cast<qint64>(sizeof(int)))
+                    continue;
+                pendingSockets.removeAt(i--);
+                int clientProcessIndex;
+                QVRReadData(socket, reinterpret_cast<char*>(&clientProcessIndex), sizeof(int));
+                if (clientProcessIndex < 1 || clientProcessIndex >= QVRManager::processCount()
+                        || (_tcpServer ? _tcpSockets[clientProcessIndex - 1] != NULL
+                            : _localSockets[clientProcessIndex - 1] != NULL)) {
+                    QVR_FATAL("client sent invalid process index");
+                    delete socket;
+                    return false;
+                }
+                QVR_DEBUG("client with process index %d connected", clientProcessIndex);
+                if (_tcpServer)
+                    _tcpSockets[clientProcessIndex - 1] = static_cast<QTcpSocket*>(socket);
+                else
+                    _localSockets[clientProcessIndex - 1] = static_cast<QLocalSocket*>(socket);
+                sendConfig(socket);
+                if (connectNsecs)
+                    (*connectNsecs)[clientProcessIndex - 1] = QVRTimer.nsecsElapsed();
+                connectedClients++;
             }
-            QVR_DEBUG("client with process index %d connected", clientProcessIndex);
-            _localSockets[clientProcessIndex - 1] = socket;
         }
     } else {
-        for (int d = 0; d < _sharedMemServerDevices.length(); d++) {
-            for (int i = 0; i < _sharedMemServerDevices[d]->readers(); i++) {
-                if (!_sharedMemServerDevices[d]->waitForReaderConnection(i)) {
-                    QVR_FATAL("client did not connect");
+        QVector<bool> clientIsConnected(clientCount, false);
+        while (connectedClients < clientCount) {
+            for (int i = 0; i < clientCount; i++) {
+                if (!clientIsConnected[i] && _sharedMemServerDevices[_sharedMemServerForClientMap[i]]
+                        ->isReaderConnected(_sharedMemReaderForClientMap[i])) {
+                    QVR_DEBUG("client with process index %d connected", i + 1);
+                    clientIsConnected[i] = true;
+                    if (connectNsecs)
+                        (*connectNsecs)[i] = QVRTimer.nsecsElapsed();
+                    connectedClients++;
+                }
+            }
+            if (connectedClients < clientCount) {
+                if (QVRTimeoutMsecs > 0 && timer.elapsed() > QVRTimeoutMsecs) {
+                    QVR_FATAL("%d of %d clients did not connect", clientCount - connectedClients, clientCount);
                     return false;
                 }
+                QThread::msleep(1);
             }
         }
     }
     _clientIsSynced.resize(clientCount);
-    for (int i = 0; i < clientCount; i++)
+    _clientState.resize(clientCount);
+    _clientProcesses.resize(clientCount);
+    for (int i = 0; i < clientCount; i++) {
         _clientIsSynced[i] = true;
+        _clientState[i] = ClientActive;
+        _clientProcesses[i] = NULL;
+    }
     return true;
 }
 
+void QVRServer::setClientProcess(int processIndex, QProcess* process)
+{
+    _clientProcesses[processIndex - 1] = process;
+}
+
+void QVRServer::markClientDead(int i)
+{
+    if (_clientState[i] == ClientDead)
+        return;
+    QVR_DEBUG("client with process index %d is dead", i + 1);
+    _clientState[i] = ClientDead;
+    _deadClients.append(i + 1);
+    if (_tcpServer)
+        _tcpSockets[i]->abort();
+    else if (_localServer)
+        _localSockets[i]->abort();
+    else
+        _sharedMemServerDevices[_sharedMemServerForClientMap[i]]->disconnectReader(_sharedMemReaderForClientMap[i]);
+}
+
+bool QVRServer::isClientAlive(int i, bool waitingForClient)
+{
+    if (_clientState[i] == ClientDead)
+        return false;
+    bool alive = true;
+    if (_tcpServer)
+        alive = (_tcpSockets[i]->state() == QAbstractSocket::ConnectedState);
+    else if (_localServer)
+        alive = (_localSockets[i]->state() == QLocalSocket::ConnectedState);
+    // A process that was launched by us is dead if it finished. For shared memory
+    // IPC, this is the only way to notice that a client died.
+    // The process state is updated by the event loop between frames. Only while
+    // we are blocked waiting for the client, the exit state is polled directly.
+    QProcess* process = _clientProcesses[i];
+    if (alive && process && (process->state() == QProcess::NotRunning
+                || (waitingForClient && process->waitForFinished(0))))
+        alive = false;
+    if (!alive)
+        markClientDead(i);
+    return alive;
+}
+
+/* Like QVRReadData(), but for a client that might die while we wait for it.
+ * If that happens, the client is marked as dead and false is returned. */
+
+bool QVRServer::readFromClient(int i, char* data, int size)
+{
+    QIODevice* device = inputDevice(i);
+    int pos = 0;
+    while (pos < size) {
+        int r = device->read(data + pos, size - pos);
+        if (r < 0) {
+            markClientDead(i);
+            return false;
+        } else if (r == 0) {
+            if (!device->waitForReadyRead(100) && !isClientAlive(i, true))
+                return false;
+        } else {
+            pos += r;
+        }
+    }
+    return true;
+}
+
+bool QVRServer::readFromClient(int i, QByteArray& array)
+{
+    int s;
+    if (!readFromClient(i, reinterpret_cast<char*>(&s), sizeof(int)))
+        return false;
+    array.resize(s);
+    return readFromClient(i, array.data(), s);
+}
+
+void QVRServer::checkClients()
+{
+    for (int i = 0; i < _clientState.size(); i++)
+        isClientAlive(i);
+}
+
+QList<int> QVRServer::takeDeadClients()
+{
+    QList<int> deadClients = _deadClients;
+    _deadClients.clear();
+    return deadClients;
+}
+
+bool QVRServer::supportsRejoin() const
+{
+    return (_tcpServer || _localServer);
+}
+
+int QVRServer::acceptRejoiningClient()
+{
+    Q_ASSERT(supportsRejoin());
+    if (_tcpServer) {
+        while (QTcpSocket* socket = _tcpServer->nextPendingConnection()) {
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            _pendingSockets.append(socket);
+        }
+    } else {
+        while (QLocalSocket* socket = _localServer->nextPendingConnection())
+            _pendingSockets.append(socket);
+    }
+    for (int j = 0; j < _pendingSockets.size(); j++) {
+        QIODevice* socket = _pendingSockets[j];
+        if (socket->bytesAvailable() < static_cast<qint64>(sizeof(int)))
+            socket->waitForReadyRead(0);
+        if (socket->bytesAvailable() < static_cast<qint64>(sizeof(int)))
+            continue;
+        _pendingSockets.removeAt(j--);
+        int clientProcessIndex;
+        QVRReadData(socket, reinterpret_cast<char*>(&clientProcessIndex), sizeof(int));
+        if (clientProcessIndex < 1 || clientProcessIndex >= QVRManager::processCount()
+                || _clientState[clientProcessIndex - 1] != ClientDead) {
+            QVR_WARNING("ignoring connection from client with unexpected process index %d", clientProcessIndex);
+            delete socket;
+            continue;
+        }
+        int i = clientProcessIndex - 1;
+        if (_tcpServer) {
+            delete _tcpSockets[i];
+            _tcpSockets[i] = static_cast<QTcpSocket*>(socket);
+        } else {
+            delete _localSockets[i];
+            _localSockets[i] = static_cast<QLocalSocket*>(socket);
+        }
+        sendConfig(socket);
+        _clientState[i] = ClientRejoining;
+        _clientIsSynced[i] = true;
+        QVR_DEBUG("client with process index %d reconnected", clientProcessIndex);
+        return clientProcessIndex;
+    }
+    return -1;
+}
+
+void QVRServer::sendCmdInitRejoin(int processIndex, const QByteArray& serializedStatData)
+{
+    int i = processIndex - 1;
+    Q_ASSERT(_clientState[i] == ClientRejoining);
+    QIODevice* dev = (_tcpServer ? static_cast<QIODevice*>(_tcpSockets[i]) : _localSockets[i]);
+    const char cmd = 'i';
+    const char rejoin = 1;
+    QVRWriteData(dev, &cmd, sizeof(char));
+    QVRWriteData(dev, QByteArray::fromRawData(&rejoin, sizeof(char)));
+    QVRWriteData(dev, serializedStatData);
+}
+
+QList<int> QVRServer::takeRejoinedClients()
+{
+    QList<int> rejoinedClients;
+    for (int i = 0; i < _clientState.size(); i++) {
+        if (_clientState[i] == ClientRejoining && isClientAlive(i)) {
+            // the client signals the end of its initialization with an empty sync command
+            QIODevice* dev = inputDevice(i);
+            if (dev->bytesAvailable() == 0)
+                dev->waitForReadyRead(0);
+            if (dev->bytesAvailable() > 0) {
+                if (receiveCmdSyncFromClient(i, NULL, NULL) >= 0) {
+                    _clientState[i] = ClientActive;
+                    _clientIsSynced[i] = true;
+                    rejoinedClients.append(i + 1);
+                }
+            }
+        }
+    }
+    return rejoinedClients;
+}
+
 void QVRServer::sendCmd(const char cmd, const QByteArray& data0, const QByteArray& data1)
 {
+    QVR_TRACE_SCOPE("server send");
     bool wroteToCoupledServerDevice = false;
     for (int i = 0; i < inputDevices(); i++) {
-        if (_clientIsSynced[i]) {
+        if (_clientState[i] == ClientActive && _clientIsSynced[i]) {
             bool doWrite = true;
             QIODevice* dev;
             if (_tcpServer) {
@@ -794,7 +1099,8 @@ void QVRServer::sendCmd(const char cmd, const QByteArray& data0, const QByteArra
 
 void QVRServer::sendCmdInit(const QByteArray& serializedStatData)
 {
-    sendCmd('i', serializedStatData);
+    const char rejoin = 0;
+    sendCmd('i', QByteArray::fromRawData(&rejoin, sizeof(char)), serializedStatData);
 }
 
 void QVRServer::sendCmdUpdateDevices()
@@ -819,40 +1125,62 @@ void QVRServer::sendCmdObserver(const QByteArray& serializedObserver)
 
 void QVRServer::sendCmdRender(float n, float f, const QByteArray& serializedDynData)
 {
-    float data[2] = { n, f };
-    sendCmd('r', QByteArray::fromRawData(reinterpret_cast<char*>(data), sizeof(data)), serializedDynData);
+    char data[2 * sizeof(float)];
+    std::memcpy(data, &n, sizeof(float));
+    std::memcpy(data + sizeof(float), &f, sizeof(float));
+    sendCmd('r', QByteArray::fromRawData(data, sizeof(data)), serializedDynData);
     for (int i = 0; i < _clientIsSynced.length(); i++) {
-        if (QVRManager::processConfig(i + 1).decoupledRendering()) {
+        if (_clientState[i] == ClientActive && QVRManager::processConfig(i + 1).decoupledRendering()) {
             _clientIsSynced[i] = false;
         }
     }
 }
 
+qint64 QVRServer::sendCmdClockSync()
+{
+    qint64 t1 = QVRTimer.nsecsElapsed();
+    sendCmd('t');
+    return t1;
+}
+
+void QVRServer::sendCmdClock(const QByteArray& serializedClocks)
+{
+    sendCmd('k', serializedClocks);
+}
+
 void QVRServer::sendCmdQuit()
 {
-    for (int i = 0; i < _clientIsSynced.length(); i++)
+    for (int i = 0; i < _clientIsSynced.length(); i++) {
         _clientIsSynced[i] = true;
+        if (_clientState[i] == ClientRejoining)
+            _clientState[i] = ClientActive;
+    }
     sendCmd('q');
 }
 
 void QVRServer::flush()
 {
+    QVR_TRACE_SCOPE("server flush");
     if (_localServer) {
         for (int i = 0; i < _localSockets.size(); i++)
-            _localSockets[i]->flush();
+            if (_clientState[i] != ClientDead)
+                _localSockets[i]->flush();
     } else {
         for (int i = 0; i < _tcpSockets.size(); i++)
-            _tcpSockets[i]->flush();
+            if (_clientState[i] != ClientDead)
+                _tcpSockets[i]->flush();
     }
 }
 
 void QVRServer::receiveReplyUpdateDevices(QList<QVRDevice*> deviceList)
 {
+    QVR_TRACE_SCOPE("server receive devices");
     for (int i = 0; i < inputDevices(); i++) {
-        if (_clientIsSynced[i]) {
+        if (_clientState[i] == ClientActive && _clientIsSynced[i]) {
             int n;
-            QVRReadData(inputDevice(i), reinterpret_cast<char*>(&n), sizeof(int));
-            QVRReadData(inputDevice(i), _data);
+            if (!readFromClient(i, reinterpret_cast<char*>(&n), sizeof(int))
+                    || !readFromClient(i, _data))
+                continue;
             QDataStream ds(_data);
             QVRDevice dev;
             for (int j = 0; j < n; j++) {
@@ -863,34 +1191,87 @@ void QVRServer::receiveReplyUpdateDevices(QList<QVRDevice*> deviceList)
     }
 }
 
-static void QVRServerReceiveCmdSyncHelper(QIODevice* device, QByteArray& data, QList<QVREvent>* eventList)
+void QVRServer::receiveReplyClockSync(QVector<qint64>* t2, QVector<qint64>* t3, QVector<qint64>* t4)
 {
+    QVR_TRACE_SCOPE("server receive clock sync");
+    const int replySize = 2 * sizeof(qint64);
+    qint64 data[2];
+    t2->fill(-1, inputDevices());
+    t3->fill(-1, inputDevices());
+    t4->fill(-1, inputDevices());
+    QList<int> pendingClients;
+    for (int i = 0; i < inputDevices(); i++)
+        if (_clientState[i] == ClientActive && _clientIsSynced[i])
+            pendingClients.append(i);
+    // The arrival time of each reply matters, so we poll all clients instead
+    // of waiting for them one after the other. Replies that take too long are
+    // read with blocking waits (which also detects clients that died); their
+    // long round trip delays make the clock estimators ignore them.
+    QElapsedTimer timer;
+    timer.start();
+    while (pendingClients.size() > 0) {
+        bool overdue = (timer.elapsed() >= QVRClockSyncPollMsecs);
+        for (int j = 0; j < pendingClients.size(); j++) {
+            int i = pendingClients[j];
+            QIODevice* dev = inputDevice(i);
+            if (dev->bytesAvailable() < replySize)
+                dev->waitForReadyRead(0);
+            if (overdue || dev->bytesAvailable() >= replySize) {
+                if (readFromClient(i, reinterpret_cast<char*>(data), replySize)) {
+                    (*t4)[i] = QVRTimer.nsecsElapsed();
+                    (*t2)[i] = data[0];
+                    (*t3)[i] = data[1];
+                }
+                pendingClients.removeAt(j);
+                j--;
+            }
+        }
+    }
+}
+
+int QVRServer::receiveCmdSyncFromClient(int i, QVREventRing* eventQueue, qint64* swapNsecs)
+{
+    QVR_TRACE_SCOPE("server receive sync");
     int n;
-    QVRReadData(device, reinterpret_cast<char*>(&n), sizeof(int));
-    QVRReadData(device, data);
-    QDataStream ds(data);
-    QVREvent e;
-    for (int j = 0; j < n; j++) {
-        ds >> e;
-        eventList->append(e);
+    qint64 s;
+    if (!readFromClient(i, reinterpret_cast<char*>(&n), sizeof(int))
+            || !readFromClient(i, reinterpret_cast<char*>(&s), sizeof(qint64))
+            || !readFromClient(i, _data))
+        return -1;
+    if (swapNsecs)
+        *swapNsecs = s;
+    if (eventQueue) {
+        QDataStream ds(_data);
+        QVREventReader reader;
+        QVREvent e;
+        for (int j = 0; j < n; j++) {
+            reader.read(ds, e);
+            eventQueue->enqueue(e);
+        }
     }
+    return n;
 }
 
-void QVRServer::receiveCmdSync(QList<QVREvent>* eventList)
+int QVRServer::receiveCmdSync(QVREventRing* eventQueue, QVector<qint64>* swapNsecs)
 {
+    int n = 0;
+    if (swapNsecs)
+        swapNsecs->fill(-1, inputDevices());
     // We make two passes over the input devices: first we wait
     // for all coupled devices, then we check if decoupled devices
     // are ready. This avoids an order-dependency of child process
     // definitions in the configuration.
+    // Clients that die in the process are skipped.
     for (int i = 0; i < inputDevices(); i++) {
-        if (_clientIsSynced[i]) { // true at this point only for coupled processes
-            QVRServerReceiveCmdSyncHelper(inputDevice(i), _data, eventList);
+        if (_clientState[i] == ClientActive && _clientIsSynced[i]) { // true at this point only for coupled processes
+            n += qMax(receiveCmdSyncFromClient(i, eventQueue, swapNsecs ? swapNsecs->data() + i : NULL), 0);
         }
     }
     for (int i = 0; i < inputDevices(); i++) {
-        if (!_clientIsSynced[i] && inputDevice(i)->bytesAvailable() > 0) {
-            QVRServerReceiveCmdSyncHelper(inputDevice(i), _data, eventList);
+        if (_clientState[i] == ClientActive && !_clientIsSynced[i] && inputDevice(i)->bytesAvailable() > 0) {
+            n += qMax(receiveCmdSyncFromClient(i, eventQueue, NULL), 0);
             _clientIsSynced[i] = true;
         }
     }
+    return n;
 }
@@ -35,11 +35,14 @@ class QLocalSocket;
 class QLocalServer;
 class QSharedMemory;
 class QBuffer;
+class QProcess;
 
 class QVREvent;
+class QVREventRing;
 class QVRApp;
 class QVRDevice;
 class QVRObserver;
+class QVRConfig;
 
 class QVRSharedMemoryDevice;
 
@@ -61,6 +64,7 @@ extern int QVRTimeoutMsecs;
  * Unfortunately QLocalSocket is not based on QAbstractSocket... */
 
 typedef enum {
+    QVRClientCmdConfig,
     QVRClientCmdInit,
     QVRClientCmdUpdateDevices,
     QVRClientCmdDevice,
@@ -68,6 +72,8 @@ typedef enum {
     QVRClientCmdObserver,
     QVRClientCmdRender,
     QVRClientCmdQuit,
+    QVRClientCmdClockSync,
+    QVRClientCmdClock,
     QVRClientCmdInvalid
 } QVRClientCmd;
 
@@ -84,18 +90,26 @@ private:
     QIODevice* inputDevice();
     QIODevice* outputDevice();
 
+    bool receiveConfig(QVRConfig* config);
+
 public:
     QVRClient();
     ~QVRClient();
 
     /* Start a client by connecting to the server. The server name is of
      * the form local,name for a local server, tcp,host,port for a TCP server,
-     * and shmem,key for a shared memory server. */
-    bool start(const QString& serverName);
+     * and shmem,key for a shared memory server.
+     * On success, the configuration of the main process is stored in config. */
+    bool start(const QString& serverName, QVRConfig* config);
 
     /* Commands that this client sends to the server */
     void sendReplyUpdateDevices(int n, const QByteArray& serializedDevices);
-    void sendCmdSync(int n, const QByteArray& serializedEvents);
+    /* The sync command carries the cluster time at which the buffer swaps
+     * of this process returned (or -1) */
+    void sendCmdSync(int n, qint64 swapNsecs, const QByteArray& serializedEvents);
+    /* Reply to a clock sync command, with the QVRTimer time at which the
+     * command was received. Flush immediately afterwards. */
+    void sendReplyClockSync(qint64 receiveNsecs);
     /* Explicit flushing of the underlying socket */
     void flush();
 
@@ -104,11 +118,13 @@ public:
      * Then use one of the remaining functions to read the arguments for that
      * command. */
     bool receiveCmd(QVRClientCmd* cmd, bool waitForIt = false);
-    void receiveCmdInitArgs(QVRApp* app);
+    void receiveCmdInitArgs(QVRApp* app, bool* rejoin);
     void receiveCmdDeviceArgs(QVRDevice* dev);
     void receiveCmdWasdqeStateArgs(int*, int*, bool*);
     void receiveCmdObserverArgs(QVRObserver* obs);
     void receiveCmdRenderArgs(float* n, float* f, QVRApp* app);
+    /* Returns false if there is no clock estimate for the given process yet */
+    bool receiveCmdClockArgs(int processIndex, qint64* offset, double* drift, qint64* reference);
 };
 
 /* The server, for the main process. Based on QLocalServer/QTcpServer. */
@@ -126,14 +142,29 @@ private:
     bool _sharedMemHaveCoupledClients;
     QVector<int> _sharedMemServerForClientMap;
     QVector<QVRSharedMemoryDevice*> _sharedMemClientDevices;
+    QVector<int> _sharedMemReaderForClientMap;
     QVector<bool> _clientIsSynced;
+    QByteArray _serializedConfig;
+    // Liveness of clients. A client that died does not take part in the
+    // communication anymore until its relaunched process has rejoined.
+    enum ClientState { ClientActive, ClientDead, ClientRejoining };
+    QVector<ClientState> _clientState;
+    QVector<QProcess*> _clientProcesses;
+    QList<int> _deadClients;
+    QList<QIODevice*> _pendingSockets;
 
     int inputDevices() const;
     QIODevice* inputDevice(int i);
+    void markClientDead(int i);
+    bool isClientAlive(int i, bool waitingForClient = false);
+    bool readFromClient(int i, char* data, int size);
+    bool readFromClient(int i, QByteArray& array);
+    int receiveCmdSyncFromClient(int i, QVREventRing* eventQueue, qint64* swapNsecs);
 
     void sendCmd(const char cmd,
             const QByteArray& data0 = QByteArray(static_cast<const char*>(0), 0),
             const QByteArray& data1 = QByteArray(static_cast<const char*>(0), 0));
+    void sendConfig(QIODevice* dev);
 
 public:
     QVRServer();
@@ -141,15 +172,39 @@ public:
 
     /* Start a server. You must choose to start either a tcp server or a local server
      * or a shared memory server.
+     * The serialized configuration is handed to each client when it connects,
+     * so that child processes do not need to read configuration files.
      * In case of a tcp server, you can optionally specify an IP address to listen on. */
-    bool startTcp(const QString& address = QString());
-    bool startLocal();
-    bool startSharedMemory();
+    bool startTcp(const QByteArray& serializedConfig, const QString& address = QString());
+    bool startLocal(const QByteArray& serializedConfig);
+    bool startSharedMemory(const QByteArray& serializedConfig);
     /* Return the name of the server. This is either local,name for local servers
      * or tcp,host,port for tcp servers. Pass this name to QVRClient::start(). */
     QString name();
-    /* Wait until the given number of clients have connected to this server. */
-    bool waitForClients();
+    /* Wait until all clients have connected to this server. Clients may connect
+     * in any order. If connectNsecs is given, it receives the QVRTimer time at
+     * which each client (with process index i + 1) completed its handshake. */
+    bool waitForClients(QVector<qint64>* connectNsecs = NULL);
+    /* Set the process that runs the client with the given process index, if it
+     * was launched by us. This helps to detect clients that die. */
+    void setClientProcess(int processIndex, QProcess* process);
+
+    /* Crash handling. Clients that die are detected while waiting for them and
+     * via checkClients(); they are then excluded from further communication.
+     * takeDeadClients() returns the process indices of clients that died since
+     * its last call.
+     * If supportsRejoin() is true, the relaunched process of a dead client can
+     * connect again: acceptRejoiningClient() accepts it without blocking, sends
+     * it the configuration, and returns its process index (or -1). Then send
+     * the rejoin init command; takeRejoinedClients() returns the process indices
+     * of clients that completed their initialization and take part in the
+     * following frames again. */
+    void checkClients();
+    QList<int> takeDeadClients();
+    bool supportsRejoin() const;
+    int acceptRejoiningClient();
+    void sendCmdInitRejoin(int processIndex, const QByteArray& serializedStatData);
+    QList<int> takeRejoinedClients();
 
     /* Commands that this server sends to all clients. */
     void sendCmdInit(const QByteArray& serializedStatData);
@@ -159,15 +214,26 @@ public:
     void sendCmdObserver(const QByteArray& serializedObserver);
     void sendCmdRender(float n, float f, const QByteArray& serializedDynData);
     void sendCmdQuit();
+    /* Clock synchronization (see clocksync.hpp). sendCmdClockSync() returns
+     * the QVRTimer time T1 at which the command was sent; flush immediately
+     * afterwards and then use receiveReplyClockSync() to get T2, T3, and T4 for
+     * each client (index = process index - 1; -1 for clients that did not take
+     * part). sendCmdClock() sends the resulting clock estimates. */
+    qint64 sendCmdClockSync();
+    void sendCmdClock(const QByteArray& serializedClocks);
     /* Explicit flushing of the underlying sockets */
     void flush();
 
     /* Replies that this server receives from clients. See sendCmdUpdateDevices(). */
     void receiveReplyUpdateDevices(QList<QVRDevice*> devices);
+    /* Replies that this server receives from clients. See sendCmdClockSync(). */
+    void receiveReplyClockSync(QVector<qint64>* t2, QVector<qint64>* t3, QVector<qint64>* t4);
     /* Commands that this server receives from all clients.
      * This is always a list of zero or more event commands followed by a sync command.
-     * The events (if any) will be appended to the given list. */
-    void receiveCmdSync(QList<QVREvent>* eventList);
+     * The events (if any) will be appended to the given queue, and their number is returned.
+     * If swapNsecs is given, it receives the buffer swap time of each coupled client (see
+     * QVRClient::sendCmdSync()), or -1. */
+    int receiveCmdSync(QVREventRing* eventQueue, QVector<qint64>* swapNsecs = NULL);
 };
 
 #endif
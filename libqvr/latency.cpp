@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "latency.hpp"
+#include "logging.hpp"
+
+
+QVRLatencyHistogram::QVRLatencyHistogram() :
+    _overflowCount(0), _maxNsecs(0)
+{
+    for (int i = 0; i < _binCount; i++)
+        _bins[i].storeRelaxed(0);
+}
+
+void QVRLatencyHistogram::addSample(qint64 nsecs)
+{
+    if (nsecs < 0)
+        nsecs = 0;
+    qint64 bin = nsecs / _binNsecs;
+    if (bin < _binCount)
+        _bins[bin].fetchAndAddRelaxed(1);
+    else
+        _overflowCount.fetchAndAddRelaxed(1);
+    qint64 oldMax = _maxNsecs.loadRelaxed();
+    while (nsecs > oldMax && !_maxNsecs.testAndSetRelaxed(oldMax, nsecs, oldMax))
+        ;
+}
+
+void QVRLatencyHistogram::report() const
+{
+    qint64 counts[_binCount];
+    qint64 total = _overflowCount.loadRelaxed();
+    double sumMsecs = 0.0;
+    for (int i = 0; i < _binCount; i++) {
+        counts[i] = _bins[i].loadRelaxed();
+        total += counts[i];
+        sumMsecs += counts[i] * (i + 0.5) * _binNsecs / 1e6;
+    }
+    if (total == 0) {
+        QVR_FATAL("latency probe: no samples (are observers tracked by devices?)");
+        return;
+    }
+    // percentiles are reported as the upper bound of the bin that contains them
+    const double fractions[] = { 0.5, 0.9, 0.99 };
+    double percentileMsecs[3] = { -1.0, -1.0, -1.0 };
+    qint64 accumulated = 0;
+    for (int i = 0; i < _binCount; i++) {
+        accumulated += counts[i];
+        for (int j = 0; j < 3; j++)
+            if (percentileMsecs[j] < 0.0 && accumulated >= fractions[j] * total)
+                percentileMsecs[j] = (i + 1) * _binNsecs / 1e6;
+    }
+    // the mean only covers the samples below 100 ms
+    qint64 inRange = total - _overflowCount.loadRelaxed();
+    QVR_FATAL("latency probe: %lld samples, mean %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms",
+            static_cast<long long>(total), inRange > 0 ? sumMsecs / inRange : 0.0,
+            percentileMsecs[0], percentileMsecs[1], percentileMsecs[2], _maxNsecs.loadRelaxed() / 1e6);
+    // print the histogram with 1 ms resolution, skipping empty rows
+    for (int ms = 0; ms < _binCount / 4; ms++) {
+        qint64 c = counts[4 * ms] + counts[4 * ms + 1] + counts[4 * ms + 2] + counts[4 * ms + 3];
+        if (c > 0)
+            QVR_FATAL("latency probe: %3d-%3d ms: %lld (%.1f%%)", ms, ms + 1,
+                    static_cast<long long>(c), 100.0 * c / total);
+    }
+    if (_overflowCount.loadRelaxed() > 0)
+        QVR_FATAL("latency probe: >= 100 ms: %d (%.1f%%)", _overflowCount.loadRelaxed(),
+                100.0 * _overflowCount.loadRelaxed() / total);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_LATENCY_HPP
+#define QVR_LATENCY_HPP
+
+#include <QAtomicInt>
+
+/* A histogram of motion-to-swap latencies, used by the latency probe mode
+ * (--qvr-latency-probe).
+ *
+ * Device samples are stamped with QVRTimer when they arrive in the main
+ * process. The stamp travels with the observer tracking data to the child
+ * processes and into the render context of each window, and the window
+ * threads record the age of the stamp when the buffer swap has completed.
+ *
+ * Samples can be added concurrently from all window threads. This is only
+ * used internally. */
+class QVRLatencyHistogram
+{
+private:
+    static const int _binCount = 400;   // bins of 0.25 ms, covering 0-100 ms
+    static const int _binNsecs = 250000;
+    QAtomicInt _bins[_binCount];
+    QAtomicInt _overflowCount;          // samples of 100 ms or more
+    QAtomicInteger<qint64> _maxNsecs;
+
+public:
+    QVRLatencyHistogram();
+
+    void addSample(qint64 nsecs);
+    /* Print a summary of all samples via the QVR logging facility */
+    void report() const;
+};
+
+#endif
@@ -31,10 +31,14 @@ DEFINES += QT_DEPRECATED_WARNINGS \
 	GL_SRGB8_ALPHA8=0x8C43   \
 	GL_RGBA8=0x8058
 
+# see CMakeLists.txt
+*-g++*|*-clang*:QMAKE_CXXFLAGS += -fno-math-errno
+
 SOURCES += \
 	manager.cpp \
 	config.cpp \
 	device.cpp \
+	devicesampler.cpp \
 	observer.cpp \
 	window.cpp \
 	process.cpp \
@@ -42,13 +46,22 @@ SOURCES += \
 	internalglobals.cpp \
 	logging.cpp \
 	event.cpp \
+	latency.cpp \
 	rendercontext.cpp \
-	frustum.cpp
+	frustum.cpp \
+	culler.cpp \
+	curvedscreen.cpp \
+	offaxis.cpp \
+	framescheduler.cpp \
+	trace.cpp \
+	clocksync.cpp
 
 HEADERS += \
 	manager.hpp \
 	config.hpp \
 	device.hpp \
+	devicewire.hpp \
+	devicesampler.hpp \
 	observer.hpp \
 	window.hpp \
 	process.hpp \
@@ -56,8 +69,17 @@ HEADERS += \
 	internalglobals.hpp \
 	logging.hpp \
 	event.hpp \
+	ringbuffer.hpp \
+	ringwriter.hpp \
+	latency.hpp \
 	rendercontext.hpp \
-	frustum.hpp
+	frustum.hpp \
+	culler.hpp \
+	curvedscreen.hpp \
+	offaxis.hpp \
+	framescheduler.hpp \
+	trace.hpp \
+	clocksync.hpp
 
 RESOURCES += qvr.qrc
 
@@ -71,5 +93,5 @@ lib.path = $$LIBQVR_DIR/lib
 lib.files = $$OUT_PWD/libqvr.so
 INSTALLS += lib
 headers.path = $$LIBQVR_DIR/include/qvr
-headers.files = app.hpp manager.hpp config.hpp device.hpp observer.hpp window.hpp process.hpp rendercontext.hpp outputplugin.hpp frustum.hpp
+headers.files = app.hpp manager.hpp config.hpp device.hpp observer.hpp window.hpp process.hpp rendercontext.hpp outputplugin.hpp frustum.hpp culler.hpp curvedscreen.hpp
 INSTALLS += headers
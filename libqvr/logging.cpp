@@ -22,6 +22,12 @@
  */
 
 #include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#include <QVector>
+#include <QAtomicPointer>
 
 #ifdef ANDROID
 # include <android/log.h>
@@ -30,6 +36,7 @@
 #include "manager.hpp"
 #include "internalglobals.hpp"
 #include "logging.hpp"
+#include "ringwriter.hpp"
 
 static QByteArray QVRLogFile;
 static FILE* QVRLogStream = NULL;
@@ -58,6 +65,124 @@ const char* QVRGetLogFile()
     return QVRLogFile.isEmpty() ? NULL : QVRLogFile.data();
 }
 
+/* The timestamp is from the monotonic system clock so that the logs of
+ * different processes on the same host can be compared. */
+static qint64 QVRLogTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void QVRFormatLogLine(char* buf, qint64 timestamp, const char* s)
+{
+    // We want to print one complete line with exactly one call to fputs to
+    // line-buffered stderr so that the output of different processes is not
+    // mangled. Therefore we buffer what we want to print.
+    int bufIndex = snprintf(buf, QVR_MSG_BUFSIZE, "QVR");
+    if (QVRManagerInstance && QVRManagerInstance->_config && QVRManagerInstance->_config->processConfigs().size() > 1)
+        bufIndex += snprintf(buf + bufIndex, QVR_MSG_BUFSIZE - bufIndex, "[%d]", QVRManagerInstance->_processIndex);
+    bufIndex += snprintf(buf + bufIndex, QVR_MSG_BUFSIZE - bufIndex, " %lld.%06lld: %s",
+            static_cast<long long>(timestamp / 1000000000),
+            static_cast<long long>((timestamp % 1000000000) / 1000), s);
+    buf[std::min(bufIndex, QVR_MSG_BUFSIZE - 2)] = '\n';
+    bufIndex++;
+    buf[std::min(bufIndex, QVR_MSG_BUFSIZE - 1)] = '\0';
+}
+
+/* Asynchronous logging.
+ *
+ * Each thread that logs gets its own ring of formatted lines in a QVRRingWriter,
+ * so that logging threads never block on each other or on the log stream. The
+ * writer thread collects the lines from all rings, sorts them by timestamp, and
+ * writes them in large chunks.
+ * If a ring is full, new messages are dropped and counted, and the writer
+ * reports the number of dropped messages. Fatal messages bypass the rings and
+ * are written immediately since the process might not survive them; the lines
+ * that are still in the rings are written first so that the order is kept. */
+
+static const int QVRLogRingCapacity = 128;
+static const int QVRLogWriterSleepMsecs = 5;
+
+struct QVRLogEntry
+{
+    qint64 timestamp;
+    char line[QVR_MSG_BUFSIZE];
+};
+
+class QVRLogSink
+{
+private:
+    QVector<QVRLogEntry> _entries;
+
+public:
+    void addThread(const QVRWriterRing<QVRLogEntry>&) {}
+    void add(const QVRWriterRing<QVRLogEntry>&, const QVRLogEntry& entry);
+    void addDropped(const QVRWriterRing<QVRLogEntry>&, int dropped);
+    void flush();
+};
+
+typedef QVRRingWriter<QVRLogEntry, QVRLogSink> QVRLogWriter;
+
+void QVRLogSink::add(const QVRWriterRing<QVRLogEntry>&, const QVRLogEntry& entry)
+{
+    _entries.append(entry);
+}
+
+void QVRLogSink::addDropped(const QVRWriterRing<QVRLogEntry>&, int dropped)
+{
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%d log messages dropped", dropped);
+    QVRLogEntry entry;
+    entry.timestamp = QVRLogTimestamp();
+    QVRFormatLogLine(entry.line, entry.timestamp, msg);
+    _entries.append(entry);
+}
+
+void QVRLogSink::flush()
+{
+    if (_entries.isEmpty())
+        return;
+    std::stable_sort(_entries.begin(), _entries.end(),
+            [](const QVRLogEntry& a, const QVRLogEntry& b) { return a.timestamp < b.timestamp; });
+    // Write complete lines in chunks that are small enough to be written
+    // atomically, so that the output of different processes is not mangled.
+    FILE* stream = (QVRLogStream ? QVRLogStream : stderr);
+    char chunk[4 * QVR_MSG_BUFSIZE];
+    int chunkLen = 0;
+    for (int i = 0; i < _entries.size(); i++) {
+        int len = strlen(_entries[i].line);
+        if (chunkLen + len >= static_cast<int>(sizeof(chunk))) {
+            std::fputs(chunk, stream);
+            chunkLen = 0;
+        }
+        memcpy(chunk + chunkLen, _entries[i].line, len + 1);
+        chunkLen += len;
+    }
+    if (chunkLen > 0)
+        std::fputs(chunk, stream);
+    _entries.clear();
+}
+
+static QAtomicPointer<QVRLogWriter> QVRLogWriterInstance(NULL);
+
+void QVRStartLogWriter()
+{
+    if (QVRLogWriterInstance.loadAcquire())
+        return;
+    QVRLogWriter* writer = new QVRLogWriter(new QVRLogSink, QVRLogRingCapacity, QVRLogWriterSleepMsecs);
+    writer->start();
+    QVRLogWriterInstance.storeRelease(writer);
+}
+
+void QVRStopLogWriter()
+{
+    QVRLogWriter* writer = QVRLogWriterInstance.fetchAndStoreOrdered(NULL);
+    if (!writer)
+        return;
+    writer->stop();
+    delete writer;
+}
+
 void QVRMsg(QVRLogLevel level, const char* s)
 {
 #ifdef ANDROID
@@ -74,17 +199,20 @@ void QVRMsg(QVRLogLevel level, const char* s)
         return;
     }
 #endif
-    Q_UNUSED(level);
-    // We want to print one complete line with exactly one call to fputs to
-    // line-buffered stderr so that the output of different processes is not
-    // mangled. Therefore we buffer what we want to print.
-    char buf[QVR_MSG_BUFSIZE] = "QVR";
-    int bufIndex = 3;
-    if (QVRManagerInstance && QVRManagerInstance->_config && QVRManagerInstance->_config->processConfigs().size() > 1)
-        bufIndex += snprintf(buf + bufIndex, QVR_MSG_BUFSIZE - bufIndex, "[%d]", QVRManagerInstance->_processIndex);
-    bufIndex += snprintf(buf + bufIndex, QVR_MSG_BUFSIZE - bufIndex, ": %s", s);
-    buf[std::min(bufIndex, QVR_MSG_BUFSIZE - 2)] = '\n';
-    bufIndex++;
-    buf[std::min(bufIndex, QVR_MSG_BUFSIZE - 1)] = '\0';
-    std::fputs(buf, QVRLogStream ? QVRLogStream : stderr);
+    qint64 timestamp = QVRLogTimestamp();
+    QVRLogWriter* writer = QVRLogWriterInstance.loadAcquire();
+    if (!writer || level == QVR_Log_Level_Fatal) {
+        if (writer)
+            writer->drain();
+        char buf[QVR_MSG_BUFSIZE];
+        QVRFormatLogLine(buf, timestamp, s);
+        std::fputs(buf, QVRLogStream ? QVRLogStream : stderr);
+        return;
+    }
+    // The entry is copied into the ring, so it is kept in thread-local storage
+    // instead of on the stack.
+    static thread_local QVRLogEntry entry;
+    entry.timestamp = timestamp;
+    QVRFormatLogLine(entry.line, timestamp, s);
+    writer->push(entry);
 }
@@ -31,15 +31,33 @@
 void QVRSetLogFile(const char* name, bool truncate); /* NULL means stderr */
 const char* QVRGetLogFile(); /* NULL means stderr */
 
+/* Start and stop asynchronous logging. While the log writer runs, QVRMsg() only
+ * puts messages into a per-thread ring and a background thread writes them.
+ * Stopping writes all pending messages; it must only be called when no other
+ * threads log anymore. */
+void QVRStartLogWriter();
+void QVRStopLogWriter();
+
 void QVRMsg(QVRLogLevel level, const char* s);
 
 #define QVR_MSG_BUFSIZE 1024
 
+/* Messages with a level above QVR_COMPILED_LOG_LEVEL are removed at compile time.
+ * By default, firehose messages only exist in debug builds. */
+#ifndef QVR_COMPILED_LOG_LEVEL
+# ifdef NDEBUG
+#  define QVR_COMPILED_LOG_LEVEL QVR_Log_Level_Debug
+# else
+#  define QVR_COMPILED_LOG_LEVEL QVR_Log_Level_Firehose
+# endif
+#endif
+
 #define QVR_MSG(level, ...) { char buf[QVR_MSG_BUFSIZE]; snprintf(buf, QVR_MSG_BUFSIZE, __VA_ARGS__); QVRMsg(level, buf); }
+#define QVR_LEVEL_MSG(level, ...) { if (QVR_COMPILED_LOG_LEVEL >= level && QVRManager::logLevel() >= level) { QVR_MSG(level, __VA_ARGS__); } }
 #define QVR_FATAL(...)      { QVR_MSG(QVR_Log_Level_Fatal, __VA_ARGS__); }
-#define QVR_WARNING(...)    { if (QVRManager::logLevel() >= QVR_Log_Level_Warning)  { QVR_MSG(QVR_Log_Level_Warning, __VA_ARGS__); } }
-#define QVR_INFO(...)       { if (QVRManager::logLevel() >= QVR_Log_Level_Info)     { QVR_MSG(QVR_Log_Level_Info, __VA_ARGS__); } }
-#define QVR_DEBUG(...)      { if (QVRManager::logLevel() >= QVR_Log_Level_Debug)    { QVR_MSG(QVR_Log_Level_Debug, __VA_ARGS__); } }
-#define QVR_FIREHOSE(...)   { if (QVRManager::logLevel() >= QVR_Log_Level_Firehose) { QVR_MSG(QVR_Log_Level_Firehose, __VA_ARGS__); } }
+#define QVR_WARNING(...)    QVR_LEVEL_MSG(QVR_Log_Level_Warning, __VA_ARGS__)
+#define QVR_INFO(...)       QVR_LEVEL_MSG(QVR_Log_Level_Info, __VA_ARGS__)
+#define QVR_DEBUG(...)      QVR_LEVEL_MSG(QVR_Log_Level_Debug, __VA_ARGS__)
+#define QVR_FIREHOSE(...)   QVR_LEVEL_MSG(QVR_Log_Level_Firehose, __VA_ARGS__)
 
 #endif
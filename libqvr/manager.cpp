@@ -23,9 +23,9 @@
  */
 
 #include <cmath>
+#include <cstring>
 
 #include <QDir>
-#include <QQueue>
 #include <QGuiApplication>
 #include <QTimer>
 #include <QElapsedTimer>
@@ -43,7 +43,22 @@
 #include "process.hpp"
 #include "ipc.hpp"
 #include "internalglobals.hpp"
-
+#include "latency.hpp"
+#include "devicesampler.hpp"
+#include "offaxis.hpp"
+#include "framescheduler.hpp"
+#include "trace.hpp"
+#include "clocksync.hpp"
+
+
+// How often a child process that died is relaunched before we give up on it
+static const int QVRMaxChildRelaunches = 3;
+// Maximum time per frame that the main loop spends on Qt event processing
+static const int QVRMaxEventProcessingMsecs = 4;
+// Clock synchronization: number of exchanges with each child process at
+// startup and after a relaunch, and interval of single exchanges afterwards
+static const int QVRClockSyncInitialRounds = 8;
+static const qint64 QVRClockSyncIntervalNsecs = 1000000000;
 
 static bool parseLogLevel(const QString& ll, QVRLogLevel* logLevel)
 {
@@ -82,6 +97,7 @@ static void removeArg(int& argc, char* argv[], int i)
 QVRManager::QVRManager(int& argc, char* argv[]) :
     _triggerTimer(new QTimer),
     _fpsTimer(new QTimer),
+    _framePacing(),
 #ifdef ANDROID
     _logLevel(QVR_Log_Level_Debug),
 #else
@@ -93,28 +109,42 @@ QVRManager::QVRManager(int& argc, char* argv[]) :
     _syncToVBlank(true),
     _fpsMsecs(0),
     _fpsCounter(0),
+    _deviceSamplingRate(0),
     _configFilename(),
     _autodetect(),
     _isRelaunchedMain(false),
     _server(NULL),
     _client(NULL),
+    _eventWriter(NULL),
     _app(NULL),
     _config(NULL),
     _devices(),
-    _deviceLastStates(),
+    _deviceEventDetector(NULL),
+    _deviceSampler(NULL),
+    _deviceIsSampled(),
+    _deviceSamples(),
     _observers(),
     _mainWindow(NULL),
     _windows(),
+    _offAxisSolver(new QVROffAxisSolver),
+    _frameScheduler(NULL),
     _thisProcess(NULL),
     _childProcesses(),
+    _clockEstimators(),
+    _lastClockSyncNsecs(0),
+    _childSwapNsecs(),
+    _swapSkewMaxNsecs(0),
+    _swapSkewSumNsecs(0),
+    _swapSkewCount(0),
     _wantExit(false),
     _wandNavigationTimer(NULL),
     _wasdqeTimer(NULL),
+    _startupTimelineLogged(false),
     _initialized(false)
 {
     Q_ASSERT(!QVRManagerInstance); // there can be only one
     QVRManagerInstance = this;
-    QVREventQueue = new QQueue<QVREvent>;
+    QVREventQueue = new QVREventRing;
     Q_INIT_RESOURCE(qvr);
 
     // set global timeout value (-1 means never timeout)
@@ -168,6 +198,21 @@ QVRManager::QVRManager(int& argc, char* argv[]) :
             break;
         }
     }
+    // set trace file
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--qvr-trace") == 0 && i < argc - 1) {
+            QVRSetTraceFile(argv[i + 1]);
+            removeTwoArgs(argc, argv, i);
+            break;
+        } else if (strncmp(argv[i], "--qvr-trace=", 12) == 0) {
+            QVRSetTraceFile(argv[i] + 12);
+            removeArg(argc, argv, i);
+            break;
+        }
+    }
+
+    // from now on, log asynchronously
+    QVRStartLogWriter();
 
     // set working directory
     for (int i = 1; i < argc; i++) {
@@ -208,6 +253,44 @@ QVRManager::QVRManager(int& argc, char* argv[]) :
         }
     }
 
+    // set device sampling rate
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--qvr-device-sampling-rate") == 0 && i < argc - 1) {
+            _deviceSamplingRate = ::atoi(argv[i + 1]);
+            removeTwoArgs(argc, argv, i);
+            break;
+        } else if (strncmp(argv[i], "--qvr-device-sampling-rate=", 27) == 0) {
+            _deviceSamplingRate = ::atoi(argv[i] + 27);
+            removeArg(argc, argv, i);
+            break;
+        }
+    }
+
+    // set frame pacing policy
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--qvr-frame-pacing") == 0 && i < argc - 1) {
+            _framePacing = argv[i + 1];
+            removeTwoArgs(argc, argv, i);
+            break;
+        } else if (strncmp(argv[i], "--qvr-frame-pacing=", 19) == 0) {
+            _framePacing = argv[i] + 19;
+            removeArg(argc, argv, i);
+            break;
+        }
+    }
+
+    // set latency probe mode
+    bool latencyProbe = (::getenv("QVR_LATENCY_PROBE") != NULL);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--qvr-latency-probe") == 0) {
+            latencyProbe = true;
+            removeArg(argc, argv, i);
+            break;
+        }
+    }
+    if (latencyProbe)
+        QVRLatencyProbe = new QVRLatencyHistogram;
+
     // get configuration file name (if any)
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--qvr-config") == 0 && i < argc - 1) {
@@ -290,6 +373,8 @@ QVRManager::~QVRManager()
         vr::VR_Shutdown();
     }
 #endif
+    delete _deviceSampler; // stops the sampler thread and deletes the sampled devices
+    delete _deviceEventDetector;
     for (int i = 0; i < _devices.size(); i++)
         delete _devices.at(i);
     for (int i = 0; i < _observers.size(); i++)
@@ -298,18 +383,27 @@ QVRManager::~QVRManager()
         delete _windows.at(i);
     for (int i = 0; i < _childProcesses.size(); i++)
         delete _childProcesses.at(i);
+    for (int i = 0; i < _clockEstimators.size(); i++)
+        delete _clockEstimators.at(i);
     delete _mainWindow;
+    delete _offAxisSolver;
     delete _thisProcess;
     delete _config;
     _config = NULL;
     delete _triggerTimer;
     delete _fpsTimer;
+    delete _frameScheduler;
     delete _wasdqeTimer;
     delete _wandNavigationTimer;
     delete QVREventQueue;
     QVREventQueue = NULL;
+    delete QVRLatencyProbe;
+    QVRLatencyProbe = NULL;
     delete _server;
     delete _client;
+    delete _eventWriter;
+    QVRStopTrace();
+    QVRStopLogWriter();
     QVRManagerInstance = NULL;
 }
 
@@ -325,6 +419,12 @@ void QVRManager::buildProcessCommandLine(int processIndex, QString* prg, QString
     *args << QString("--qvr-process=%1").arg(processIndex);
     *args << QString("--qvr-timeout=%1").arg(QVRTimeoutMsecs);
     *args << QString("--qvr-fps=%1").arg(_fpsMsecs);
+    if (_deviceSamplingRate > 0)
+        *args << QString("--qvr-device-sampling-rate=%1").arg(_deviceSamplingRate);
+    if (processIndex == 0 && !_framePacing.isEmpty())
+        *args << QString("--qvr-frame-pacing=%1").arg(_framePacing);
+    if (QVRLatencyProbe)
+        *args << "--qvr-latency-probe";
     *args << QString("--qvr-log-level=%1").arg(
             QVRManager::logLevel() == QVR_Log_Level_Fatal ? "fatal"
             : QVRManager::logLevel() == QVR_Log_Level_Warning ? "warning"
@@ -333,10 +433,14 @@ void QVRManager::buildProcessCommandLine(int processIndex, QString* prg, QString
             : "firehose");
     if (QVRGetLogFile())
         *args << QString("--qvr-log-file=%1").arg(QVRGetLogFile());
+    if (QVRGetTraceFile())
+        *args << QString("--qvr-trace=%1").arg(QVRGetTraceFile());
     *args << QString("--qvr-wd=%1").arg(QDir::currentPath());
     if (_syncToVBlankWasSet)
         *args << QString("--qvr-sync-to-vblank=%1").arg(_syncToVBlank ? 1 : 0);
-    *args << QString("--qvr-config=%1").arg(_configFilename);
+    // Child processes get the configuration from the main process
+    if (processIndex == 0 && !_configFilename.isEmpty())
+        *args << QString("--qvr-config=%1").arg(_configFilename);
     *args << _appArgs;
     if (!processConfig.launcher().isEmpty() && processConfig.launcher() != "manual") {
         QStringList ll = processConfig.launcher().split(' ', Qt::SkipEmptyParts);
@@ -353,20 +457,44 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
 
     _app = app;
 
+    // Start the global timer
+    QVRTimer.start();
+
+    // Start tracing (if requested); trace events use the global timer
+    if (!QVRStartTrace(_processIndex))
+        return false;
+
+    // Whether this is a child process that was relaunched after it died
+    bool rejoining = false;
+
     if (!_workingDir.isEmpty())
         QDir::setCurrent(_workingDir);
 
     // Find out about our available screens. Has to be done before QVRConfig::createDefault().
     QVRGetScreenInfo();
 
-    // Get configuration
+    // Get configuration. Child processes receive it from the main process
+    // when connecting to it, so that only the main process needs to read
+    // and parse configuration files.
+    _thisProcess = new QVRProcess(_processIndex);
     _config = new QVRConfig;
-    if (_configFilename.isEmpty()) {
-        _config->createDefault(preferCustomNavigation, _autodetect);
+    if (_processIndex == 0) {
+        if (_configFilename.isEmpty()) {
+            _config->createDefault(preferCustomNavigation, _autodetect);
+        } else {
+            if (!_config->readFromFile(_configFilename)) {
+                return false;
+            }
+        }
     } else {
-        if (!_config->readFromFile(_configFilename)) {
+        _client = new QVRClient;
+        QVR_INFO("child process with index %d connecting to main ...", _processIndex);
+        if (!_client->start(_mainName, _config)) {
+            QVR_FATAL("cannot connect to main");
             return false;
         }
+        _thisProcess->_connectedNsecs = QVRTimer.nsecsElapsed();
+        QVR_INFO("... done");
     }
 
     // Check if we need to relaunch the main process to apply configuration
@@ -476,10 +604,14 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
     // Create devices
     bool haveGamepadDevices = false;
     bool haveVrpnDevices = false;
+    if (_processIndex == 0)
+        _deviceEventDetector = new QVRDeviceEventDetector;
     for (int d = 0; d < _config->deviceConfigs().size(); d++) {
         _devices.append(new QVRDevice(d));
-        if (_processIndex == 0)
-            _deviceLastStates.append(*(_devices.last()));
+        if (_processIndex == 0) {
+            _deviceEventDetector->addDevice(*(_devices.last()));
+            _deviceIsSampled.append(false);
+        }
         if (_config->deviceConfigs()[d].buttonsType() == QVR_Device_Buttons_Gamepad
                 || _config->deviceConfigs()[d].analogsType() == QVR_Device_Analogs_Gamepad) {
             haveGamepadDevices = true;
@@ -564,7 +696,6 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
     }
 
     // Create processes
-    _thisProcess = new QVRProcess(_processIndex);
     if (_processIndex == 0) {
         if (_config->processConfigs().size() > 1) {
             _serializationBuffer.reserve(1024 * 1024);
@@ -584,14 +715,18 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
                     ipc = QVR_IPC_SharedMemory;
                 }
             }
+            QByteArray serializedConfig;
+            QDataStream configDataStream(&serializedConfig, QIODevice::WriteOnly);
+            configDataStream << *_config;
+            QVR_INFO("shipping %d bytes of configuration to child processes", serializedConfig.size());
             _server = new QVRServer;
             bool r;
             if (ipc == QVR_IPC_TcpSocket)
-                r = _server->startTcp(_config->processConfigs()[0].address());
+                r = _server->startTcp(serializedConfig, _config->processConfigs()[0].address());
             else if (ipc == QVR_IPC_LocalSocket)
-                r = _server->startLocal();
+                r = _server->startLocal(serializedConfig);
             else
-                r = _server->startSharedMemory();
+                r = _server->startSharedMemory(serializedConfig);
             if (!r) {
                 QVR_FATAL("cannot start IPC server");
                 return false;
@@ -599,9 +734,12 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
             _serializationBuffer.resize(0);
             QDataStream serializationDataStream(&_serializationBuffer, QIODevice::WriteOnly);
             _app->serializeStaticData(serializationDataStream);
+            // Issue all launches first and only then wait for them, so that
+            // slow launchers (e.g. ssh to remote hosts) run concurrently.
             for (int p = 1; p < _config->processConfigs().size(); p++) {
                 QVRProcess* process = new QVRProcess(p);
                 _childProcesses.append(process);
+                _clockEstimators.append(new QVRClockEstimator);
                 QVR_INFO("launching child process %s (index %d) ...", qPrintable(process->id()), p);
                 QString prg;
                 QStringList args;
@@ -609,32 +747,49 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
                 if (!process->launch(prg, args))
                     return false;
             }
+            for (int p = 0; p < _childProcesses.size(); p++)
+                if (!_childProcesses[p]->waitForLaunch())
+                    return false;
             QVR_INFO("waiting for child processes to connect to main ...");
-            if (!_server->waitForClients())
+            QVector<qint64> connectNsecs;
+            if (!_server->waitForClients(&connectNsecs))
                 return false;
             QVR_INFO("... all clients connected");
+            syncChildClocks(QVRClockSyncInitialRounds);
             QVR_INFO("initializing child processes with %d bytes of static application data", _serializationBuffer.size());
             _server->sendCmdInit(_serializationBuffer);
             _server->flush();
+            qint64 initNsecs = QVRTimer.nsecsElapsed();
+            for (int p = 0; p < _childProcesses.size(); p++) {
+                _childProcesses[p]->_connectedNsecs = connectNsecs[p];
+                _childProcesses[p]->_initNsecs = initNsecs;
+                if (_childProcesses[p]->config().launcher() != "manual")
+                    _server->setClientProcess(p + 1, _childProcesses[p]);
+            }
         }
     } else {
         _serializationBuffer.reserve(1024);
-        _client = new QVRClient;
-        QVR_INFO("child process %s (index %d) connecting to main ...", qPrintable(_thisProcess->id()), _processIndex);
-        if (!_client->start(_mainName)) {
-            QVR_FATAL("cannot connect to main");
-            return false;
-        }
-        QVR_INFO("... done");
+        _eventWriter = new QVREventWriter;
         QVR_INFO("child process %s (index %d) waiting for init command from main ...", qPrintable(_thisProcess->id()), _processIndex);
         QVRClientCmd cmd;
-        if (!_client->receiveCmd(&cmd, true) || cmd != QVRClientCmdInit) {
+        bool haveCmd;
+        while ((haveCmd = _client->receiveCmd(&cmd, true))
+                && (cmd == QVRClientCmdClockSync || cmd == QVRClientCmdClock)) {
+            if (cmd == QVRClientCmdClockSync) {
+                _client->sendReplyClockSync(QVRTimer.nsecsElapsed());
+                _client->flush();
+            } else {
+                receiveClusterClock();
+            }
+        }
+        if (!haveCmd || cmd != QVRClientCmdInit) {
             QVR_FATAL("cannot receive init command from main");
             return false;
         }
         QVR_INFO("... done");
         QVR_INFO("initializing child process %s (index %d) ...", qPrintable(_thisProcess->id()), _processIndex);
-        _client->receiveCmdInitArgs(_app);
+        _client->receiveCmdInitArgs(_app, &rejoining);
+        _thisProcess->_initNsecs = QVRTimer.nsecsElapsed();
         QVR_INFO("... done");
     }
 
@@ -690,7 +845,33 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
         if (!_app->initWindow(_windows[w]))
             return false;
     _mainWindow->winContext()->doneCurrent();
+    if (rejoining) {
+        // Tell the main process that we are ready to take part in the frames again
+        QVR_INFO("child process %s (index %d) rejoining ...", qPrintable(_thisProcess->id()), _processIndex);
+        _client->sendCmdSync(0, -1, QByteArray());
+        _client->flush();
+    }
     if (_processIndex == 0) {
+        if (_deviceSamplingRate > 0) {
+            // Hand the devices that can be sampled over to the sampler thread,
+            // and keep copies of their states for the rest of QVR and the application.
+            QList<QVRDevice*> sampledDevices;
+            for (int d = 0; d < _devices.size(); d++) {
+                if (QVRDeviceSampler::canSample(_devices[d]->config())) {
+                    sampledDevices.append(_devices[d]);
+                    _devices[d] = new QVRDevice(*(sampledDevices.last()));
+                    _deviceIsSampled[d] = true;
+                }
+            }
+            if (sampledDevices.size() > 0) {
+                QVR_INFO("sampling %d device(s) at %d Hz", sampledDevices.size(), _deviceSamplingRate);
+                _deviceSampler = new QVRDeviceSampler(sampledDevices, _deviceSamplingRate);
+                _deviceSamples.reserve(_deviceSampler->capacity());
+                _deviceSampler->start(QThread::HighPriority);
+            } else {
+                QVR_WARNING("no devices can be sampled at a fixed rate; ignoring the device sampling rate");
+            }
+        }
         updateDevices();
         _app->update(_observers);
     }
@@ -703,6 +884,12 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
 
     // Initialize render loop (only on main process)
     if (_processIndex == 0) {
+        // Set up frame pacing
+        _frameScheduler = new QVRFrameScheduler;
+        if (!_framePacing.isEmpty() && !_frameScheduler->setPolicy(_framePacing)) {
+            QVR_FATAL("invalid frame pacing policy %s", qPrintable(_framePacing));
+            return false;
+        }
         // Set up timer to trigger main loop
         QObject::connect(_triggerTimer, SIGNAL(timeout()), this, SLOT(mainLoop()));
         _triggerTimer->start();
@@ -712,9 +899,6 @@ bool QVRManager::init(QVRApp* app, bool preferCustomNavigation)
         _triggerTimer->start();
     }
 
-    // Start the global timer
-    QVRTimer.start();
-
     QGuiApplication::processEvents();
 
     _initialized = true;
@@ -726,11 +910,137 @@ bool QVRManager::isInitialized()
     return instance()->_initialized;
 }
 
+void QVRManager::checkChildProcesses()
+{
+    // Detect child processes that died, and relaunch them if possible.
+    // All other processes keep rendering in the meantime.
+    _server->checkClients();
+    QList<int> deadClients = _server->takeDeadClients();
+    for (int i = 0; i < deadClients.size(); i++) {
+        QVRProcess* process = _childProcesses[deadClients[i] - 1];
+        QVR_WARNING("child process %s (index %d) died", qPrintable(process->id()), process->index());
+        if (!_server->supportsRejoin() || process->config().launcher() == "manual") {
+            QVR_WARNING("  continuing without it (relaunching requires socket-based IPC and a non-manual launcher)");
+        } else if (process->_relaunchCount >= QVRMaxChildRelaunches) {
+            QVR_WARNING("  continuing without it (it was already relaunched %d times)", process->_relaunchCount);
+        } else {
+            if (process->state() != QProcess::NotRunning) {
+                // e.g. the launcher is still running but the process itself is gone;
+                // do not wait for it here but relaunch it once it finished
+                QVR_WARNING("  killing it; it will be relaunched when it finished");
+                process->kill();
+                process->_relaunchPending = true;
+            } else {
+                relaunchChildProcess(process);
+            }
+        }
+    }
+    for (int i = 0; i < _childProcesses.size(); i++) {
+        QVRProcess* process = _childProcesses[i];
+        if (process->_relaunchPending && process->state() == QProcess::NotRunning) {
+            process->_relaunchPending = false;
+            relaunchChildProcess(process);
+        }
+    }
+    if (!_server->supportsRejoin())
+        return;
+
+    // Let relaunched child processes rejoin: they get the configuration and the
+    // static application data, and then take part in the next frame that starts
+    // after they completed their initialization. Devices and observers are sent
+    // to all processes in every frame anyway, but the application may only send
+    // changes of its dynamic data, so it is told to send its complete state.
+    int p;
+    while ((p = _server->acceptRejoiningClient()) > 0) {
+        QVR_INFO("child process %s (index %d) reconnected, initializing it ...",
+                qPrintable(_childProcesses[p - 1]->id()), p);
+        _serializationBuffer.resize(0);
+        QDataStream serializationDataStream(&_serializationBuffer, QIODevice::WriteOnly);
+        _app->serializeStaticData(serializationDataStream);
+        _server->sendCmdInitRejoin(p, _serializationBuffer);
+        _server->flush();
+    }
+    QList<int> rejoinedClients = _server->takeRejoinedClients();
+    for (int i = 0; i < rejoinedClients.size(); i++) {
+        QVRProcess* process = _childProcesses[rejoinedClients[i] - 1];
+        QVR_WARNING("child process %s (index %d) rejoined %.1f ms after its relaunch",
+                qPrintable(process->id()), process->index(),
+                (QVRTimer.nsecsElapsed() - process->_launchNsecs) / 1e6);
+        _app->processRejoined(process);
+    }
+    if (rejoinedClients.size() > 0)
+        syncChildClocks(QVRClockSyncInitialRounds);
+}
+
+void QVRManager::relaunchChildProcess(QVRProcess* process)
+{
+    QVR_WARNING("relaunching child process %s (index %d)", qPrintable(process->id()), process->index());
+    QString prg;
+    QStringList args;
+    buildProcessCommandLine(process->index(), &prg, &args);
+    process->_relaunchCount++;
+    process->launch(prg, args);
+    // the relaunched process has a new timer
+    delete _clockEstimators[process->index() - 1];
+    _clockEstimators[process->index() - 1] = new QVRClockEstimator;
+}
+
+void QVRManager::syncChildClocks(int rounds)
+{
+    // This must be called when the child processes wait for commands,
+    // so that they answer immediately.
+    QVR_TRACE_SCOPE("sync child clocks");
+    QVector<qint64> t2, t3, t4;
+    for (int r = 0; r < rounds; r++) {
+        qint64 t1 = _server->sendCmdClockSync();
+        _server->flush();
+        _server->receiveReplyClockSync(&t2, &t3, &t4);
+        for (int p = 0; p < _childProcesses.size(); p++)
+            if (t4[p] >= 0)
+                _clockEstimators[p]->addSample(t1, t2[p], t3[p], t4[p]);
+    }
+    _serializationBuffer.resize(0);
+    QDataStream serializationDataStream(&_serializationBuffer, QIODevice::WriteOnly);
+    serializationDataStream << static_cast<qint32>(_childProcesses.size() + 1);
+    serializationDataStream << false << qint64(0) << 0.0 << qint64(0);
+    for (int p = 0; p < _childProcesses.size(); p++) {
+        qint64 offset = 0, reference = 0, delay = 0;
+        double drift = 0.0;
+        bool valid = _clockEstimators[p]->isValid();
+        if (valid) {
+            _clockEstimators[p]->estimate(&offset, &drift, &reference, &delay);
+            QVR_FIREHOSE("  ... clock of child process %d: offset %lld ns, drift %g ppm, round trip %lld ns",
+                    p + 1, static_cast<long long>(offset), drift * 1e6, static_cast<long long>(delay));
+        }
+        serializationDataStream << valid << offset << drift << reference;
+    }
+    _server->sendCmdClock(_serializationBuffer);
+    _server->flush();
+    _lastClockSyncNsecs = QVRTimer.nsecsElapsed();
+}
+
+void QVRManager::receiveClusterClock()
+{
+    qint64 offset, reference;
+    double drift;
+    if (_client->receiveCmdClockArgs(_processIndex, &offset, &drift, &reference))
+        QVRClusterTimer.set(offset, drift, reference);
+}
+
+qint64 QVRManager::lastSwapNsecs() const
+{
+    qint64 swapNsecs = -1;
+    for (int w = 0; w < _windows.size(); w++)
+        swapNsecs = qMax(swapNsecs, _windows[w]->lastSwapNsecs());
+    return swapNsecs;
+}
+
 void QVRManager::mainLoop()
 {
     Q_ASSERT(_processIndex == 0);
 
     QVR_FIREHOSE("mainLoop() ...");
+    QVR_TRACE_SCOPE("frame");
 
     _mainWindow->winContext()->makeCurrent(_mainWindow);
 
@@ -747,7 +1057,21 @@ void QVRManager::mainLoop()
         return;
     }
 
+    QVRTraceBegin("wait for frame start");
+    _frameScheduler->waitForFrameStart();
+    QVRTraceEnd("wait for frame start");
+
+    if (_childProcesses.size() > 0) {
+        QVR_TRACE_SCOPE("check child processes");
+        checkChildProcesses();
+        if (QVRTimer.nsecsElapsed() - _lastClockSyncNsecs >= QVRClockSyncIntervalNsecs)
+            syncChildClocks(1);
+    }
+
+    QVRTraceBegin("update devices");
     updateDevices();
+    QVRTraceEnd("update devices");
+    QVRTraceBegin("update observers");
     for (int o = 0; o < _observers.size(); o++) {
         QVRObserver* obs = _observers[o];
         QVR_FIREHOSE("  ... updating observer %d", o);
@@ -868,16 +1192,21 @@ void QVRManager::mainLoop()
                 const QVRDevice* dev0 = _devices.at(td0);
                 const QVRDevice* dev1 = _devices.at(td1);
                 obs->setTracking(dev0->position(), dev0->orientation(), dev1->position(), dev1->orientation());
+                obs->_trackingTimestamp = qMin(dev0->timestamp(), dev1->timestamp());
             } else if (td0 >= 0) {
                 const QVRDevice* dev = _devices.at(td0);
                 obs->setTracking(dev->position(), dev->orientation());
+                obs->_trackingTimestamp = dev->timestamp();
             }
         }
     }
 
+    QVRTraceEnd("update observers");
+
     _app->getNearFar(_near, _far);
 
     if (_childProcesses.size() > 0) {
+        QVR_TRACE_SCOPE("send render commands");
         for (int d = 0; d < _devices.size(); d++) {
             _serializationBuffer.resize(0);
             QDataStream serializationDataStream(&_serializationBuffer, QIODevice::WriteOnly);
@@ -912,22 +1241,51 @@ void QVRManager::mainLoop()
 
     // process events and run application updates while the windows wait for the buffer swap
     QVR_FIREHOSE("  ... event processing");
-    QGuiApplication::processEvents();
+    QVRTraceBegin("process events");
+    QGuiApplication::processEvents(QEventLoop::AllEvents, QVRMaxEventProcessingMsecs);
+    if (_deviceSamples.size() > 0) {
+        QVR_FIREHOSE("  ... delivering %d device samples", _deviceSamples.size());
+        _app->deviceSamples(_deviceSamples);
+    }
     processEventQueue();
+    QVRTraceEnd("process events");
     QVR_FIREHOSE("  ... app update");
+    QVRTraceBegin("app update");
     _app->update(_observers);
+    QVRTraceEnd("app update");
 
     // now wait for windows to finish buffer swap...
     waitForBufferSwaps();
+    _frameScheduler->frameSwapped();
     // ... and for the children to sync
     if (_childProcesses.size() > 0) {
         QVR_FIREHOSE("  ... waiting for children to sync");
-        QList<QVREvent> childEvents;
-        _server->receiveCmdSync(&childEvents);
-        for (int e = 0; e < childEvents.size(); e++) {
-            QVR_FIREHOSE("  ... got an event from process %d window %d",
-                    childEvents[e].context.processIndex(), childEvents[e].context.windowIndex());
-            QVREventQueue->enqueue(childEvents[e]);
+        QVRTraceBegin("wait for child sync");
+        int n = _server->receiveCmdSync(QVREventQueue, &_childSwapNsecs);
+        QVRTraceEnd("wait for child sync");
+        // Measure the skew of the buffer swaps of all coupled processes
+        qint64 minSwapNsecs = lastSwapNsecs();
+        qint64 maxSwapNsecs = minSwapNsecs;
+        for (int p = 0; p < _childSwapNsecs.size(); p++) {
+            if (_childSwapNsecs[p] >= 0) {
+                if (minSwapNsecs < 0 || _childSwapNsecs[p] < minSwapNsecs)
+                    minSwapNsecs = _childSwapNsecs[p];
+                maxSwapNsecs = qMax(maxSwapNsecs, _childSwapNsecs[p]);
+            }
+        }
+        if (minSwapNsecs >= 0 && maxSwapNsecs > minSwapNsecs) {
+            qint64 skew = maxSwapNsecs - minSwapNsecs;
+            QVR_FIREHOSE("  ... buffer swap skew %.3f ms", skew / 1e6);
+            _swapSkewMaxNsecs = qMax(_swapSkewMaxNsecs, skew);
+            _swapSkewSumNsecs += skew;
+            _swapSkewCount++;
+        }
+        QVR_FIREHOSE("  ... got %d events from child processes", n);
+        if (!_startupTimelineLogged) {
+            qint64 firstFrameNsecs = QVRTimer.nsecsElapsed();
+            for (int p = 0; p < _childProcesses.size(); p++)
+                _childProcesses[p]->logStartupTimeline(firstFrameNsecs);
+            _startupTimelineLogged = true;
         }
     }
 
@@ -940,6 +1298,7 @@ void QVRManager::childLoop()
     while (_client->receiveCmd(&cmd)) {
         if (cmd == QVRClientCmdUpdateDevices) {
             QVR_FIREHOSE("  ... got command 'update-devices' from main");
+            QVR_TRACE_SCOPE("command update-devices");
 #ifdef HAVE_OCULUS
             if (QVROculus) {
                 QVRUpdateOculus();
@@ -974,35 +1333,52 @@ void QVRManager::childLoop()
             _client->flush();
         } else if (cmd == QVRClientCmdDevice) {
             QVR_FIREHOSE("  ... got command 'device' from main");
+            QVR_TRACE_SCOPE("command device");
             QVRDevice d;
             _client->receiveCmdDeviceArgs(&d);
             *(_devices.at(d.index())) = d;
         } else if (cmd == QVRClientCmdWasdqeState) {
             QVR_FIREHOSE("  ... got command 'wasdqestate' from main");
+            QVR_TRACE_SCOPE("command wasdqestate");
             _client->receiveCmdWasdqeStateArgs(&_wasdqeMouseProcessIndex,
                     &_wasdqeMouseWindowIndex, &_wasdqeMouseInitialized);
         } else if (cmd == QVRClientCmdObserver) {
             QVR_FIREHOSE("  ... got command 'observer' from main");
+            QVR_TRACE_SCOPE("command observer");
             QVRObserver o;
             _client->receiveCmdObserverArgs(&o);
             *(_observers.at(o.index())) = o;
         } else if (cmd == QVRClientCmdRender) {
             QVR_FIREHOSE("  ... got command 'render' from main");
+            QVR_TRACE_SCOPE("command render");
             _client->receiveCmdRenderArgs(&_near, &_far, _app);
             render();
             QGuiApplication::processEvents();
             int n = 0;
             _serializationBuffer.resize(0);
             QDataStream serializationDataStream(&_serializationBuffer, QIODevice::WriteOnly);
+            _eventWriter->reset();
             while (!QVREventQueue->empty()) {
-                serializationDataStream << QVREventQueue->dequeue();
+                _eventWriter->write(serializationDataStream, QVREventQueue->front());
+                QVREventQueue->dequeue();
                 n++;
             }
             waitForBufferSwaps();
             QVR_FIREHOSE("  ... sending command 'sync' with %d events in %d bytes to main", n, _serializationBuffer.size());
-            _client->sendCmdSync(n, _serializationBuffer);
+            _client->sendCmdSync(n, lastSwapNsecs(), _serializationBuffer);
             _client->flush();
+            if (!_startupTimelineLogged) {
+                _thisProcess->logStartupTimeline(QVRTimer.nsecsElapsed());
+                _startupTimelineLogged = true;
+            }
             _fpsCounter++;
+        } else if (cmd == QVRClientCmdClockSync) {
+            QVR_FIREHOSE("  ... got command 'clocksync' from main");
+            _client->sendReplyClockSync(QVRTimer.nsecsElapsed());
+            _client->flush();
+        } else if (cmd == QVRClientCmdClock) {
+            QVR_FIREHOSE("  ... got command 'clock' from main");
+            receiveClusterClock();
         } else if (cmd == QVRClientCmdQuit) {
             QVR_FIREHOSE("  ... got command 'quit' from main");
             _triggerTimer->stop();
@@ -1028,6 +1404,8 @@ void QVRManager::quit()
         _windows[w]->exitGL();
         _windows[w]->close();
     }
+    if (QVRLatencyProbe)
+        QVRLatencyProbe->report();
     QVR_DEBUG("... exiting process");
     _app->exitProcess(_thisProcess);
     _mainWindow->close();
@@ -1062,10 +1440,10 @@ void QVRManager::updateDevices()
 #endif
     bool haveRemoteDevices = false;
     for (int d = 0; d < _devices.size(); d++) {
-        if (_devices[d]->config().processIndex() == 0)
-            _devices[d]->update();
-        else
+        if (_devices[d]->config().processIndex() != 0)
             haveRemoteDevices = true;
+        else if (!_deviceIsSampled[d])
+            _devices[d]->update();
     }
     if (haveRemoteDevices) {
         QVR_FIREHOSE("ordering child processes to update devices");
@@ -1075,30 +1453,31 @@ void QVRManager::updateDevices()
         _server->receiveReplyUpdateDevices(_devices);
     }
 
-    /* Generate device events */
-    for (int d = 0; d < _devices.size(); d++) {
-        for (int b = 0; b < _devices[d]->buttonCount(); b++) {
-            if (_deviceLastStates[d].isButtonPressed(b) != _devices[d]->isButtonPressed(b)) {
-                QVRDeviceEvent e(*(_devices[d]), b, -1);
-                if (_devices[d]->isButtonPressed(b))
-                    QVREventQueue->enqueue(QVREvent(QVR_Event_DeviceButtonPress, e));
-                else
-                    QVREventQueue->enqueue(QVREvent(QVR_Event_DeviceButtonRelease, e));
-            }
-        }
-        for (int a = 0; a < _devices[d]->analogCount(); a++) {
-            if (_deviceLastStates[d].analogValue(a) != _devices[d]->analogValue(a)) {
-                QVREventQueue->enqueue(QVREvent(QVR_Event_DeviceAnalogChange,
-                            QVRDeviceEvent(*(_devices[d]), -1, a)));
-            }
+    /* Generate device events. Sampled devices are checked sample by sample,
+     * so that short button presses between two frames are not lost; the last
+     * sample becomes the current device state. */
+    if (_deviceSampler) {
+        _deviceSamples.clear();
+        QVRDevice sample;
+        while (_deviceSampler->popSample(&sample)) {
+            _deviceSamples.append(sample);
+            _deviceEventDetector->detect(sample.index(), sample, QVREventQueue);
+            *(_devices[sample.index()]) = sample;
         }
-        _deviceLastStates[d] = *(_devices[d]);
+        int droppedSamples = _deviceSampler->takeDroppedSampleCount();
+        if (droppedSamples > 0)
+            QVR_WARNING("device sample queue is full; dropped %d samples", droppedSamples);
+    }
+    for (int d = 0; d < _devices.size(); d++) {
+        if (!_deviceIsSampled[d])
+            _deviceEventDetector->detect(d, *(_devices[d]), QVREventQueue);
     }
 }
 
 void QVRManager::render()
 {
     QVR_FIREHOSE("  render() ...");
+    QVR_TRACE_SCOPE("render");
 
     _mainWindow->winContext()->makeCurrent(_mainWindow);
 #ifdef GL_FRAMEBUFFER_SRGB
@@ -1107,6 +1486,11 @@ void QVRManager::render()
 
     QVR_FIREHOSE("  ... preRenderProcess()");
     _app->preRenderProcess(_thisProcess);
+    // compute the view geometry of all windows in one batch
+    _offAxisSolver->clear();
+    for (int w = 0; w < _windows.size(); w++)
+        _windows[w]->addOffAxisViews(_offAxisSolver);
+    _offAxisSolver->solve();
     // render
     for (int w = 0; w < _windows.size(); w++) {
         if (!_wasdqeMouseInitialized) {
@@ -1123,7 +1507,7 @@ void QVRManager::render()
         _app->preRenderWindow(_windows[w]);
         QVR_FIREHOSE("  ... render(%d)", w);
         unsigned int textures[2];
-        const QVRRenderContext& renderContext = _windows[w]->computeRenderContext(_near, _far, textures);
+        const QVRRenderContext& renderContext = _windows[w]->computeRenderContext(_near, _far, _offAxisSolver, textures);
         for (int i = 0; i < renderContext.viewCount(); i++) {
             QVR_FIREHOSE("  ... view %d frustum: l=%g r=%g b=%g t=%g n=%g f=%g", i,
                     renderContext.frustum(i).leftPlane(),
@@ -1152,7 +1536,9 @@ void QVRManager::render()
      * the current scene, otherwise artefacts are displayed when the window
      * threads render them. It seems that glFlush() is not enough for all
      * OpenGL implementations; to be safe, we use glFinish(). */
+    QVRTraceBegin("finish");
     _mainWindow->_gl->glFinish();
+    QVRTraceEnd("finish");
     for (int w = 0; w < _windows.size(); w++) {
         QVR_FIREHOSE("  ... renderToScreen(%d)", w);
         _windows[w]->renderToScreen();
@@ -1166,6 +1552,7 @@ void QVRManager::render()
 
 void QVRManager::waitForBufferSwaps()
 {
+    QVR_TRACE_SCOPE("wait for buffer swaps");
     // wait for windows to finish the buffer swap
     for (int w = 0; w < _windows.size(); w++) {
         QVR_FIREHOSE("  ... waiting for buffer swap %d...", w);
@@ -1177,7 +1564,16 @@ void QVRManager::waitForBufferSwaps()
 void QVRManager::printFps()
 {
     if (_fpsCounter > 0) {
-        QVR_FATAL("fps %.1f", _fpsCounter / (_fpsMsecs / 1000.0f));
+        if (_swapSkewCount > 0) {
+            QVR_FATAL("fps %.1f, buffer swap skew avg %.3f ms max %.3f ms",
+                    _fpsCounter / (_fpsMsecs / 1000.0f),
+                    _swapSkewSumNsecs / 1e6 / _swapSkewCount, _swapSkewMaxNsecs / 1e6);
+            _swapSkewMaxNsecs = 0;
+            _swapSkewSumNsecs = 0;
+            _swapSkewCount = 0;
+        } else {
+            QVR_FATAL("fps %.1f", _fpsCounter / (_fpsMsecs / 1000.0f));
+        }
         _fpsCounter = 0;
     }
 }
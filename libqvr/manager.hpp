@@ -186,6 +186,7 @@
  */
 
 #include <QObject>
+#include <QVector>
 #include <QVector3D>
 #include <QByteArray>
 
@@ -197,15 +198,21 @@ class QWheelEvent;
 class QElapsedTimer;
 
 #include "config.hpp"
+#include "device.hpp"
 
 class QVRApp;
-class QVRDevice;
 class QVRObserver;
 class QVRWindow;
 class QVRProcess;
 class QVRRenderContext;
 class QVRServer;
 class QVRClient;
+class QVREventWriter;
+class QVRDeviceEventDetector;
+class QVRDeviceSampler;
+class QVROffAxisSolver;
+class QVRFrameScheduler;
+class QVRClockEstimator;
 
 /*!
  * \brief Level of logging of the QVR framework
@@ -226,7 +233,7 @@ typedef enum {
     QVR_Log_Level_Info = 2,
     /*! Additionally print debugging information */
     QVR_Log_Level_Debug = 3,
-    /*! Additionally print verbose per-frame debugging information */
+    /*! Additionally print verbose per-frame debugging information (only available in debug builds) */
     QVR_Log_Level_Firehose = 4
 } QVRLogLevel;
 
@@ -259,6 +266,7 @@ private:
     // Data initialized by the constructor:
     QTimer* _triggerTimer;
     QTimer* _fpsTimer;
+    QString _framePacing;
     QVRLogLevel _logLevel;
     QString _workingDir;
     int _processIndex;
@@ -266,6 +274,7 @@ private:
     bool _syncToVBlank;
     unsigned int _fpsMsecs;
     unsigned int _fpsCounter;
+    int _deviceSamplingRate;
     QString _configFilename;
     QString _mainName;
     QVRConfig::Autodetect _autodetect;
@@ -275,18 +284,30 @@ private:
     QByteArray _serializationBuffer;
     QVRServer* _server; // only on the main process
     QVRClient* _client; // only on a client process
+    QVREventWriter* _eventWriter; // only on a client process
     QVRApp* _app;
     QVRConfig* _config;
     QList<QVRDevice*> _devices;
-    QList<QVRDevice> _deviceLastStates;
+    QVRDeviceEventDetector* _deviceEventDetector; // only on the main process
+    QVRDeviceSampler* _deviceSampler;      // only on the main process, and only with --qvr-device-sampling-rate
+    QVector<bool> _deviceIsSampled;        // whether the device is updated by _deviceSampler
+    QVector<QVRDevice> _deviceSamples;     // samples taken by _deviceSampler since the last frame
     QList<QVRObserver*> _observers;
     QList<int> _observerNavigationDevices;
     QList<int> _observerTrackingDevices0;
     QList<int> _observerTrackingDevices1;
     QVRWindow* _mainWindow;
     QList<QVRWindow*> _windows;
+    QVROffAxisSolver* _offAxisSolver;
+    QVRFrameScheduler* _frameScheduler; // only on the main process
     QVRProcess* _thisProcess;
     QList<QVRProcess*> _childProcesses;
+    QList<QVRClockEstimator*> _clockEstimators; // only on the main process, one per child process
+    qint64 _lastClockSyncNsecs;                 // only on the main process
+    QVector<qint64> _childSwapNsecs;            // only on the main process: buffer swap times of the children
+    qint64 _swapSkewMaxNsecs;                   // only on the main process: swap skew statistics
+    qint64 _swapSkewSumNsecs;
+    int _swapSkewCount;
     float _near, _far;
     bool _wantExit;
     QElapsedTimer* _wandNavigationTimer;    // Wand-based observers: framerate-independent speed
@@ -301,10 +322,16 @@ private:
     QVector3D _wasdqePos;         // WASDQE observers: position
     float _wasdqeHorzAngle;       // WASDQE observers: angle around the y axis
     float _wasdqeVertAngle;       // WASDQE observers: angle around the x axis
+    bool _startupTimelineLogged;  // whether the startup timeline was logged after the first frame
     bool _initialized;
 
     void buildProcessCommandLine(int processIndex, QString* prg, QStringList* args);
 
+    void syncChildClocks(int rounds);
+    void relaunchChildProcess(QVRProcess* process);
+    void receiveClusterClock();
+    qint64 lastSwapNsecs() const;
+
     void processEventQueue();
 
     void updateDevices();
@@ -315,6 +342,7 @@ private:
     friend void QVRMsg(QVRLogLevel level, const char* s);
 
 private slots:
+    void checkChildProcesses();
     void mainLoop();
     void childLoop();
     void printFps();
@@ -331,7 +359,8 @@ public:
      * The following command line options are intereted by the QVR manager
      * and removed from \a argc and \a argv:
      * - \-\-qvr-config=\<config.qvr\><br>
-     *   Specify a QVR configuration file.
+     *   Specify a QVR configuration file. Only the main process reads this file;
+     *   child processes receive the configuration from the main process.
      * - \-\-qvr-timeout=\<msecs\><br>
      *   Set a timeout value in milliseconds for all interprocess communication.
      *   The default is -1, which means to never timeout.
@@ -339,10 +368,34 @@ public:
      *   See \a QVRLogLevel.
      * - \-\-qvr-log-file=\<filename\><br>
      *   Write all log messages to the given file instead of the standard error stream.
+     * - \-\-qvr-trace=\<filename\><br>
+     *   Record the timing of the main loop phases, interprocess communication, and
+     *   window rendering and buffer swaps in the Chrome trace event format. Each process
+     *   writes its own file \<filename\>.\<processindex\>; use qvr-trace-merge to
+     *   combine them into a single trace that can be viewed in chrome://tracing or Perfetto.
      * - \-\-qvr-sync-to-vblank=<0|1><br>
      *   Disable (0) or enable (1) sync-to-vblank. This overrides the per-process setting in the configuration file.
      * - \-\-qvr-fps=\<n\><br>
      *   Make QVR report frames per second measurements every n milliseconds.
+     *   With multiple processes, the main process also reports the skew of the
+     *   buffer swaps of all processes, measured in synchronized cluster time.
+     * - \-\-qvr-device-sampling-rate=\<hz\><br>
+     *   Update devices in a separate thread with the given rate, independent of
+     *   the frame rate. The samples are delivered to \a QVRApp::deviceSamples()
+     *   once per frame. This applies to devices of the main process that use only
+     *   VRPN or static tracking, buttons, and analogs; other devices are still
+     *   updated once per frame.
+     * - \-\-qvr-frame-pacing=\<policy\><br>
+     *   Choose when the main process starts a new frame: 'free' starts each frame
+     *   as soon as the previous one is done (the default), 'fixed:\<hz\>' starts
+     *   frames at the given rate, and 'vsync' aligns frame starts with the display
+     *   refresh measured from buffer swaps, starting each frame as late as possible
+     *   to minimize latency. Child processes follow the main process.
+     * - \-\-qvr-latency-probe<br>
+     *   Measure the latency from device sampling to buffer swap completion for
+     *   all windows with device-tracked observers, and report a latency histogram
+     *   for each process on exit. This waits for the GPU after each buffer swap.
+     *   Setting the environment variable QVR_LATENCY_PROBE has the same effect.
      * - \-\-qvr-autodetect=\<list\><br>
      *   Comma-separated list of VR hardware that QVR should attempt to detect automatically.
      *   Currently supported keywords are 'all' for all hardware, 'oculus' for Oculus Rift,
@@ -26,12 +26,14 @@
 
 
 QVRObserver::QVRObserver() :
-    _index(-1)
+    _index(-1),
+    _trackingTimestamp(-1)
 {
 }
 
 QVRObserver::QVRObserver(int observerIndex) :
-    _index(observerIndex)
+    _index(observerIndex),
+    _trackingTimestamp(-1)
 {
     setNavigation(config().initialNavigationPosition(), config().initialNavigationOrientation());
     setEyeDistance(config().initialEyeDistance());
@@ -65,6 +67,7 @@ void QVRObserver::setTracking(const QVector3D& pos, const QQuaternion& rot)
     _trackingOrientation[QVR_Eye_Center] = rot;
     _trackingOrientation[QVR_Eye_Left] = rot;
     _trackingOrientation[QVR_Eye_Right] = rot;
+    _trackingTimestamp = -1;
 }
 
 void QVRObserver::setTracking(const QVector3D& posLeft, const QQuaternion& rotLeft, const QVector3D& posRight, const QQuaternion& rotRight)
@@ -76,13 +79,15 @@ void QVRObserver::setTracking(const QVector3D& posLeft, const QQuaternion& rotLe
     _trackingOrientation[QVR_Eye_Center] = QQuaternion::slerp(rotLeft, rotRight, 0.5f);
     _trackingOrientation[QVR_Eye_Left] = rotLeft;
     _trackingOrientation[QVR_Eye_Right] = rotRight;
+    _trackingTimestamp = -1;
 }
 
 QDataStream &operator<<(QDataStream& ds, const QVRObserver& o)
 {
     ds << o._index << o._navigationPosition << o._navigationOrientation
         << o._trackingPosition[0] << o._trackingPosition[1] << o._trackingPosition[2]
-        << o._trackingOrientation[0] << o._trackingOrientation[1] << o._trackingOrientation[2];
+        << o._trackingOrientation[0] << o._trackingOrientation[1] << o._trackingOrientation[2]
+        << o._trackingTimestamp;
     return ds;
 }
 
@@ -90,6 +95,7 @@ QDataStream &operator>>(QDataStream& ds, QVRObserver& o)
 {
     ds >> o._index >> o._navigationPosition >> o._navigationOrientation
         >> o._trackingPosition[0] >> o._trackingPosition[1] >> o._trackingPosition[2]
-        >> o._trackingOrientation[0] >> o._trackingOrientation[1] >> o._trackingOrientation[2];
+        >> o._trackingOrientation[0] >> o._trackingOrientation[1] >> o._trackingOrientation[2]
+        >> o._trackingTimestamp;
     return ds;
 }
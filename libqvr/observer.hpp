@@ -69,9 +69,11 @@ private:
     float _eyeDistance;
     QVector3D _trackingPosition[3];
     QQuaternion _trackingOrientation[3];
+    qint64 _trackingTimestamp;
 
     friend QDataStream &operator<<(QDataStream& ds, const QVRObserver& o);
     friend QDataStream &operator>>(QDataStream& ds, QVRObserver& o);
+    friend class QVRManager;
 
 public:
     /*! \brief Constructor. */
@@ -127,6 +129,14 @@ public:
         return _trackingOrientation[eye];
     }
 
+    /*! \brief Returns the time at which the device state that the current tracking
+     * is based on was sampled, in nanoseconds of the QVR timer of the main process.
+     * This is -1 if the tracking is not based on devices. */
+    qint64 trackingTimestamp() const
+    {
+        return _trackingTimestamp;
+    }
+
     /*! \brief Returns the tracking position and orientation of \a eye as a matrix. */
     QMatrix4x4 trackingMatrix(QVREye eye = QVR_Eye_Center) const
     {
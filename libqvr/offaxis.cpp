@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "offaxis.hpp"
+
+
+QVROffAxisSolver::QVROffAxisSolver() : _size(0), _capacity(0)
+{
+}
+
+int QVROffAxisSolver::addView(const QVector3D& wallBottomLeft, const QVector3D& wallBottomRight,
+        const QVector3D& wallTopLeft, const QVector3D& eyePosition)
+{
+    if (_size == _capacity) {
+        _capacity = qMax(16, 2 * _capacity);
+        for (int a = 0; a < ArrayCount; a++)
+            _arrays[a].resize(_capacity);
+    }
+    int i = _size++;
+    _arrays[BlX][i] = wallBottomLeft.x();
+    _arrays[BlY][i] = wallBottomLeft.y();
+    _arrays[BlZ][i] = wallBottomLeft.z();
+    _arrays[BrX][i] = wallBottomRight.x();
+    _arrays[BrY][i] = wallBottomRight.y();
+    _arrays[BrZ][i] = wallBottomRight.z();
+    _arrays[TlX][i] = wallTopLeft.x();
+    _arrays[TlY][i] = wallTopLeft.y();
+    _arrays[TlZ][i] = wallTopLeft.z();
+    _arrays[EyeX][i] = eyePosition.x();
+    _arrays[EyeY][i] = eyePosition.y();
+    _arrays[EyeZ][i] = eyePosition.z();
+    return i;
+}
+
+/* The solver loop. This is a separate function so that the arrays can be
+ * passed as __restrict parameters; GCC does not take __restrict on local
+ * pointer variables into account when it vectorizes a loop. */
+static void QVRSolveOffAxisViews(int begin, int end,
+        const float* __restrict blX, const float* __restrict blY, const float* __restrict blZ,
+        const float* __restrict brX, const float* __restrict brY, const float* __restrict brZ,
+        const float* __restrict tlX, const float* __restrict tlY, const float* __restrict tlZ,
+        const float* __restrict eyeX, const float* __restrict eyeY, const float* __restrict eyeZ,
+        float* __restrict l, float* __restrict r, float* __restrict b,
+        float* __restrict t, float* __restrict xx, float* __restrict xy,
+        float* __restrict xz, float* __restrict yx, float* __restrict yy,
+        float* __restrict yz, float* __restrict zx, float* __restrict zy,
+        float* __restrict zz)
+{
+    for (int i = begin; i < end; i++) {
+        // Geometry of the screen wall relative to the eye
+        float bx = blX[i] - eyeX[i];
+        float by = blY[i] - eyeY[i];
+        float bz = blZ[i] - eyeZ[i];
+        float rightX = brX[i] - blX[i];
+        float rightY = brY[i] - blY[i];
+        float rightZ = brZ[i] - blZ[i];
+        float upX = tlX[i] - blX[i];
+        float upY = tlY[i] - blY[i];
+        float upZ = tlZ[i] - blZ[i];
+        float width = std::sqrt(rightX * rightX + rightY * rightY + rightZ * rightZ);
+        float height = std::sqrt(upX * upX + upY * upY + upZ * upZ);
+        rightX /= width;
+        rightY /= width;
+        rightZ /= width;
+        upX /= height;
+        upY /= height;
+        upZ /= height;
+        // Normal of the screen plane (up x right) and distance from the eye
+        float nX = upY * rightZ - upZ * rightY;
+        float nY = upZ * rightX - upX * rightZ;
+        float nZ = upX * rightY - upY * rightX;
+        float planeDistance = nX * bx + nY * by + nZ * bz;
+        // Frustum at unit distance
+        float q = 1.0f / planeDistance;
+        float left = rightX * bx + rightY * by + rightZ * bz;
+        float bottom = upX * bx + upY * by + upZ * bz;
+        l[i] = left * q;
+        r[i] = (left + width) * q;
+        b[i] = bottom * q;
+        t[i] = (bottom + height) * q;
+        // View rotation: the z axis points from the screen plane to the eye,
+        // the x axis is perpendicular to it and the up direction of the wall.
+        float pX = -planeDistance * nX;
+        float pY = -planeDistance * nY;
+        float pZ = -planeDistance * nZ;
+        float pLength = std::sqrt(pX * pX + pY * pY + pZ * pZ);
+        float axisZX = pX / pLength;
+        float axisZY = pY / pLength;
+        float axisZZ = pZ / pLength;
+        float axisXX = upY * axisZZ - upZ * axisZY;
+        float axisXY = upZ * axisZX - upX * axisZZ;
+        float axisXZ = upX * axisZY - upY * axisZX;
+        float xLength = std::sqrt(axisXX * axisXX + axisXY * axisXY + axisXZ * axisXZ);
+        axisXX /= xLength;
+        axisXY /= xLength;
+        axisXZ /= xLength;
+        xx[i] = axisXX;
+        xy[i] = axisXY;
+        xz[i] = axisXZ;
+        yx[i] = axisZY * axisXZ - axisZZ * axisXY;
+        yy[i] = axisZZ * axisXX - axisZX * axisXZ;
+        yz[i] = axisZX * axisXY - axisZY * axisXX;
+        zx[i] = axisZX;
+        zy[i] = axisZY;
+        zz[i] = axisZZ;
+    }
+}
+
+bool QVROffAxisSolver::updateView(int view, const QVector3D& wallBottomLeft, const QVector3D& wallBottomRight,
+        const QVector3D& wallTopLeft, const QVector3D& eyePosition)
+{
+    Q_ASSERT(view >= 0 && view < _size);
+    const float input[] = {
+        wallBottomLeft.x(), wallBottomLeft.y(), wallBottomLeft.z(),
+        wallBottomRight.x(), wallBottomRight.y(), wallBottomRight.z(),
+        wallTopLeft.x(), wallTopLeft.y(), wallTopLeft.z(),
+        eyePosition.x(), eyePosition.y(), eyePosition.z()
+    };
+    bool changed = false;
+    for (int a = BlX; a <= EyeZ; a++) {
+        if (_arrays[a][view] != input[a - BlX]) {
+            _arrays[a][view] = input[a - BlX];
+            changed = true;
+        }
+    }
+    if (changed)
+        solve(view, view + 1);
+    return changed;
+}
+
+void QVROffAxisSolver::solve()
+{
+    solve(0, _size);
+}
+
+void QVROffAxisSolver::solve(int begin, int end)
+{
+    QVRSolveOffAxisViews(begin, end,
+            _arrays[BlX].constData(), _arrays[BlY].constData(), _arrays[BlZ].constData(),
+            _arrays[BrX].constData(), _arrays[BrY].constData(), _arrays[BrZ].constData(),
+            _arrays[TlX].constData(), _arrays[TlY].constData(), _arrays[TlZ].constData(),
+            _arrays[EyeX].constData(), _arrays[EyeY].constData(), _arrays[EyeZ].constData(),
+            _arrays[L].data(), _arrays[R].data(), _arrays[B].data(),
+            _arrays[T].data(), _arrays[XX].data(), _arrays[XY].data(),
+            _arrays[XZ].data(), _arrays[YX].data(), _arrays[YY].data(),
+            _arrays[YZ].data(), _arrays[ZX].data(), _arrays[ZY].data(),
+            _arrays[ZZ].data());
+}
+
+QVRFrustum QVROffAxisSolver::frustum(int view, float n, float f) const
+{
+    Q_ASSERT(view >= 0 && view < _size);
+    return QVRFrustum(_arrays[L][view] * n, _arrays[R][view] * n,
+            _arrays[B][view] * n, _arrays[T][view] * n, n, f);
+}
+
+QMatrix4x4 QVROffAxisSolver::viewRotation(int view) const
+{
+    Q_ASSERT(view >= 0 && view < _size);
+    return QMatrix4x4(
+            _arrays[XX][view], _arrays[XY][view], _arrays[XZ][view], 0.0f,
+            _arrays[YX][view], _arrays[YY][view], _arrays[YZ][view], 0.0f,
+            _arrays[ZX][view], _arrays[ZY][view], _arrays[ZZ][view], 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+QMatrix4x4 QVROffAxisSolver::viewMatrixPure(int view) const
+{
+    Q_ASSERT(view >= 0 && view < _size);
+    float ex = _arrays[EyeX][view];
+    float ey = _arrays[EyeY][view];
+    float ez = _arrays[EyeZ][view];
+    float xx = _arrays[XX][view], xy = _arrays[XY][view], xz = _arrays[XZ][view];
+    float yx = _arrays[YX][view], yy = _arrays[YY][view], yz = _arrays[YZ][view];
+    float zx = _arrays[ZX][view], zy = _arrays[ZY][view], zz = _arrays[ZZ][view];
+    return QMatrix4x4(
+            xx, xy, xz, -(xx * ex + xy * ey + xz * ez),
+            yx, yy, yz, -(yx * ex + yy * ey + yz * ez),
+            zx, zy, zz, -(zx * ex + zy * ey + zz * ez),
+            0.0f, 0.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_OFFAXIS_HPP
+#define QVR_OFFAXIS_HPP
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+
+#include "frustum.hpp"
+
+/* Batched computation of off-axis projections for screen walls.
+ *
+ * Each view is given by the three corners of a screen wall and an eye
+ * position. For each view, the solver computes the frustum at unit distance
+ * and the rotation from tracking space into eye space; this is the same as
+ * what QVRWindow previously did with QVector3D and QQuaternion::fromDirection()
+ * for one view at a time.
+ *
+ * The views of all windows of a process are collected first and then solved
+ * together in one pass over a structure of arrays. The arrays are accessed
+ * through __restrict pointers and libqvr is built with -fno-math-errno on
+ * GCC and Clang, which allows these compilers to vectorize the loop,
+ * including its square roots (check with -fopt-info-vec or
+ * -Rpass=loop-vectorize).
+ *
+ * If the input of a single view changes after solve(), e.g. because the
+ * application moved the observer in QVRApp::preRenderWindow(), updateView()
+ * solves this view again.
+ *
+ * This is only used internally. */
+class QVROffAxisSolver
+{
+private:
+    enum {
+        // input
+        BlX, BlY, BlZ, BrX, BrY, BrZ, TlX, TlY, TlZ, EyeX, EyeY, EyeZ,
+        // output: frustum at unit distance
+        L, R, B, T,
+        // output: rows of the rotation from tracking space into eye space
+        XX, XY, XZ, YX, YY, YZ, ZX, ZY, ZZ,
+        ArrayCount
+    };
+    int _size;
+    int _capacity;
+    QVector<float> _arrays[ArrayCount];
+
+    void solve(int begin, int end);
+
+public:
+    QVROffAxisSolver();
+
+    /* Remove all views, but keep the allocated memory */
+    void clear() { _size = 0; }
+    /* Add a view and return its index */
+    int addView(const QVector3D& wallBottomLeft, const QVector3D& wallBottomRight,
+            const QVector3D& wallTopLeft, const QVector3D& eyePosition);
+    /* Solve all views */
+    void solve();
+    /* Set new input for a view that was already solved, and solve it again
+     * if anything changed. Returns whether anything changed. */
+    bool updateView(int view, const QVector3D& wallBottomLeft, const QVector3D& wallBottomRight,
+            const QVector3D& wallTopLeft, const QVector3D& eyePosition);
+
+    /* Get the results for a view after solve() */
+    QVRFrustum frustum(int view, float n, float f) const;
+    QMatrix4x4 viewRotation(int view) const;   // rotation from tracking space into eye space
+    QMatrix4x4 viewMatrixPure(int view) const; // view rotation and eye translation
+};
+
+#endif
@@ -32,9 +32,17 @@
 #include "event.hpp"
 #include "logging.hpp"
 #include "ipc.hpp"
+#include "internalglobals.hpp"
 
 
-QVRProcess::QVRProcess(int index) : _index(index)
+QVRProcess::QVRProcess(int index) :
+    _index(index),
+    _launchNsecs(-1),
+    _startedNsecs(-1),
+    _connectedNsecs(-1),
+    _initNsecs(-1),
+    _relaunchCount(0),
+    _relaunchPending(false)
 {
     setProcessChannelMode(QProcess::ForwardedErrorChannel);
 }
@@ -70,25 +78,52 @@ const QVRWindowConfig& QVRProcess::windowConfig(int windowIndex) const
 
 bool QVRProcess::launch(const QString& prg, const QStringList& args)
 {
+    _launchNsecs = QVRTimer.nsecsElapsed();
     if (config().launcher() == "manual") {
         QString s = args.join(' ');
         QVR_FATAL("start process %s manually with the following options:", qPrintable(id()));
         QVR_FATAL("%s", qPrintable(s));
     } else {
         start(prg, args, QIODevice::ReadWrite);
+    }
+    return true;
+}
+
+bool QVRProcess::waitForLaunch()
+{
+    if (config().launcher() != "manual") {
         if (!waitForStarted(QVRTimeoutMsecs)) {
             QVR_FATAL("failed to launch process %s", qPrintable(id()));
             return false;
         }
+        _startedNsecs = QVRTimer.nsecsElapsed();
     }
     return true;
 }
 
+static QString QVRStartupTime(qint64 nsecs)
+{
+    return (nsecs < 0 ? QString("-") : QString("%1 ms").arg(nsecs / 1e6, 0, 'f', 1));
+}
+
+void QVRProcess::logStartupTimeline(qint64 firstFrameNsecs) const
+{
+    QVR_INFO("startup timeline of process %s (index %d): launch %s, started %s, connected %s, init %s, first frame %s",
+            qPrintable(id()), index(),
+            qPrintable(QVRStartupTime(_launchNsecs)),
+            qPrintable(QVRStartupTime(_startedNsecs)),
+            qPrintable(QVRStartupTime(_connectedNsecs)),
+            qPrintable(QVRStartupTime(_initNsecs)),
+            qPrintable(QVRStartupTime(firstFrameNsecs)));
+}
+
 bool QVRProcess::exit()
 {
     if (config().launcher() == "manual") {
         // The process should have exited cleanly because it received a 'quit' command.
         // We have no means of checking this or killing a misbehaving process.
+    } else if (state() == QProcess::NotRunning) {
+        // The process already finished, e.g. because it died.
     } else {
         QVR_DEBUG("waiting for process %d to finish... ", index());
         if (!waitForFinished(QVRTimeoutMsecs)) {
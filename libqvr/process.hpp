@@ -51,10 +51,20 @@ class QVRProcess : public QProcess
 {
 private:
     int _index;
+    // Startup timeline, in QVRTimer nanoseconds, or -1 if not reached (yet)
+    qint64 _launchNsecs;    // main: launch was issued
+    qint64 _startedNsecs;   // main: launch finished
+    qint64 _connectedNsecs; // main: child completed handshake; child: connected to main
+    qint64 _initNsecs;      // main: init command was sent; child: init command was received
+    int _relaunchCount;     // main: how often this child was relaunched after it died
+    bool _relaunchPending;  // main: this child was killed and is relaunched once it finished
 
     // functions for the main to manage child processes
-    bool launch(const QString& prg, const QStringList& args);
+    bool launch(const QString& prg, const QStringList& args); // does not wait for the process to start
+    bool waitForLaunch();
     bool exit();
+    // log the startup timeline up to the first frame
+    void logStartupTimeline(qint64 firstFrameNsecs) const;
 
     /*! \cond
      * This is internal information. */
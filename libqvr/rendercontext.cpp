@@ -45,7 +45,8 @@ QVRRenderContext::QVRRenderContext() :
     _viewMatrix { QMatrix4x4(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f),
                   QMatrix4x4(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) },
     _viewMatrixPure { QMatrix4x4(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f),
-                  QMatrix4x4(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) }
+                  QMatrix4x4(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) },
+    _trackingTimestamp(-1)
 {
 }
 
@@ -86,7 +87,8 @@ QDataStream &operator<<(QDataStream& ds, const QVRRenderContext& rc)
         << rc._navigationPosition << rc._navigationOrientation
         << rc._screenWall[0] << rc._screenWall[1] << rc._screenWall[2]
         << static_cast<int>(rc._outputMode)
-        << rc._viewCount;
+        << rc._viewCount
+        << rc._trackingTimestamp;
     for (int i = 0; i < rc._viewCount; i++) {
         ds << static_cast<int>(rc._eye[i])
             << rc._textureSize[i]
@@ -107,7 +109,8 @@ QDataStream &operator>>(QDataStream& ds, QVRRenderContext& rc)
         >> rc._navigationPosition >> rc._navigationOrientation
         >> rc._screenWall[0] >> rc._screenWall[1] >> rc._screenWall[2]
         >> om
-        >> rc._viewCount;
+        >> rc._viewCount
+        >> rc._trackingTimestamp;
     rc._outputMode = static_cast<QVROutputMode>(om);
     for (int i = 0; i < rc._viewCount; i++) {
         int e;
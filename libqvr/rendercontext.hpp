@@ -33,6 +33,7 @@
 #include "frustum.hpp"
 
 class QDataStream;
+struct QVRRenderContextWireData;
 
 /*!
  * \brief Context for rendering a frame.
@@ -71,10 +72,14 @@ private:
     QVRFrustum _frustum[2];
     QMatrix4x4 _viewMatrix[2];
     QMatrix4x4 _viewMatrixPure[2];
+    qint64 _trackingTimestamp;
 
     friend QDataStream &operator<<(QDataStream& ds, const QVRRenderContext& rc);
     friend QDataStream &operator>>(QDataStream& ds, QVRRenderContext& rc);
 
+    // This is used internally for the compact event encoding for inter-process communication.
+    friend void QVRRenderContextFromWire(const QVRRenderContextWireData& w, QVRRenderContext& rc);
+
     // These functions are used internally by QVRWindow when computing the render context information.
     friend class QVRWindow;
     void setProcessIndex(int pi) { _processIndex = pi; }
@@ -90,6 +95,7 @@ private:
     void setFrustum(int vp, const QVRFrustum f) { _frustum[vp] = f; }
     void setViewMatrix(int vp, const QMatrix4x4& vm) { _viewMatrix[vp] = vm; }
     void setViewMatrixPure(int vp, const QMatrix4x4& vmp) { _viewMatrixPure[vp] = vmp; }
+    void setTrackingTimestamp(qint64 t) { _trackingTimestamp = t; }
 
 public:
     /*! \brief Constructor. */
@@ -135,6 +141,10 @@ public:
     const QMatrix4x4& viewMatrix(int view) const { Q_ASSERT(view >= 0 && view < viewCount()); return _viewMatrix[view]; }
     /*! \brief Returns the pure view matrix (i.e. in tracking space, without navigation) for rendering \a view. */
     const QMatrix4x4& viewMatrixPure(int view) const { Q_ASSERT(view >= 0 && view < viewCount()); return _viewMatrixPure[view]; }
+    /*! \brief Returns the time at which the device state that the observer tracking is based on was sampled,
+     * in nanoseconds of the QVR timer of the main process, or -1 if the tracking is not based on devices.
+     * See \a QVRObserver::trackingTimestamp(). */
+    qint64 trackingTimestamp() const { return _trackingTimestamp; }
 };
 
 QDataStream &operator<<(QDataStream& ds, const QVRRenderContext& rc);
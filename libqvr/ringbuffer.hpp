@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_RINGBUFFER_HPP
+#define QVR_RINGBUFFER_HPP
+
+#include <QAtomicInt>
+
+/* A fixed-capacity single-producer single-consumer ring buffer.
+ * One thread may push() while another thread pop()s, without locks.
+ * All slots are allocated at construction time, so pushing and popping
+ * never allocate memory (as long as assigning T does not allocate).
+ * This is only used internally. */
+template<typename T> class QVRRingBuffer
+{
+private:
+    T* _slots; // one slot is always kept free to distinguish a full from an empty ring
+    int _slotCount;
+    QAtomicInt _readIndex;
+    QAtomicInt _writeIndex;
+
+    QVRRingBuffer(const QVRRingBuffer&) = delete;
+    QVRRingBuffer& operator=(const QVRRingBuffer&) = delete;
+
+public:
+    QVRRingBuffer(int capacity) :
+        _slots(new T[capacity + 1]),
+        _slotCount(capacity + 1),
+        _readIndex(0),
+        _writeIndex(0)
+    {
+    }
+
+    ~QVRRingBuffer()
+    {
+        delete[] _slots;
+    }
+
+    int capacity() const
+    {
+        return _slotCount - 1;
+    }
+
+    bool isEmpty() const
+    {
+        return _readIndex.loadAcquire() == _writeIndex.loadAcquire();
+    }
+
+    /* To be called from the producer thread only. Returns false if the ring is full. */
+    bool push(const T& value)
+    {
+        int w = _writeIndex.loadAcquire();
+        int next = (w + 1 == _slotCount ? 0 : w + 1);
+        if (next == _readIndex.loadAcquire())
+            return false;
+        _slots[w] = value;
+        _writeIndex.storeRelease(next);
+        return true;
+    }
+
+    /* To be called from the consumer thread only. Returns false if the ring is empty. */
+    bool pop(T* value)
+    {
+        int r = _readIndex.loadAcquire();
+        if (r == _writeIndex.loadAcquire())
+            return false;
+        *value = _slots[r];
+        _readIndex.storeRelease(r + 1 == _slotCount ? 0 : r + 1);
+        return true;
+    }
+};
+
+#endif
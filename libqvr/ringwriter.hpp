@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_RINGWRITER_HPP
+#define QVR_RINGWRITER_HPP
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QByteArray>
+#include <QAtomicInt>
+
+#include "ringbuffer.hpp"
+
+/* The ring of one producer thread of a QVRRingWriter. If the ring is full,
+ * new entries are dropped and counted. */
+template<typename Entry> struct QVRWriterRing
+{
+    QVRRingBuffer<Entry> entries;
+    QAtomicInt dropped;
+    int threadId;          // index of the ring in the order of creation
+    QByteArray threadName; // the object name of the thread, or a generated name
+
+    QVRWriterRing(int capacity) : entries(capacity), dropped(0), threadId(0) {}
+};
+
+/* A writer thread that collects entries from per-thread rings.
+ *
+ * Each thread that pushes entries gets its own single-producer single-consumer
+ * ring, so that producer threads never block on each other or on the output.
+ * The writer thread periodically drains all rings into a sink. The sink is
+ * only used by one thread at a time and must provide the following functions:
+ * - void addThread(const QVRWriterRing<Entry>& ring): called once for each new ring
+ * - void add(const QVRWriterRing<Entry>& ring, const Entry& entry): called for each entry
+ * - void addDropped(const QVRWriterRing<Entry>& ring, int dropped): called if entries were dropped
+ * - void flush(): called at the end of each drain
+ * This is only used internally. */
+template<typename Entry, typename Sink> class QVRRingWriter : public QThread
+{
+public:
+    typedef QVRWriterRing<Entry> Ring;
+
+private:
+    Sink* _sink;
+    const int _ringCapacity;
+    const unsigned long _sleepMsecs;
+    QMutex _ringsMutex; // only protects the list of rings, not the rings themselves
+    QVector<Ring*> _rings;
+    int _announcedRings;
+    QMutex _drainMutex; // makes sure that the rings have only one consumer at a time
+    QAtomicInt _exitWanted;
+    // The rings belong to the writer; this is only a shortcut for the current thread.
+    // The generation invalidates the shortcut when a new writer is created.
+    const int _generation;
+    static QAtomicInt _lastGeneration;
+    static thread_local Ring* _thisThreadRing;
+    static thread_local int _thisThreadRingGeneration;
+
+    Ring* addRing()
+    {
+        Ring* ring = new Ring(_ringCapacity);
+        ring->threadName = QThread::currentThread()->objectName().toUtf8();
+        _ringsMutex.lock();
+        ring->threadId = _rings.size();
+        if (ring->threadName.isEmpty())
+            ring->threadName = (ring->threadId == 0 ? "main" : QByteArray("thread ") + QByteArray::number(ring->threadId));
+        _rings.append(ring);
+        _ringsMutex.unlock();
+        return ring;
+    }
+
+protected:
+    void run() override
+    {
+        for (;;) {
+            bool exitWanted = _exitWanted.loadAcquire();
+            drain();
+            if (exitWanted)
+                break;
+            QThread::msleep(_sleepMsecs);
+        }
+    }
+
+public:
+    /* The writer takes ownership of the sink. */
+    QVRRingWriter(Sink* sink, int ringCapacity, unsigned long sleepMsecs) :
+        _sink(sink),
+        _ringCapacity(ringCapacity),
+        _sleepMsecs(sleepMsecs),
+        _announcedRings(0),
+        _exitWanted(0),
+        _generation(_lastGeneration.fetchAndAddOrdered(1) + 1)
+    {
+    }
+
+    ~QVRRingWriter()
+    {
+        for (int i = 0; i < _rings.size(); i++)
+            delete _rings[i];
+        delete _sink;
+    }
+
+    /* Return the ring of the calling thread; it is created on first use. */
+    Ring* thisThreadRing()
+    {
+        if (!_thisThreadRing || _thisThreadRingGeneration != _generation) {
+            _thisThreadRing = addRing();
+            _thisThreadRingGeneration = _generation;
+        }
+        return _thisThreadRing;
+    }
+
+    /* Push an entry into the ring of the calling thread. */
+    void push(const Entry& entry)
+    {
+        Ring* ring = thisThreadRing();
+        if (!ring->entries.push(entry))
+            ring->dropped.fetchAndAddRelaxed(1);
+    }
+
+    /* Move all entries from the rings to the sink. This is done by the
+     * writer thread, but may be called from any thread. */
+    void drain()
+    {
+        QMutexLocker drainLocker(&_drainMutex);
+        _ringsMutex.lock();
+        for (; _announcedRings < _rings.size(); _announcedRings++)
+            _sink->addThread(*(_rings[_announcedRings]));
+        Entry entry;
+        for (int i = 0; i < _rings.size(); i++) {
+            Ring* ring = _rings[i];
+            while (ring->entries.pop(&entry))
+                _sink->add(*ring, entry);
+            int dropped = ring->dropped.fetchAndStoreRelaxed(0);
+            if (dropped > 0)
+                _sink->addDropped(*ring, dropped);
+        }
+        _ringsMutex.unlock();
+        _sink->flush();
+    }
+
+    /* Drain the rings one last time and stop the writer thread. */
+    void stop()
+    {
+        _exitWanted.storeRelease(1);
+        wait();
+    }
+};
+
+template<typename Entry, typename Sink>
+QAtomicInt QVRRingWriter<Entry, Sink>::_lastGeneration(0);
+template<typename Entry, typename Sink>
+thread_local typename QVRRingWriter<Entry, Sink>::Ring* QVRRingWriter<Entry, Sink>::_thisThreadRing = NULL;
+template<typename Entry, typename Sink>
+thread_local int QVRRingWriter<Entry, Sink>::_thisThreadRingGeneration = 0;
+
+#endif
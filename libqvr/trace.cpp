@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+
+#include "trace.hpp"
+#include "internalglobals.hpp"
+#include "logging.hpp"
+#include "ringwriter.hpp"
+
+/* Each thread that traces gets its own ring of events in a QVRRingWriter, so
+ * that tracing threads never block. The writer thread collects the events
+ * from all rings and appends them to the trace file.
+ * If a ring is full, events are dropped and counted; this can lead to
+ * unbalanced spans in the trace, but never stalls the traced threads. */
+
+static const int QVRTraceRingCapacity = 4096;
+static const int QVRTraceWriterSleepMsecs = 10;
+
+struct QVRTraceEntry
+{
+    qint64 timestamp;
+    const char* name;
+    char phase;
+};
+
+class QVRTraceSink
+{
+private:
+    FILE* _file;
+    int _processIndex;
+
+public:
+    QVRTraceSink(FILE* file, int processIndex);
+    ~QVRTraceSink();
+
+    void addThread(const QVRWriterRing<QVRTraceEntry>& ring);
+    void add(const QVRWriterRing<QVRTraceEntry>& ring, const QVRTraceEntry& entry);
+    void addDropped(const QVRWriterRing<QVRTraceEntry>& ring, int dropped);
+    void flush();
+};
+
+typedef QVRRingWriter<QVRTraceEntry, QVRTraceSink> QVRTraceWriter;
+
+static QByteArray QVRTraceFile;
+static QVRTraceWriter* QVRTraceWriterInstance = NULL;
+bool QVRTracing = false;
+
+QVRTraceSink::QVRTraceSink(FILE* file, int processIndex) :
+    _file(file),
+    _processIndex(processIndex)
+{
+    std::fprintf(_file, "[\n");
+    std::fprintf(_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"QVR process %d\"}},\n",
+            _processIndex, _processIndex);
+    std::fprintf(_file, "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}}",
+            _processIndex, _processIndex);
+}
+
+QVRTraceSink::~QVRTraceSink()
+{
+    std::fprintf(_file, "\n]\n");
+    std::fclose(_file);
+}
+
+void QVRTraceSink::addThread(const QVRWriterRing<QVRTraceEntry>& ring)
+{
+    std::fprintf(_file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            _processIndex, ring.threadId, ring.threadName.constData());
+}
+
+void QVRTraceSink::add(const QVRWriterRing<QVRTraceEntry>& ring, const QVRTraceEntry& entry)
+{
+    // Chrome trace timestamps are in microseconds
+    std::fprintf(_file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%lld.%03d}",
+            entry.name, entry.phase, _processIndex, ring.threadId,
+            static_cast<long long>(entry.timestamp / 1000), static_cast<int>(entry.timestamp % 1000));
+}
+
+void QVRTraceSink::addDropped(const QVRWriterRing<QVRTraceEntry>& ring, int dropped)
+{
+    QVR_WARNING("trace: dropped %d events of thread %s", dropped, ring.threadName.constData());
+}
+
+void QVRTraceSink::flush()
+{
+    std::fflush(_file);
+}
+
+void QVRSetTraceFile(const char* name)
+{
+    QVRTraceFile.clear();
+    if (name) {
+        QVRTraceFile.append(name);
+        QVRTraceFile.append('\0');
+    }
+}
+
+const char* QVRGetTraceFile()
+{
+    return QVRTraceFile.isEmpty() ? NULL : QVRTraceFile.data();
+}
+
+bool QVRStartTrace(int processIndex)
+{
+    if (QVRTraceFile.isEmpty() || QVRTraceWriterInstance)
+        return true;
+    QByteArray fileName = QByteArray(QVRTraceFile.constData()) + '.' + QByteArray::number(processIndex);
+    FILE* file = std::fopen(fileName.constData(), "w");
+    if (!file) {
+        QVR_FATAL("cannot open trace file %s", fileName.constData());
+        return false;
+    }
+    QVRTraceWriterInstance = new QVRTraceWriter(new QVRTraceSink(file, processIndex),
+            QVRTraceRingCapacity, QVRTraceWriterSleepMsecs);
+    QVRTraceWriterInstance->start();
+    QVRTracing = true;
+    // make sure that the calling thread gets the thread id 0
+    QVRTraceWriterInstance->thisThreadRing();
+    return true;
+}
+
+void QVRStopTrace()
+{
+    if (!QVRTraceWriterInstance)
+        return;
+    QVRTracing = false;
+    QVRTraceWriterInstance->stop();
+    delete QVRTraceWriterInstance;
+    QVRTraceWriterInstance = NULL;
+}
+
+void QVRTraceEvent(char phase, const char* name)
+{
+    QVRTraceEntry entry;
+    entry.timestamp = QVRClusterTime();
+    entry.name = name;
+    entry.phase = phase;
+    QVRTraceWriterInstance->push(entry);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QVR_TRACE_HPP
+#define QVR_TRACE_HPP
+
+/* Tracing of begin/end spans in the Chrome trace event format, for viewing
+ * in chrome://tracing or Perfetto.
+ *
+ * Each process writes its own trace file: <name>.<processindex>. Each event
+ * carries the process index, a thread id, and a timestamp in cluster time
+ * (see clocksync.hpp), so that the files of all processes can be merged into one
+ * timeline with qvr-trace-merge.
+ *
+ * Span names must be string literals (only the pointer is recorded).
+ * This is only used internally. */
+
+void QVRSetTraceFile(const char* name); /* NULL means no tracing */
+const char* QVRGetTraceFile(); /* NULL means no tracing */
+
+/* Start and stop tracing. Starting requires QVRTimer to be started, and does
+ * nothing if no trace file was set. Stopping writes all pending events; it must
+ * only be called when no other threads trace anymore. */
+bool QVRStartTrace(int processIndex);
+void QVRStopTrace();
+
+extern bool QVRTracing;
+void QVRTraceEvent(char phase, const char* name);
+
+inline void QVRTraceBegin(const char* name)
+{
+    if (QVRTracing)
+        QVRTraceEvent('B', name);
+}
+
+inline void QVRTraceEnd(const char* name)
+{
+    if (QVRTracing)
+        QVRTraceEvent('E', name);
+}
+
+/* A span that lasts until the end of the current scope */
+class QVRTraceScope
+{
+private:
+    const char* _name;
+
+public:
+    QVRTraceScope(const char* name) : _name(name) { QVRTraceBegin(_name); }
+    ~QVRTraceScope() { QVRTraceEnd(_name); }
+};
+
+#define QVR_TRACE_CONCAT2(a, b) a ## b
+#define QVR_TRACE_CONCAT(a, b) QVR_TRACE_CONCAT2(a, b)
+#define QVR_TRACE_SCOPE(name) QVRTraceScope QVR_TRACE_CONCAT(qvrTraceScope, __LINE__)(name)
+
+#endif
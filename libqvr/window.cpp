@@ -43,6 +43,9 @@
 #include "logging.hpp"
 #include "observer.hpp"
 #include "internalglobals.hpp"
+#include "latency.hpp"
+#include "offaxis.hpp"
+#include "trace.hpp"
 
 #ifdef HAVE_OCULUS
 # include <OVR_CAPI_GL.h>
@@ -87,7 +90,9 @@ void QVRWindowThread::run()
         _window->winContext()->makeCurrent(_window);
         // Start rendering
         renderingMutex.lock();
+        qint64 trackingTimestamp = _window->_renderContext.trackingTimestamp();
         if (!exitWanted) {
+            QVR_TRACE_SCOPE("render output");
             _window->renderOutput();
         }
         renderingMutex.unlock();
@@ -97,6 +102,7 @@ void QVRWindowThread::run()
         // Swap buffers
         swapbuffersMutex.lock();
         if (!exitWanted) {
+            QVR_TRACE_SCOPE("swap buffers");
             if (_window->config().outputMode() == QVR_Output_Oculus) {
 #ifdef HAVE_OCULUS
 # if (OVR_PRODUCT_VERSION >= 1)
@@ -125,6 +131,12 @@ void QVRWindowThread::run()
                 if (_window->isExposed())
                     _window->winContext()->swapBuffers(_window);
             }
+            if (QVRLatencyProbe && trackingTimestamp >= 0) {
+                // swapBuffers() may return before the GPU is done, so wait for it
+                _window->_gl->glFinish();
+                QVRLatencyProbe->addSample(QVRClusterTime() - trackingTimestamp);
+            }
+            _window->_swapNsecs = QVRClusterTime();
         }
         swapbuffersMutex.unlock();
         swapbuffersFinished = true;
@@ -156,7 +168,10 @@ QVRWindow::QVRWindow(QVRWindow* mainWindow, QVRObserver* observer, int windowInd
     _textureHeights { -1, -1 },
     _outputQuadVao(0),
     _outputPrg(NULL),
-    _renderContext()
+    _renderContext(),
+    _offAxisViews { -1, -1 },
+    _screenWallIsValid(false),
+    _swapNsecs(-1)
 {
     setSurfaceType(OpenGLSurface);
     create();
@@ -230,6 +245,14 @@ QVRWindow::QVRWindow(QVRWindow* mainWindow, QVRObserver* observer, int windowInd
             setTitle(config().id());
         }
         setMinimumSize(QSize(64, 64));
+        // The screen wall depends on the window geometry and screen, so
+        // recompute it only when one of these changes.
+        auto invalidateScreenWall = [this]() { _screenWallIsValid = false; };
+        connect(this, &QWindow::xChanged, this, invalidateScreenWall);
+        connect(this, &QWindow::yChanged, this, invalidateScreenWall);
+        connect(this, &QWindow::widthChanged, this, invalidateScreenWall);
+        connect(this, &QWindow::heightChanged, this, invalidateScreenWall);
+        connect(this, &QWindow::screenChanged, this, invalidateScreenWall);
         _screen = config().initialDisplayScreen();
         if (_screen < 0)
             _screen = QVRPrimaryScreen;
@@ -316,6 +339,7 @@ QVRWindow::QVRWindow(QVRWindow* mainWindow, QVRObserver* observer, int windowInd
 #endif
         } else {
             _thread = new QVRWindowThread(this);
+            _thread->setObjectName(QString("window %1").arg(id()));
             _winContext->doneCurrent();
             _winContext->moveToThread(_thread);
             _thread->renderingMutex.lock();
@@ -571,14 +595,13 @@ void QVRWindow::exitGL()
     }
 }
 
-void QVRWindow::screenWall(QVector3D& cornerBottomLeft, QVector3D& cornerBottomRight, QVector3D& cornerTopLeft)
+void QVRWindow::updateScreenWallCache()
 {
     Q_ASSERT(!isMain());
-    Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
-    Q_ASSERT(QOpenGLContext::currentContext() != _winContext);
     Q_ASSERT(config().outputMode() != QVR_Output_Oculus);
     Q_ASSERT(_screen >= 0);
 
+    QVector3D cornerBottomLeft, cornerBottomRight, cornerTopLeft;
     if (config().screenIsGivenByCenter()) {
         // Get geometry (in meter) of the screen
         QRect displayGeom = QVRScreenGeometries[_screen];
@@ -619,15 +642,82 @@ void QVRWindow::screenWall(QVector3D& cornerBottomLeft, QVector3D& cornerBottomR
         cornerBottomRight = config().screenCornerBottomRight();
         cornerTopLeft = config().screenCornerTopLeft();
     }
+    _screenWallCache[0] = cornerBottomLeft;
+    _screenWallCache[1] = cornerBottomRight;
+    _screenWallCache[2] = cornerTopLeft;
+    _screenWallIsValid = true;
+}
+
+void QVRWindow::screenWall(QVector3D& cornerBottomLeft, QVector3D& cornerBottomRight, QVector3D& cornerTopLeft)
+{
+    Q_ASSERT(!isMain());
+    Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
+    Q_ASSERT(QOpenGLContext::currentContext() != _winContext);
+
+    if (!_screenWallIsValid)
+        updateScreenWallCache();
     if (config().screenIsFixedToObserver()) {
         QMatrix4x4 o = _observer->trackingMatrix();
-        cornerBottomLeft = o * cornerBottomLeft;
-        cornerBottomRight = o * cornerBottomRight;
-        cornerTopLeft = o * cornerTopLeft;
+        cornerBottomLeft = o * _screenWallCache[0];
+        cornerBottomRight = o * _screenWallCache[1];
+        cornerTopLeft = o * _screenWallCache[2];
+    } else {
+        cornerBottomLeft = _screenWallCache[0];
+        cornerBottomRight = _screenWallCache[1];
+        cornerTopLeft = _screenWallCache[2];
     }
 }
 
-const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f, unsigned int textures[2])
+void QVRWindow::setViewMatrices(int view, const QVector3D& viewPos, const QQuaternion& viewRot)
+{
+    QMatrix4x4 viewRotation;
+    viewRotation.rotate(viewRot.inverted());
+    QMatrix4x4 viewMatrixPure = viewRotation;
+    viewMatrixPure.translate(-viewPos);
+    setViewMatrices(view, viewPos, viewRotation, viewMatrixPure);
+}
+
+void QVRWindow::setViewMatrices(int view, const QVector3D& viewPos,
+        const QMatrix4x4& viewRotation, const QMatrix4x4& viewMatrixPure)
+{
+    _renderContext.setViewMatrixPure(view, viewMatrixPure);
+    QMatrix4x4 viewMatrix;
+    if (config().screenIsFixedToObserver()) {
+        // XXX why is this special case necessary?? the code below should always work!
+        viewMatrix = viewRotation;
+        viewMatrix.rotate(_renderContext.navigationOrientation().inverted());
+        viewMatrix.translate(-viewPos);
+        viewMatrix.translate(-_renderContext.navigationPosition());
+    } else {
+        viewMatrix = viewMatrixPure;
+        viewMatrix.rotate(_renderContext.navigationOrientation().inverted());
+        viewMatrix.translate(-_renderContext.navigationPosition());
+    }
+    _renderContext.setViewMatrix(view, viewMatrix);
+}
+
+void QVRWindow::addOffAxisViews(QVROffAxisSolver* offAxisSolver)
+{
+    Q_ASSERT(!isMain());
+
+    _offAxisViews[0] = -1;
+    _offAxisViews[1] = -1;
+    if (config().outputMode() == QVR_Output_Oculus
+            || config().outputMode() == QVR_Output_OpenVR
+            || config().outputMode() == QVR_Output_GoogleVR) {
+        return;
+    }
+    QVector3D wallBl, wallBr, wallTl;
+    screenWall(wallBl, wallBr, wallTl);
+    _renderContext.setOutputConf(config().outputMode());
+    for (int i = 0; i < _renderContext.viewCount(); i++) {
+        _offAxisViews[i] = offAxisSolver->addView(wallBl, wallBr, wallTl,
+                _observer->trackingPosition(_renderContext.eye(i)));
+    }
+}
+
+const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f,
+        QVROffAxisSolver* offAxisSolver, unsigned int textures[2])
 {
     Q_ASSERT(!isMain());
     Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
@@ -638,6 +728,7 @@ const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f, unsign
     _renderContext.setWindowGeometry(geometry());
     _renderContext.setScreenGeometry(screen()->geometry());
     _renderContext.setNavigation(_observer->navigationPosition(), _observer->navigationOrientation());
+    _renderContext.setTrackingTimestamp(_observer->trackingTimestamp());
     _renderContext.setOutputConf(config().outputMode());
     QVector3D wallBl, wallBr, wallTl;
     if (config().outputMode() != QVR_Output_Oculus
@@ -649,8 +740,6 @@ const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f, unsign
     for (int i = 0; i < _renderContext.viewCount(); i++) {
         QVREye eye = _renderContext.eye(i);
         _renderContext.setTracking(i, _observer->trackingPosition(eye), _observer->trackingOrientation(eye));
-        QVector3D viewPos;
-        QQuaternion viewRot;
         if (config().outputMode() == QVR_Output_Oculus) {
 #ifdef HAVE_OCULUS
             const ovrFovPort& fov = QVROculusEyeRenderDesc[i].Fov;
@@ -661,8 +750,7 @@ const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f, unsign
                         fov.UpTan * n,
                         n, f));
 #endif
-            viewPos = _renderContext.trackingPosition(i);
-            viewRot = _renderContext.trackingOrientation(i);
+            setViewMatrices(i, _renderContext.trackingPosition(i), _renderContext.trackingOrientation(i));
         } else if (config().outputMode() == QVR_Output_OpenVR) {
             float l = 0.0f, r = 0.0f, b = 0.0f, t = 0.0f;
 #ifdef HAVE_OPENVR
@@ -673,61 +761,26 @@ const QVRRenderContext& QVRWindow::computeRenderContext(float n, float f, unsign
             QVRFrustum frustum(l, r, t, b, 1.0f, f);
             frustum.adjustNearPlane(n);
             _renderContext.setFrustum(i, frustum);
-            viewPos = _renderContext.trackingPosition(i);
-            viewRot = _renderContext.trackingOrientation(i);
+            setViewMatrices(i, _renderContext.trackingPosition(i), _renderContext.trackingOrientation(i));
         } else if (config().outputMode() == QVR_Output_GoogleVR) {
 #ifdef ANDROID
             QVRFrustum frustum(QVRGoogleVRlrbt[i][0], QVRGoogleVRlrbt[i][1],
                     QVRGoogleVRlrbt[i][2], QVRGoogleVRlrbt[i][3], 1.0f, f);
             frustum.adjustNearPlane(n);
             _renderContext.setFrustum(i, frustum);
-            viewPos = _renderContext.trackingPosition(i);
-            viewRot = _renderContext.trackingOrientation(i);
 #endif
+            setViewMatrices(i, _renderContext.trackingPosition(i), _renderContext.trackingOrientation(i));
         } else {
-            // Determine the eye position
-            QVector3D eyePosition = _observer->trackingPosition(eye);
-            // Get the geometry of the screen area relative to the eye
-            QVector3D bl = wallBl - eyePosition;
-            QVector3D br = wallBr - eyePosition;
-            QVector3D tl = wallTl - eyePosition;
-            // Compute the HNF of the screen plane
-            QVector3D planeRight = (br - bl).normalized();
-            QVector3D planeUp = (tl - bl).normalized();
-            QVector3D planeNormal = QVector3D::crossProduct(planeUp, planeRight);
-            float planeDistance = QVector3D::dotProduct(planeNormal, bl);
-            // Compute the frustum
-            float width = (br - bl).length();
-            float height = (tl - bl).length();
-            float l = -QVector3D::dotProduct(-bl, planeRight);
-            float r = width + l;
-            float b = -QVector3D::dotProduct(-bl, planeUp);
-            float t = height + b;
-            float q = n / planeDistance;
-            _renderContext.setFrustum(i, QVRFrustum(l * q, r * q, b * q, t * q, n, f));
-            // Compute the view matrix
-            QVector3D eyeProjection = -QVector3D::dotProduct(-bl, planeNormal) * planeNormal;
-            viewPos = eyePosition;
-            viewRot = QQuaternion::fromDirection(-eyeProjection, planeUp);
-        }
-        QMatrix4x4 viewMatrixPure;
-        viewMatrixPure.rotate(viewRot.inverted());
-        viewMatrixPure.translate(-viewPos);
-        _renderContext.setViewMatrixPure(i, viewMatrixPure);
-        QMatrix4x4 viewMatrix;
-        if (config().screenIsFixedToObserver()) {
-            // XXX why is this special case necessary?? the code below should always work!
-            viewMatrix.rotate(viewRot.inverted());
-            viewMatrix.rotate(_renderContext.navigationOrientation().inverted());
-            viewMatrix.translate(-viewPos);
-            viewMatrix.translate(-_renderContext.navigationPosition());
-        } else {
-            viewMatrix.rotate(viewRot.inverted());
-            viewMatrix.translate(-viewPos);
-            viewMatrix.rotate(_renderContext.navigationOrientation().inverted());
-            viewMatrix.translate(-_renderContext.navigationPosition());
+            // The frustum and view rotation follow from the geometry of the
+            // screen wall relative to the eye. They were already solved for
+            // all windows at once; the view is only solved again if the
+            // application changed its input in QVRApp::preRenderWindow().
+            int v = _offAxisViews[i];
+            offAxisSolver->updateView(v, wallBl, wallBr, wallTl, _renderContext.trackingPosition(i));
+            _renderContext.setFrustum(i, offAxisSolver->frustum(v, n, f));
+            setViewMatrices(i, _renderContext.trackingPosition(i),
+                    offAxisSolver->viewRotation(v), offAxisSolver->viewMatrixPure(v));
         }
-        _renderContext.setViewMatrix(i, viewMatrix);
     }
 
     /* Get the textures that the application needs to render into */
@@ -31,6 +31,7 @@
 
 class QVRObserver;
 class QVRWindowThread;
+class QVROffAxisSolver;
 class QOpenGLShaderProgram;
 class QOpenGLContext;
 class QOpenGLExtraFunctions;
@@ -80,20 +81,33 @@ private:
     QOpenGLContext* _winContext;
     QOpenGLExtraFunctions* _gl;
     QVRRenderContext _renderContext;
+    int _offAxisViews[2]; // index of each screen wall view in the off-axis solver, or -1
+    bool _screenWallIsValid;       // whether _screenWallCache is up to date
+    QVector3D _screenWallCache[3]; // screen wall corners, without the observer transformation
+    qint64 _swapNsecs;             // cluster time at which the last buffer swap returned, or -1
 
     bool isMain() const;
+    void updateScreenWallCache();
     void screenWall(QVector3D& cornerBottomLeft, QVector3D& cornerBottomRight, QVector3D& cornerTopLeft);
+    void setViewMatrices(int view, const QVector3D& viewPos, const QQuaternion& viewRot);
+    void setViewMatrices(int view, const QVector3D& viewPos,
+            const QMatrix4x4& viewRotation, const QMatrix4x4& viewMatrixPure);
 
     // to be called from _thread:
     void renderOutput();
 
     // to be called by QVRManager from the main thread:
     bool isValid() const { return _isValid; }
-    const QVRRenderContext& computeRenderContext(float n, float f, unsigned int textures[2]);
+    // First call addOffAxisViews() for all windows and solve the off-axis
+    // projections of all windows together, then call computeRenderContext() for each window.
+    void addOffAxisViews(QVROffAxisSolver* offAxisSolver);
+    const QVRRenderContext& computeRenderContext(float n, float f,
+            QVROffAxisSolver* offAxisSolver, unsigned int textures[2]);
     void exitGL();
     void renderToScreen();
     void asyncSwapBuffers();
     void waitForSwapBuffers();
+    qint64 lastSwapNsecs() const { return _swapNsecs; } // only valid after waitForSwapBuffers()
 
     // to be called from _thread and QVRManager:
     QOpenGLContext* winContext() { return _winContext; }
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Merge the per-process trace files written by QVR applications with
+ * --qvr-trace=<filename> into a single Chrome trace event file, so that
+ * all processes can be viewed on one timeline in chrome://tracing or Perfetto.
+ *
+ * Usage: qvr-trace-merge <output.json> <filename>.0 <filename>.1 ...
+ */
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+
+
+/* A trace file of a process that did not exit cleanly lacks the closing
+ * bracket of the event array; repair that before parsing. */
+static QByteArray repairTrace(QByteArray data)
+{
+    data = data.trimmed();
+    if (!data.endsWith(']')) {
+        while (data.endsWith(',') || data.endsWith('\n'))
+            data.chop(1);
+        data.append("\n]");
+    }
+    return data;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    if (argc < 3) {
+        qCritical("Usage: %s <output.json> <trace-file>...", argv[0]);
+        return 1;
+    }
+
+    QJsonArray events;
+    for (int i = 2; i < argc; i++) {
+        QFile file(argv[i]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical("Cannot open %s", argv[i]);
+            return 1;
+        }
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(repairTrace(file.readAll()), &error);
+        if (doc.isNull() || !doc.isArray()) {
+            qCritical("Cannot parse %s: %s", argv[i], qPrintable(error.errorString()));
+            return 1;
+        }
+        QJsonArray fileEvents = doc.array();
+        for (int j = 0; j < fileEvents.size(); j++)
+            events.append(fileEvents[j]);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", QString("ms"));
+    QFile output(argv[1]);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || output.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) < 0
+            || !output.flush()) {
+        qCritical("Cannot write %s", argv[1]);
+        return 1;
+    }
+    return 0;
+}
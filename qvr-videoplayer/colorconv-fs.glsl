@@ -49,10 +49,13 @@ void main(void)
         vec3 yuv;
         if (shader_input == 1) {
             yuv = texture(yuv_tex0, vtexcoord).rgb;
-        } else {
+        } else if (shader_input == 2) {
             yuv = vec3(texture(yuv_tex0, vtexcoord).r,
                     texture(yuv_tex1, vtexcoord).r,
                     texture(yuv_tex2, vtexcoord).r);
+        } else {
+            yuv = vec3(texture(yuv_tex0, vtexcoord).r,
+                    texture(yuv_tex1, vtexcoord).rg);
         }
         // Convert the MPEG range to the full range for each component, if necessary
         if (yuv_value_range_8bit_mpeg) {
@@ -23,6 +23,8 @@
  */
 
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
 
 #include <QGuiApplication>
 #include <QCommandLineParser>
@@ -33,11 +35,22 @@
 #include <QVideoSurfaceFormat>
 #include <QFileInfo>
 #include <QTemporaryFile>
+#include <QOpenGLContext>
+#include <QAtomicInt>
+#include <QThread>
+#include <QtMath>
 
 #include <qvr/manager.hpp>
 
 #include "qvr-videoplayer.hpp"
 
+#ifndef GL_MAP_PERSISTENT_BIT
+# define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+# define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
 
 /*
  * The VideoFrame class.
@@ -63,11 +76,18 @@ public:
         Layout_Right_Left_Half  // stereoscopic video, left eye right, right eye left, both half width
     };
 
+    enum Eyes {
+        Eye_Left = 1,           // left eye view (also used for the center eye)
+        Eye_Right = 2,          // right eye view
+        Eyes_Both = 3           // both views
+    };
+
     QVideoFrame::PixelFormat pixelFormat;
     QVideoSurfaceFormat::YCbCrColorSpace yCbCrColorSpace;
     QSize size;
     float aspectRatio;
     StereoLayout stereoLayout;
+    qint64 startTime; // presentation time in microseconds, or -1
     QByteArray data;
 
     VideoFrame() :
@@ -76,13 +96,17 @@ public:
         size(-1, -1),
         aspectRatio(0.0f),
         stereoLayout(Layout_Unknown),
-        data()
+        startTime(-1),
+        data(),
+        _mapStereoLayout(Layout_Unknown)
     {
     }
 
     // Map a QVideoFrame to this video frame; see also unmap()
     void map(enum StereoLayout sl, const QVideoSurfaceFormat& format, const QVideoFrame& frame)
     {
+        _mapStereoLayout = sl;
+        _mapFormat = format;
         bool valid = (frame.pixelFormat() != QVideoFrame::Format_Invalid);
         if (valid) {
             // This assignment does not copy the frame data:
@@ -97,6 +121,7 @@ public:
             aspectRatio = static_cast<float>(size.width() * format.pixelAspectRatio().width())
                 / static_cast<float>(size.height() * format.pixelAspectRatio().height());
             stereoLayout = sl;
+            startTime = frame.startTime();
             // This assignment does not copy the frame data:
             data.setRawData(reinterpret_cast<const char*>(_mapFrame.bits()), _mapFrame.mappedBytes());
         } else {
@@ -106,6 +131,7 @@ public:
             size = QSize(1, 1);
             aspectRatio = 1.0f;
             stereoLayout = Layout_Mono;
+            startTime = -1;
             static const char zeroes[4] = { 0, 0, 0, 0 };
             data.setRawData(zeroes, 4);
         }
@@ -118,8 +144,141 @@ public:
             _mapFrame.unmap();
     }
 
+    // Map the current QVideoFrame again, e.g. to undo crop()
+    void remap()
+    {
+        QVideoFrame frame = _mapFrame;
+        unmap();
+        map(_mapStereoLayout, _mapFormat, frame);
+    }
+
+    // Return the stereo layout, guessed from the aspect ratio if it is unknown
+    StereoLayout effectiveStereoLayout() const
+    {
+        if (stereoLayout == Layout_Unknown) {
+            if (aspectRatio > 3.0f)
+                return Layout_Left_Right;
+            else if (aspectRatio < 1.0f)
+                return Layout_Top_Bottom;
+        }
+        return stereoLayout;
+    }
+
+    // Crop a stereoscopic frame to the view of the given eye (a combination
+    // of Eyes values), so that the other view is neither transferred nor
+    // uploaded. The result is a monoscopic frame. Frames that are mono, that
+    // are needed for both eyes, or that have an unsuitable size are unchanged.
+    void crop(int eyes)
+    {
+        if (eyes != Eye_Left && eyes != Eye_Right)
+            return;
+        bool horizontal;     // whether the views are side by side
+        bool firstHalf;      // whether the needed view is in the left or top half
+        bool halfResolution; // whether the views are squeezed to half width or height
+        switch (effectiveStereoLayout()) {
+        case Layout_Unknown:
+        case Layout_Mono:
+            return;
+        case Layout_Top_Bottom:
+        case Layout_Top_Bottom_Half:
+            horizontal = false;
+            firstHalf = (eyes == Eye_Left);
+            halfResolution = (stereoLayout == Layout_Top_Bottom_Half);
+            break;
+        case Layout_Bottom_Top:
+        case Layout_Bottom_Top_Half:
+            horizontal = false;
+            firstHalf = (eyes == Eye_Right);
+            halfResolution = (stereoLayout == Layout_Bottom_Top_Half);
+            break;
+        case Layout_Left_Right:
+        case Layout_Left_Right_Half:
+            horizontal = true;
+            firstHalf = (eyes == Eye_Left);
+            halfResolution = (stereoLayout == Layout_Left_Right_Half);
+            break;
+        case Layout_Right_Left:
+        case Layout_Right_Left_Half:
+            horizontal = true;
+            firstHalf = (eyes == Eye_Right);
+            halfResolution = (stereoLayout == Layout_Right_Left_Half);
+            break;
+        }
+        int bytesPerPixel;
+        bool planar = false;      // Y plane followed by two chroma planes
+        bool semiPlanar = false;  // Y plane followed by an interleaved chroma plane
+        switch (pixelFormat) {
+        case QVideoFrame::Format_RGB565:
+        case QVideoFrame::Format_BGR565:
+            bytesPerPixel = 2;
+            break;
+        case QVideoFrame::Format_RGB24:
+        case QVideoFrame::Format_BGR24:
+        case QVideoFrame::Format_YUV444:
+            bytesPerPixel = 3;
+            break;
+        case QVideoFrame::Format_ARGB32:
+        case QVideoFrame::Format_RGB32:
+        case QVideoFrame::Format_BGRA32:
+        case QVideoFrame::Format_BGR32:
+        case QVideoFrame::Format_AYUV444:
+            bytesPerPixel = 4;
+            break;
+        case QVideoFrame::Format_YUV420P:
+        case QVideoFrame::Format_YV12:
+            bytesPerPixel = 1;
+            planar = true;
+            break;
+        case QVideoFrame::Format_NV12:
+        case QVideoFrame::Format_NV21:
+            bytesPerPixel = 1;
+            semiPlanar = true;
+            break;
+        default:
+            return;
+        }
+        const int w = size.width();
+        const int h = size.height();
+        // The chroma planes of planar formats must be split evenly, too
+        if ((planar || semiPlanar ? (horizontal ? w % 4 : h % 4) : (horizontal ? w % 2 : h % 2)) != 0)
+            return;
+        const int cw = (horizontal ? w / 2 : w);
+        const int ch = (horizontal ? h : h / 2);
+        const int cx = (horizontal && !firstHalf ? cw : 0);
+        const int cy = (!horizontal && !firstHalf ? ch : 0);
+        QByteArray croppedData;
+        croppedData.resize(planar || semiPlanar ? cw * ch + 2 * (cw / 2) * (ch / 2) : cw * ch * bytesPerPixel);
+        char* dst = croppedData.data();
+        const char* src = data.constData();
+        copyRect(dst, src, w * bytesPerPixel, cx * bytesPerPixel, cy, cw * bytesPerPixel, ch);
+        if (planar) {
+            for (int p = 0; p < 2; p++) {
+                copyRect(dst + cw * ch + p * (cw / 2) * (ch / 2),
+                        src + w * h + p * (w / 2) * (h / 2),
+                        w / 2, cx / 2, cy / 2, cw / 2, ch / 2);
+            }
+        } else if (semiPlanar) {
+            copyRect(dst + cw * ch, src + w * h, w, cx, cy / 2, cw, ch / 2);
+        }
+        if (!halfResolution)
+            aspectRatio *= (horizontal ? 0.5f : 2.0f);
+        size = QSize(cw, ch);
+        stereoLayout = Layout_Mono;
+        data = croppedData;
+    }
+
 private:
     QVideoFrame _mapFrame;
+    StereoLayout _mapStereoLayout;
+    QVideoSurfaceFormat _mapFormat;
+
+    // Copy a rectangle of rows; all values are in bytes except y and rows
+    static void copyRect(char* dst, const char* src, int srcStride,
+            int x, int y, int rowSize, int rows)
+    {
+        for (int r = 0; r < rows; r++)
+            std::memcpy(dst + r * rowSize, src + (y + r) * srcStride + x, rowSize);
+    }
 };
 
 QDataStream &operator<<(QDataStream& ds, const VideoFrame& f)
@@ -129,6 +288,7 @@ QDataStream &operator<<(QDataStream& ds, const VideoFrame& f)
     ds << f.size;
     ds << f.aspectRatio;
     ds << static_cast<int>(f.stereoLayout);
+    ds << f.startTime;
     ds << f.data;
     return ds;
 }
@@ -144,19 +304,87 @@ QDataStream &operator>>(QDataStream& ds, VideoFrame& f)
     ds >> f.aspectRatio;
     ds >> tmp;
     f.stereoLayout = static_cast<enum VideoFrame::StereoLayout>(tmp);
+    ds >> f.startTime;
     ds >> f.data;
     return ds;
 }
 
+/*
+ * The FrameQueue class.
+ *
+ * A bounded queue of decoded frames. One thread pushes frames as they are
+ * decoded while another thread takes them out, without locks.
+ */
+
+class FrameQueue
+{
+public:
+    struct Entry {
+        QVideoFrame frame;
+        QVideoSurfaceFormat format;
+    };
+
+private:
+    static const int slotCount = 9; // one slot is kept free to distinguish a full from an empty queue
+    Entry _slots[slotCount];
+    QAtomicInt _readIndex;
+    QAtomicInt _writeIndex;
+
+public:
+    FrameQueue() : _readIndex(0), _writeIndex(0)
+    {
+    }
+
+    // To be called from the producer thread only. Returns false if the queue is full.
+    bool push(const QVideoFrame& frame, const QVideoSurfaceFormat& format)
+    {
+        int w = _writeIndex.loadAcquire();
+        int next = (w + 1) % slotCount;
+        if (next == _readIndex.loadAcquire())
+            return false;
+        _slots[w].frame = frame;
+        _slots[w].format = format;
+        _writeIndex.storeRelease(next);
+        return true;
+    }
+
+    // To be called from the consumer thread only. Returns NULL if the queue is empty.
+    const Entry* head() const
+    {
+        int r = _readIndex.loadAcquire();
+        if (r == _writeIndex.loadAcquire())
+            return NULL;
+        return &(_slots[r]);
+    }
+
+    // To be called from the consumer thread only, after head() returned an entry.
+    // This releases the frame so that the decoder can reuse its buffer.
+    void pop()
+    {
+        int r = _readIndex.loadAcquire();
+        _slots[r] = Entry();
+        _readIndex.storeRelease((r + 1) % slotCount);
+    }
+};
+
 /*
  * The VideoSurface class.
  *
  * This class is used by QMediaPlayer as a video surface, i.e. to output video
  * frames.
- * It specifies the video frame formats we can handle, and maps the incoming
- * QVideoFrame data to our video frame representation.
+ * It specifies the video frame formats we can handle, and queues the incoming
+ * frames. It lives in its own thread so that decoding does not depend on the
+ * render loop.
+ * The render side then selects the queued frame whose start time best matches
+ * the predicted display time, and maps its QVideoFrame data to our video frame
+ * representation. When child processes decode the video themselves, their
+ * display time is the start time of the frame that the main process presents.
  */
 
+// Queued frames that start more than this after the predicted display time
+// are left over from before a seek and are discarded.
+static const qint64 maxFrameLeadUsecs = 2000000;
+
 class VideoSurface : public QAbstractVideoSurface
 {
 private:
@@ -164,11 +392,85 @@ private:
     bool *_frameIsNew;  // flag to set when the target frame represents a new frame
     QVideoSurfaceFormat _format; // format with which playback is started
     enum VideoFrame::StereoLayout _stereoLayout; // stereo layout of current media
+    FrameQueue _queue;  // decoded frames, pushed by present()
+    qint64 _frameEndTime; // end time of the target frame in microseconds, or -1
+    QAtomicInt _droppedFrames;   // decoded frames that were never shown
+    int _duplicatedFrames;       // frames that were shown again after their end time
 
 public:
     VideoSurface(VideoFrame* frame, bool* frameIsNew) :
-        _frame(frame), _frameIsNew(frameIsNew), _stereoLayout(VideoFrame::Layout_Unknown)
+        _frame(frame), _frameIsNew(frameIsNew), _stereoLayout(VideoFrame::Layout_Unknown),
+        _frameEndTime(-1), _droppedFrames(0), _duplicatedFrames(0)
+    {
+    }
+
+    enum VideoFrame::StereoLayout stereoLayout() const
+    {
+        return _stereoLayout;
+    }
+
+    void setStereoLayout(enum VideoFrame::StereoLayout sl)
+    {
+        _stereoLayout = sl;
+    }
+
+    int droppedFrames() const
+    {
+        return _droppedFrames.loadAcquire();
+    }
+
+    int duplicatedFrames() const
+    {
+        return _duplicatedFrames;
+    }
+
+    // Whether a decoded frame is waiting to be selected. To be called from
+    // the consumer thread only.
+    bool hasFrame() const
+    {
+        return _queue.head() != NULL;
+    }
+
+    // Discard all queued frames, e.g. before new media is opened. To be
+    // called from the consumer thread only.
+    void clear()
+    {
+        while (_queue.head())
+            _queue.pop();
+        _frameEndTime = -1;
+    }
+
+    // Select the frame to display at the given time (in microseconds, or -1 if
+    // unknown; then the newest frame is selected). Frames that start at or
+    // before that time replace the current target frame.
+    void selectFrame(qint64 displayTime)
     {
+        FrameQueue::Entry selected;
+        bool haveNewFrame = false;
+        const FrameQueue::Entry* e;
+        while ((e = _queue.head())) {
+            qint64 t = e->frame.startTime();
+            if (displayTime >= 0 && t > displayTime + maxFrameLeadUsecs) {
+                _queue.pop();
+                _droppedFrames.ref();
+                continue;
+            }
+            if (displayTime >= 0 && t > displayTime)
+                break;
+            if (haveNewFrame)
+                _droppedFrames.ref();
+            selected = *e;
+            haveNewFrame = true;
+            _queue.pop();
+        }
+        if (haveNewFrame) {
+            _frame->unmap();
+            _frame->map(_stereoLayout, selected.format, selected.frame);
+            _frameEndTime = selected.frame.endTime();
+            *_frameIsNew = true;
+        } else if (displayTime >= 0 && _frameEndTime >= 0 && _frameEndTime < displayTime) {
+            _duplicatedFrames++;
+        }
     }
 
     virtual QList<QVideoFrame::PixelFormat> supportedPixelFormats(
@@ -188,17 +490,20 @@ public:
         pixelFormats.append(QVideoFrame::Format_YUV444);
         pixelFormats.append(QVideoFrame::Format_AYUV444);
         pixelFormats.append(QVideoFrame::Format_YV12);
+        pixelFormats.append(QVideoFrame::Format_NV12);
+        pixelFormats.append(QVideoFrame::Format_NV21);
         // TODO: we could support more formats with a little bit more effort in
-        // preRenderProcess(), but probably RGB24 and YUV420P are the only
+        // preRenderProcess(), but probably RGB24, YUV420P and NV12 are the only
         // ones that are really relevant.
         return pixelFormats;
     }
 
     virtual bool present(const QVideoFrame &frame)
     {
-        _frame->unmap();
-        _frame->map(_stereoLayout, _format, frame);
-        *_frameIsNew = true;
+        // This assignment does not copy the frame data. If the render side
+        // falls behind, the newest frames are dropped.
+        if (!_queue.push(frame, _format))
+            _droppedFrames.ref();
         return true;
     }
 
@@ -250,39 +555,111 @@ public:
 
 static bool isGLES = false; // Is this OpenGL ES or plain OpenGL? Initialized in main().
 
-QVRVideoPlayer::QVRVideoPlayer(const Screen& screen, QMediaPlaylist* playlist) :
+// In child decode mode, child processes seek when their playback position
+// differs from that of the main process by more than this, but not more
+// often than this.
+static const qint64 maxChildDriftMsecs = 250;
+static const qint64 minChildSeekIntervalMsecs = 1000;
+
+QVRVideoPlayer::QVRVideoPlayer(const Screen& screen, QMediaPlaylist* playlist, bool childDecode, bool frameStats) :
     _wantExit(false),
     _playlist(playlist),
     _player(NULL),
     _surface(NULL),
+    _nextPlayer(NULL),
+    _nextSurface(NULL),
+    _nextPlayerFailed(false),
+    _surfaceThread(NULL),
+    _switchIndex(-1),
+    _switchIsPrefetched(false),
+    _frameStats(frameStats),
+    _updateIntervalUsecs(0),
     _screen(screen),
+    _childDecode(childDecode),
     _frame(NULL),
-    _frameIsNew(false)
+    _frameIsNew(false),
+    _mainUrl(),
+    _mainNextUrl(),
+    _mainIsPlaying(false),
+    _mainPresentationTime(-1),
+    _mainStereoLayout(VideoFrame::Layout_Unknown)
 {
 }
 
 void QVRVideoPlayer::serializeStaticData(QDataStream& ds) const
 {
-    ds << _screen;
+    ds << _screen << _childDecode;
 }
 
 void QVRVideoPlayer::deserializeStaticData(QDataStream& ds)
 {
-    ds >> _screen;
+    ds >> _screen >> _childDecode;
 }
 
 void QVRVideoPlayer::serializeDynamicData(QDataStream& ds) const
 {
-    ds << _frameIsNew;
-    if (_frameIsNew)
-        ds << (*_frame);
+    if (_childDecode) {
+        // Only the playback state; this is a few bytes instead of a full frame
+        ds << _player->currentMedia().request().url();
+        ds << _nextPlayer->currentMedia().request().url();
+        ds << (_player->state() == QMediaPlayer::PlayingState);
+        // Right after a switch, the current frame still belongs to the
+        // previous item, so its time is meaningless for the new one
+        ds << (_switchTimer.isValid() && _switchIndex < 0 ? -1 : _frame->startTime);
+        ds << static_cast<int>(_surface->stereoLayout());
+    } else {
+        ds << _frameIsNew;
+        if (_frameIsNew)
+            ds << (*_frame);
+    }
 }
 
 void QVRVideoPlayer::deserializeDynamicData(QDataStream& ds)
 {
-    ds >> _frameIsNew;
-    if (_frameIsNew)
-        ds >> (*_frame);
+    if (_childDecode) {
+        ds >> _mainUrl >> _mainNextUrl >> _mainIsPlaying >> _mainPresentationTime >> _mainStereoLayout;
+        if (_player)
+            followMainPlayback();
+    } else {
+        ds >> _frameIsNew;
+        if (_frameIsNew)
+            ds >> (*_frame);
+    }
+}
+
+void QVRVideoPlayer::processRejoined(QVRProcess*)
+{
+    // In child decode mode, the complete playback state is sent in every frame.
+    // Otherwise, send the current frame again. The main process may have
+    // cropped it to the view that it needs itself, so map it again first.
+    if (!_childDecode && _frame->size.isValid()) {
+        _frame->remap();
+        _frameIsNew = true;
+    }
+}
+
+void QVRVideoPlayer::followMainPlayback()
+{
+    if (_player->currentMedia().request().url() != _mainUrl) {
+        if (_nextPlayer->currentMedia().request().url() == _mainUrl)
+            swapPlayers();
+        else
+            _player->setMedia(_mainUrl);
+        _childSeekTimer.invalidate();
+    }
+    prefetch(_mainNextUrl);
+    _surface->setStereoLayout(static_cast<enum VideoFrame::StereoLayout>(_mainStereoLayout));
+    _surface->selectFrame(_mainPresentationTime);
+    if (_mainIsPlaying && _player->state() != QMediaPlayer::PlayingState)
+        _player->play();
+    else if (!_mainIsPlaying && _player->state() == QMediaPlayer::PlayingState)
+        _player->pause();
+    if (_mainPresentationTime >= 0
+            && std::llabs(_player->position() - _mainPresentationTime / 1000) > maxChildDriftMsecs
+            && (!_childSeekTimer.isValid() || _childSeekTimer.elapsed() >= minChildSeekIntervalMsecs)) {
+        _player->setPosition(_mainPresentationTime / 1000);
+        _childSeekTimer.start();
+    }
 }
 
 bool QVRVideoPlayer::wantExit()
@@ -290,6 +667,78 @@ bool QVRVideoPlayer::wantExit()
     return _wantExit;
 }
 
+void QVRVideoPlayer::update(const QList<QVRObserver*>& /* observers */)
+{
+    // Predict the media time at which the next frame will be displayed: the
+    // current player position (which follows the audio clock) plus the
+    // duration of one render loop iteration.
+    if (_updateTimer.isValid())
+        _updateIntervalUsecs = qMin(_updateTimer.nsecsElapsed() / 1000, qint64(100000));
+    _updateTimer.start();
+    // Switch playlist items at this frame boundary as soon as the next player
+    // has pre-rolled the new item, or when the current item has ended. Until
+    // then, the current item keeps playing.
+    if (_switchIndex >= 0 && (_nextSurface->hasFrame() || _nextPlayerFailed
+                || _player->mediaStatus() == QMediaPlayer::EndOfMedia)) {
+        if (_nextPlayerFailed) {
+            _wantExit = true;
+            return;
+        }
+        _playlist->setCurrentIndex(_switchIndex);
+        _switchIndex = -1;
+        swapPlayers();
+        prefetch(_playlist->media(_playlist->nextIndex()).request().url());
+    }
+    qint64 displayTime = -1;
+    if (_player->state() != QMediaPlayer::StoppedState)
+        displayTime = _player->position() * 1000 + _updateIntervalUsecs;
+    _surface->selectFrame(displayTime);
+    if (_switchTimer.isValid() && _switchIndex < 0 && _frameIsNew) {
+        qInfo("Playlist switch took %.1f ms (%s)", _switchTimer.nsecsElapsed() / 1e6,
+                _switchIsPrefetched ? "pre-rolled" : "not pre-rolled");
+        _switchTimer.invalidate();
+    }
+    // Only send the views that the child processes need
+    if (_frameIsNew && !_childDecode)
+        _frame->crop(_sendEyes);
+
+    if (_frameStats) {
+        if (!_frameStatsTimer.isValid()) {
+            _frameStatsTimer.start();
+        } else if (_frameStatsTimer.elapsed() >= 1000) {
+            qInfo("Video frames: %d dropped, %d duplicated",
+                    _surface->droppedFrames(), _surface->duplicatedFrames());
+            _frameStatsTimer.start();
+        }
+    }
+}
+
+// Helper function: determine which views of stereoscopic video the windows of
+// a process need, as a combination of VideoFrame::Eyes values
+static int neededEyes(int processIndex)
+{
+    int eyes = 0;
+    for (int w = 0; w < QVRManager::windowCount(processIndex); w++) {
+        switch (QVRManager::windowConfig(processIndex, w).outputMode()) {
+        case QVR_Output_Center:
+        case QVR_Output_Left:
+            eyes |= VideoFrame::Eye_Left;
+            break;
+        case QVR_Output_Right:
+            eyes |= VideoFrame::Eye_Right;
+            break;
+        default:
+            eyes |= VideoFrame::Eyes_Both;
+            break;
+        }
+    }
+    return eyes;
+}
+
+// The maximum deviation of the tessellated curved screen from the true
+// surface, in pixels. The tessellation is chosen per view accordingly.
+static const float maxPixelError = 0.5f;
+
 // Helper function: read a complete file into a QString (without error checking)
 static QString readFile(const char* fileName)
 {
@@ -304,9 +753,33 @@ bool QVRVideoPlayer::initProcess(QVRProcess* /* p */)
     // Qt-based OpenGL function pointers
     initializeOpenGLFunctions();
 
-    // FBO and PBO
+    // Views of stereoscopic video that we need, and that the main process
+    // needs to keep for itself and the child processes
+    _processEyes = neededEyes(QVRManager::processIndex());
+    _sendEyes = 0;
+    for (int p = 0; p < QVRManager::processCount(); p++)
+        _sendEyes |= neededEyes(p);
+
+    // FBO and PBO ring. If possible, the PBOs are mapped persistently.
     glGenFramebuffers(1, &_fbo);
-    glGenBuffers(1, &_pbo);
+    glGenBuffers(3, _pbos);
+    for (int i = 0; i < 3; i++) {
+        _pboPtrs[i] = NULL;
+        _pboSizes[i] = 0;
+        _pboFences[i] = 0;
+    }
+    _pboIndex = 0;
+    _bufferStorage = NULL;
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (isGLES) {
+        if (ctx->hasExtension("GL_EXT_buffer_storage"))
+            _bufferStorage = reinterpret_cast<BufferStorageFunc>(ctx->getProcAddress("glBufferStorageEXT"));
+        _haveTexStorage = true; // core in OpenGL ES 3.0
+    } else {
+        if (ctx->format().version() >= qMakePair(4, 4) || ctx->hasExtension("GL_ARB_buffer_storage"))
+            _bufferStorage = reinterpret_cast<BufferStorageFunc>(ctx->getProcAddress("glBufferStorage"));
+        _haveTexStorage = (ctx->format().version() >= qMakePair(4, 2) || ctx->hasExtension("GL_ARB_texture_storage"));
+    }
     glGenFramebuffers(1, &_viewFbo);
     if (_screen.isPlanar) {
         _depthTex = 0;
@@ -321,21 +794,14 @@ bool QVRVideoPlayer::initProcess(QVRProcess* /* p */)
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depthTex, 0);
     }
 
-    // Color data textures
-    glGenTextures(1, &_rgbTex);
-    glBindTexture(GL_TEXTURE_2D, _rgbTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glGenTextures(3, _yuvTex);
-    glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, _yuvTex[2]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Color data textures: allocated in preRenderProcess() for the first frame
+    _rgbTex = 0;
+    _yuvTex[0] = 0;
+    _yuvTex[1] = 0;
+    _yuvTex[2] = 0;
+    _texPixelFormat = QVideoFrame::Format_Invalid;
+    _texWidth = 0;
+    _texHeight = 0;
 
     // Quad geometry
     const float quadPositions[] = {
@@ -387,20 +853,10 @@ bool QVRVideoPlayer::initProcess(QVRProcess* /* p */)
     _colorConvPrg.link();
 
     // Frame texture
-    glGenTextures(1, &_frameTex);
-    glBindTexture(GL_TEXTURE_2D, _frameTex);
+    _frameTex = 0;
+    reallocateFrameTex(1, 1);
     unsigned int black = 0;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, 1, 1, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, &black);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    if (_screen.isPlanar) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        if (!isGLES)
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 4.0f);
-    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, &black);
 
     // Screen geometry
     glGenVertexArrays(1, &_screenVao);
@@ -425,9 +881,12 @@ bool QVRVideoPlayer::initProcess(QVRProcess* /* p */)
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
             _screen.indices.length() * sizeof(unsigned short),
             _screen.indices.constData(), GL_STATIC_DRAW);
+    // Curved screens are generated in the vertex shader and need no vertex
+    // attributes, so they are drawn with a VAO that has none enabled.
+    glGenVertexArrays(1, &_curvedScreenVao);
 
     // Shader program
-    QString vertexShaderSource = readFile(":vertex-shader.glsl");
+    QString vertexShaderSource = QVRCurvedScreen::glslFunctions() + readFile(":vertex-shader.glsl");
     QString fragmentShaderSource = readFile(":fragment-shader.glsl");
     if (isGLES) {
         vertexShaderSource.prepend("#version 300 es\n");
@@ -442,36 +901,166 @@ bool QVRVideoPlayer::initProcess(QVRProcess* /* p */)
 
     // Media Player
     _frame = new VideoFrame;
-    if (QVRManager::processIndex() == 0) {
+    if (QVRManager::processIndex() == 0 || _childDecode) {
+        // In child decode mode, child processes decode locally, following the
+        // playback of the main process. Audio is only played by the main process.
         _surface = new VideoSurface(_frame, &_frameIsNew);
-        _player = new QMediaPlayer(NULL, QMediaPlayer::VideoSurface);
-        _player->connect(_player, static_cast<void(QMediaPlayer::*)(QMediaPlayer::Error)>(&QMediaPlayer::error),
+        _nextSurface = new VideoSurface(_frame, &_frameIsNew);
+        startSurfaceThread();
+        _player = createPlayer(_surface);
+        _nextPlayer = createPlayer(_nextSurface);
+    }
+    if (QVRManager::processIndex() == 0) {
+        _playlist->setCurrentIndex(0);
+        QUrl url = _playlist->currentMedia().request().url();
+        _surface->newUrl(url);
+        _player->setMedia(url);
+        _player->play();
+        prefetch(_playlist->media(_playlist->nextIndex()).request().url());
+    }
+
+    return true;
+}
+
+void QVRVideoPlayer::exitProcess(QVRProcess* /* p */)
+{
+    if (_player)
+        _player->stop();
+    if (_nextPlayer)
+        _nextPlayer->stop();
+    if (_surfaceThread) {
+        _surfaceThread->quit();
+        _surfaceThread->wait();
+    }
+}
+
+void QVRVideoPlayer::startSurfaceThread()
+{
+    // The surfaces receive decoded frames in the thread they live in
+    _surfaceThread = new QThread;
+    _surfaceThread->setObjectName("video surface");
+    _surface->moveToThread(_surfaceThread);
+    _nextSurface->moveToThread(_surfaceThread);
+    _surfaceThread->start();
+}
+
+QMediaPlayer* QVRVideoPlayer::createPlayer(VideoSurface* surface)
+{
+    QMediaPlayer* player = new QMediaPlayer(NULL, QMediaPlayer::VideoSurface);
+    if (QVRManager::processIndex() == 0) {
+        player->connect(player, static_cast<void(QMediaPlayer::*)(QMediaPlayer::Error)>(&QMediaPlayer::error),
                 [=](QMediaPlayer::Error error) {
                     if (error != QMediaPlayer::NoError) {
-                        //qCritical("Error: %s", qPrintable(_player->errorString()));
-                        _wantExit = true;
+                        if (player == _player) {
+                            //qCritical("Error: %s", qPrintable(player->errorString()));
+                            _wantExit = true;
+                        } else {
+                            _nextPlayerFailed = true;
+                        }
                     }
                 });
-        _player->connect(_player, &QMediaPlayer::stateChanged,
-                [=](QMediaPlayer::State state) {
-                    if (state == QMediaPlayer::StoppedState)
-                        _wantExit = true;
-                });
-        _player->connect(_player, &QMediaPlayer::currentMediaChanged,
-                [=](const QMediaContent &content) {
-                    _surface->newUrl(content.request().url());
+        player->connect(player, &QMediaPlayer::mediaStatusChanged,
+                [=](QMediaPlayer::MediaStatus status) {
+                    if (player == _player && status == QMediaPlayer::EndOfMedia) {
+                        int next = _playlist->nextIndex();
+                        if (next < 0)
+                            _wantExit = true;
+                        else if (_switchIndex < 0)
+                            requestSwitch(next);
+                    }
                 });
-        _player->connect(_player, &QMediaPlayer::metaDataAvailableChanged,
+        player->connect(player, &QMediaPlayer::metaDataAvailableChanged,
                 [=](bool available) {
                     if (available)
-                        _surface->newMetaData(_player);
+                        surface->newMetaData(player);
                 });
-        _player->setVideoOutput(_surface);
-        _player->setPlaylist(_playlist);
+    } else {
+        player->connect(player, static_cast<void(QMediaPlayer::*)(QMediaPlayer::Error)>(&QMediaPlayer::error),
+                [=](QMediaPlayer::Error error) {
+                    if (error != QMediaPlayer::NoError)
+                        qWarning("Cannot decode video locally: %s", qPrintable(player->errorString()));
+                });
+        player->setMuted(true);
+    }
+    player->setVideoOutput(surface);
+    return player;
+}
+
+void QVRVideoPlayer::prefetch(const QUrl& url)
+{
+    if (url.isEmpty() || _nextPlayer->currentMedia().request().url() == url)
+        return;
+    _nextPlayer->stop();
+    _nextSurface->clear();
+    _nextSurface->newUrl(url);
+    _nextPlayerFailed = false;
+    _nextPlayer->setMedia(url);
+    // Pausing opens the media and pre-rolls it: the first decoded frames are
+    // presented to the surface, which keeps them until we switch.
+    _nextPlayer->pause();
+}
+
+void QVRVideoPlayer::requestSwitch(int playlistIndex)
+{
+    QUrl url = _playlist->media(playlistIndex).request().url();
+    _switchIsPrefetched = (_nextPlayer->currentMedia().request().url() == url && _nextSurface->hasFrame());
+    prefetch(url);
+    _switchIndex = playlistIndex;
+    _switchTimer.start();
+}
+
+void QVRVideoPlayer::swapPlayers()
+{
+    bool muted = _player->isMuted();
+    int volume = _player->volume();
+    bool paused = (_player->state() == QMediaPlayer::PausedState);
+    qSwap(_player, _nextPlayer);
+    qSwap(_surface, _nextSurface);
+    // The last frame of the previous item remains visible until the new item
+    // presents its first frame, so there is no gap in the output.
+    _nextPlayer->stop();
+    _nextPlayer->setMedia(QMediaContent());
+    _player->setVolume(volume);
+    _player->setMuted(muted);
+    if (!paused)
         _player->play();
+}
+
+void QVRVideoPlayer::reallocateTexture(unsigned int* tex, unsigned int internalFormat,
+        unsigned int format, unsigned int type, int w, int h, int levels, int filter)
+{
+    glDeleteTextures(1, tex);
+    glGenTextures(1, tex);
+    glBindTexture(GL_TEXTURE_2D, *tex);
+    if (_haveTexStorage) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, w, h);
+    } else {
+        for (int l = 0; l < levels; l++) {
+            glTexImage2D(GL_TEXTURE_2D, l, internalFormat, w, h, 0, format, type, NULL);
+            w = qMax(w / 2, 1);
+            h = qMax(h / 2, 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
     }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+}
 
-    return true;
+void QVRVideoPlayer::reallocateFrameTex(int w, int h)
+{
+    int levels = 1;
+    if (!_screen.isPlanar) {
+        for (int s = qMax(w, h); s > 1; s /= 2)
+            levels++;
+    }
+    reallocateTexture(&_frameTex, GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, w, h, levels, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    if (!_screen.isPlanar) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        if (!isGLES)
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 4.0f);
+    }
 }
 
 void QVRVideoPlayer::preRenderProcess(QVRProcess* /* p */)
@@ -486,132 +1075,202 @@ void QVRVideoPlayer::preRenderProcess(QVRProcess* /* p */)
      * render into that format, it is filterable, and 10 bit per color should be
      * enough. */
     if (_frameIsNew && QVRManager::windowCount() > 0) {
-        // First copy the frame data into a PBO and from there into textures.
-        // This is faster than using glTexImage2D() directly on the frame data.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, _frame->data.size(), NULL, GL_STREAM_DRAW);
-        void* ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, _frame->data.size(),
-                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
-        Q_ASSERT(ptr);
-        std::memcpy(ptr, _frame->data.constData(), _frame->data.size());
-        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // Only upload and convert the views that our windows need
+        _frame->crop(_processEyes);
         const int w = _frame->size.width();
         const int h = _frame->size.height();
-        int shaderInput; // 0=rgbTex.rgb, 1=yuvTex.rgb, 2=vec3(yuvTex[0].r,yuvTex[1].r,yuvTex[2].r)
+        GLenum internalFormat, format, type;
+        GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ONE };
+        int shaderInput; // 0=rgbTex.rgb, 1=yuvTex.rgb, 2=vec3(yuvTex[0].r,yuvTex[1].r,yuvTex[2].r),
+                         // 3=vec3(yuvTex[0].r,yuvTex[1].rg)
+        uintptr_t uOffset = 0, vOffset = 0; // offsets of the U and V planes for shaderInput 2,
+                                            // or of the interleaved UV plane for shaderInput 3
+        GLint uvSwizzle[2] = { GL_RED, GL_GREEN }; // swizzle of the UV plane for shaderInput 3
         switch (_frame->pixelFormat) {
         case QVideoFrame::Format_RGB24:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGB8;
+            format = GL_RGB;
+            type = GL_UNSIGNED_BYTE;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_BGR24:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGB8;
+            format = GL_RGB;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[0] = GL_BLUE;
+            swizzle[2] = GL_RED;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_ARGB32:
         case QVideoFrame::Format_RGB32:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_ALPHA);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGBA8;
+            format = GL_RGBA;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[0] = GL_GREEN;
+            swizzle[1] = GL_BLUE;
+            swizzle[2] = GL_ALPHA;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_BGRA32:
         case QVideoFrame::Format_BGR32:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGBA8;
+            format = GL_RGBA;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[0] = GL_BLUE;
+            swizzle[2] = GL_RED;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_RGB565:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB565, w, h, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGB565;
+            format = GL_RGB;
+            type = GL_UNSIGNED_SHORT_5_6_5;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_BGR565:
-            glBindTexture(GL_TEXTURE_2D, _rgbTex);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB565, w, h, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGB565;
+            format = GL_RGB;
+            type = GL_UNSIGNED_SHORT_5_6_5;
+            swizzle[0] = GL_BLUE;
+            swizzle[2] = GL_RED;
             shaderInput = 0;
             break;
         case QVideoFrame::Format_YUV444:
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGB8;
+            format = GL_RGB;
+            type = GL_UNSIGNED_BYTE;
             shaderInput = 1;
             break;
         case QVideoFrame::Format_AYUV444:
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_GREEN);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_BLUE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_ALPHA);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+            internalFormat = GL_RGBA8;
+            format = GL_RGBA;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[0] = GL_GREEN;
+            swizzle[1] = GL_BLUE;
+            swizzle[2] = GL_ALPHA;
             shaderInput = 1;
             break;
         case QVideoFrame::Format_YUV420P:
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_ZERO);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_ZERO);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w / 2, h / 2, 0, GL_RED, GL_UNSIGNED_BYTE,
-                    reinterpret_cast<const GLvoid*>(w * h));
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[2]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w / 2, h / 2, 0, GL_RED, GL_UNSIGNED_BYTE,
-                    reinterpret_cast<const GLvoid*>(w * h + w * h / 4));
+            internalFormat = GL_R8;
+            format = GL_RED;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[1] = GL_ZERO;
+            swizzle[2] = GL_ZERO;
             shaderInput = 2;
+            uOffset = w * h;
+            vOffset = w * h + w * h / 4;
             break;
         case QVideoFrame::Format_YV12:
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_ZERO);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_ZERO);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[2]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w / 2, h / 2, 0, GL_RED, GL_UNSIGNED_BYTE,
-                    reinterpret_cast<const GLvoid*>(w * h));
-            glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w / 2, h / 2, 0, GL_RED, GL_UNSIGNED_BYTE,
-                    reinterpret_cast<const GLvoid*>(w * h + w * h / 4));
+            internalFormat = GL_R8;
+            format = GL_RED;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[1] = GL_ZERO;
+            swizzle[2] = GL_ZERO;
             shaderInput = 2;
+            uOffset = w * h + w * h / 4;
+            vOffset = w * h;
+            break;
+        case QVideoFrame::Format_NV12:
+        case QVideoFrame::Format_NV21:
+            internalFormat = GL_R8;
+            format = GL_RED;
+            type = GL_UNSIGNED_BYTE;
+            swizzle[1] = GL_ZERO;
+            swizzle[2] = GL_ZERO;
+            shaderInput = 3;
+            uOffset = w * h;
+            if (_frame->pixelFormat == QVideoFrame::Format_NV21) {
+                uvSwizzle[0] = GL_GREEN;
+                uvSwizzle[1] = GL_RED;
+            }
             break;
         default:
             qFatal("unknown pixel format %d", _frame->pixelFormat);
             break;
         }
+
+        // Reallocate the textures only if the format or size changed. The
+        // textures are immutable if possible, so this means replacing them.
+        if (_frame->pixelFormat != _texPixelFormat || w != _texWidth || h != _texHeight) {
+            unsigned int* tex = (shaderInput == 0 ? &_rgbTex : &_yuvTex[0]);
+            reallocateTexture(tex, internalFormat, format, type, w, h, 1, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, swizzle[0]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, swizzle[1]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, swizzle[2]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, swizzle[3]);
+            if (shaderInput == 2) {
+                reallocateTexture(&_yuvTex[1], internalFormat, format, type, w / 2, h / 2, 1, GL_LINEAR);
+                reallocateTexture(&_yuvTex[2], internalFormat, format, type, w / 2, h / 2, 1, GL_LINEAR);
+            } else if (shaderInput == 3) {
+                reallocateTexture(&_yuvTex[1], GL_RG8, GL_RG, GL_UNSIGNED_BYTE, w / 2, h / 2, 1, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, uvSwizzle[0]);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, uvSwizzle[1]);
+            }
+            reallocateFrameTex(w, h);
+            glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _frameTex, 0);
+            _texPixelFormat = _frame->pixelFormat;
+            _texWidth = w;
+            _texHeight = h;
+        }
+
+        // Copy the frame data into the next PBO of the ring and from there
+        // into the textures. The GPU may still read from the other PBOs while
+        // we write into this one.
+        const int size = _frame->data.size();
+        const int i = _pboIndex;
+        _pboIndex = (_pboIndex + 1) % 3;
+        if (_pboFences[i]) {
+            glClientWaitSync(_pboFences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(_pboFences[i]);
+            _pboFences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbos[i]);
+        if (size > _pboSizes[i]) {
+            if (_bufferStorage) {
+                // Buffer storage is immutable, so replace the buffer
+                glDeleteBuffers(1, &_pbos[i]);
+                glGenBuffers(1, &_pbos[i]);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbos[i]);
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                _bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+                _pboPtrs[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+                Q_ASSERT(_pboPtrs[i]);
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+            }
+            _pboSizes[i] = size;
+        }
+        void* ptr = _pboPtrs[i];
+        if (!ptr) {
+            ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            Q_ASSERT(ptr);
+        }
+        std::memcpy(ptr, _frame->data.constData(), size);
+        if (!_pboPtrs[i])
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (shaderInput == 0) {
+            glBindTexture(GL_TEXTURE_2D, _rgbTex);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, NULL);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, _yuvTex[0]);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, NULL);
+            if (shaderInput == 2) {
+                glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, format, type,
+                        reinterpret_cast<const GLvoid*>(uOffset));
+                glBindTexture(GL_TEXTURE_2D, _yuvTex[2]);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, format, type,
+                        reinterpret_cast<const GLvoid*>(vOffset));
+            } else if (shaderInput == 3) {
+                glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w / 2, h / 2, GL_RG, type,
+                        reinterpret_cast<const GLvoid*>(uOffset));
+            }
+        }
+        _pboFences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, _frameTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, w, h, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, NULL);
         glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _frameTex, 0);
         glDisable(GL_DEPTH_TEST);
         glViewport(0, 0, w, h);
         glUseProgram(_colorConvPrg.programId());
@@ -656,6 +1315,10 @@ void QVRVideoPlayer::preRenderProcess(QVRProcess* /* p */)
                 glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
                 glActiveTexture(GL_TEXTURE2);
                 glBindTexture(GL_TEXTURE_2D, _yuvTex[2]);
+            } else if (shaderInput == 3) {
+                _colorConvPrg.setUniformValue("yuv_tex1", 1);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, _yuvTex[1]);
             }
         }
         glBindVertexArray(_quadVao);
@@ -692,13 +1355,7 @@ void QVRVideoPlayer::render(QVRWindow* /* w */,
         QMatrix4x4 projectionMatrix = context.frustum(view).toMatrix4x4();
         QMatrix4x4 viewMatrix = context.viewMatrix(view);
         // Set up stereo layout
-        enum VideoFrame::StereoLayout stereoLayout = _frame->stereoLayout;
-        if (stereoLayout == VideoFrame::Layout_Unknown) {
-            if (_frame->aspectRatio > 3.0f)
-                stereoLayout = VideoFrame::Layout_Left_Right;
-            else if (_frame->aspectRatio < 1.0f)
-                stereoLayout = VideoFrame::Layout_Top_Bottom;
-        }
+        enum VideoFrame::StereoLayout stereoLayout = _frame->effectiveStereoLayout();
         float frameAspectRatio = _frame->aspectRatio;
         float viewOffsetX = 0.0f;
         float viewFactorX = 1.0f;
@@ -762,11 +1419,22 @@ void QVRVideoPlayer::render(QVRWindow* /* w */,
         _prg.setUniformValue("view_factor_y", viewFactorY);
         _prg.setUniformValue("relative_width", relWidth);
         _prg.setUniformValue("relative_height", relHeight);
+        _prg.setUniformValue("curved_screen", _screen.isCurved);
         // Render scene
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, _frameTex);
-        glBindVertexArray(_screenVao);
-        glDrawElements(GL_TRIANGLES, _screen.indices.size(), GL_UNSIGNED_SHORT, 0);
+        if (_screen.isCurved) {
+            glBindVertexArray(_curvedScreenVao);
+            // Tessellate the curved screen just finely enough for this view
+            int columns, rows;
+            _screen.curvedScreen.tessellation(QVRCurvedScreen::pixelsPerRadian(context, view),
+                    maxPixelError, &columns, &rows);
+            _screen.curvedScreen.setUniforms(_prg, columns, rows);
+            glDrawArrays(GL_TRIANGLES, 0, QVRCurvedScreen::vertexCount(columns, rows));
+        } else {
+            glBindVertexArray(_screenVao);
+            glDrawElements(GL_TRIANGLES, _screen.indices.size(), GL_UNSIGNED_SHORT, 0);
+        }
         // Invalidate depth attachment (to help OpenGL ES performance)
         if (!_screen.isPlanar) {
             const GLenum fboInvalidations[] = { GL_DEPTH_ATTACHMENT };
@@ -778,15 +1446,15 @@ void QVRVideoPlayer::render(QVRWindow* /* w */,
 void QVRVideoPlayer::playlistNext()
 {
     if (_playlist->currentIndex() < _playlist->mediaCount() - 1)
-        _playlist->next();
+        requestSwitch(_playlist->currentIndex() + 1);
 }
 
 void QVRVideoPlayer::playlistPrevious()
 {
     if (_playlist->currentIndex() > 0 && _player->position() < 5000)
-        _playlist->previous();
+        requestSwitch(_playlist->currentIndex() - 1);
     else
-        _playlist->setCurrentIndex(_playlist->currentIndex());
+        _player->setPosition(0);
 }
 
 void QVRVideoPlayer::seek(qint64 milliseconds)
@@ -827,6 +1495,7 @@ void QVRVideoPlayer::changeVolume(int offset)
 void QVRVideoPlayer::stop()
 {
     _player->stop();
+    _wantExit = true;
 }
 
 void QVRVideoPlayer::keyPressEvent(const QVRRenderContext& /* context */, QKeyEvent* event)
@@ -900,6 +1569,8 @@ int main(int argc, char* argv[])
             QVector3D(+16.0f / 9.0f, -1.0f + QVRObserverConfig::defaultEyeHeight, -8.0f),
             QVector3D(-16.0f / 9.0f, +1.0f + QVRObserverConfig::defaultEyeHeight, -8.0f));
     QMediaPlaylist playlist;
+    bool childDecode = false;
+    bool frameStats = false;
     if (QVRManager::processIndex() == 0) {
         QCommandLineParser parser;
         parser.setApplicationDescription("QVR video player");
@@ -909,6 +1580,8 @@ int main(int argc, char* argv[])
         parser.addOptions({
                 { { "l", "loop" }, "Loop playlist." },
                 { { "s", "screen" }, "Set screen geometry.", "screen" },
+                { { "c", "child-decode" }, "Let child processes decode the video themselves." },
+                { { "f", "frame-stats" }, "Print the number of dropped and duplicated frames once per second." },
         });
         parser.process(app);
         QStringList posArgs = parser.positionalArguments();
@@ -933,6 +1606,8 @@ int main(int argc, char* argv[])
                 playlist.addMedia(url);
             }
         }
+        childDecode = parser.isSet("child-decode");
+        frameStats = parser.isSet("frame-stats");
         if (parser.isSet("loop")) {
             qInfo("Setting playlist to loop mode");
             playlist.setPlaybackMode(QMediaPlaylist::Loop);
@@ -950,6 +1625,31 @@ int main(int argc, char* argv[])
                         QVector3D(values[0], values[1], values[2]),
                         QVector3D(values[3], values[4], values[5]),
                         QVector3D(values[6], values[7], values[8]));
+            } else if (paramList.length() > 0
+                    && (paramList[0] == "cylinder" || paramList[0] == "sphere" || paramList[0] == "dome")) {
+                const int n = (paramList[0] == "cylinder" ? 10 : paramList[0] == "sphere" ? 11 : 8);
+                float v[11];
+                bool ok = (paramList.length() == n + 1);
+                for (int i = 0; ok && i < n; i++)
+                    v[i] = paramList[i + 1].toFloat(&ok);
+                if (!ok) {
+                    qCritical("Invalid screen definition: %s", qPrintable(parser.value("screen")));
+                    return 1;
+                }
+                QVector3D center(v[0], v[1], v[2]);
+                QVector3D up(v[3], v[4], v[5]);
+                if (paramList[0] == "cylinder") {
+                    screen = Screen(QVRCurvedScreen::cylinder(center, up, v[6],
+                                qDegreesToRadians(v[7]), qDegreesToRadians(v[8]),
+                                qDegreesToRadians(v[9])));
+                } else if (paramList[0] == "sphere") {
+                    screen = Screen(QVRCurvedScreen::sphereSection(center, up, v[6],
+                                qDegreesToRadians(v[7]), qDegreesToRadians(v[8]),
+                                qDegreesToRadians(v[9]), qDegreesToRadians(v[10])));
+                } else {
+                    screen = Screen(QVRCurvedScreen::dome(center, up, v[6],
+                                qDegreesToRadians(v[7])));
+                }
             } else if (paramList.length() == 2) {
                 float ar;
                 float ar2[2];
@@ -982,7 +1682,7 @@ int main(int argc, char* argv[])
     QSurfaceFormat::setDefaultFormat(format);
 
     /* Then start QVR with your app */
-    QVRVideoPlayer qvrapp(screen, &playlist);
+    QVRVideoPlayer qvrapp(screen, &playlist, childDecode, frameStats);
     if (!manager.init(&qvrapp)) {
         qCritical("Cannot initialize QVR manager");
         return 1;
@@ -26,8 +26,11 @@
 
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLShaderProgram>
+#include <QUrl>
+#include <QElapsedTimer>
 class QMediaPlaylist;
 class QMediaPlayer;
+class QThread;
 class VideoSurface;
 class VideoFrame;
 
@@ -39,7 +42,7 @@ class VideoFrame;
 class QVRVideoPlayer : public QVRApp, protected QOpenGLExtraFunctions
 {
 public:
-    QVRVideoPlayer(const Screen& screen, QMediaPlaylist* playlist);
+    QVRVideoPlayer(const Screen& screen, QMediaPlaylist* playlist, bool childDecode, bool frameStats);
 
 private:
     /* Data not directly relevant for rendering */
@@ -47,26 +50,79 @@ private:
     QMediaPlaylist* _playlist;
     QMediaPlayer* _player;
     VideoSurface* _surface;
+    QMediaPlayer* _nextPlayer;   // pre-rolls the next playlist item
+    VideoSurface* _nextSurface;  // keeps the first decoded frames of the next item
+    bool _nextPlayerFailed;      // the next item could not be opened
+    QThread* _surfaceThread;
+    int _switchIndex;            // playlist index to switch to at the next frame, or -1
+    bool _switchIsPrefetched;    // whether the next item was pre-rolled when the switch was requested
+    QElapsedTimer _switchTimer;  // runs from a switch request until the first frame of the new item
+    bool _frameStats;            // print frame statistics once per second
+    QElapsedTimer _frameStatsTimer;
+    QElapsedTimer _updateTimer;  // measures the duration of render loop iterations
+    qint64 _updateIntervalUsecs;
 
     /* Static data for rendering, initialized on the main process */
     Screen _screen;
+    bool _childDecode; // child processes decode the video themselves
 
     /* Static data for rendering, initialized in initProcess() */
+    int _processEyes;           // views that the windows of this process need
+    int _sendEyes;              // views that any process needs
     unsigned int _fbo;
-    unsigned int _pbo;
+    typedef void (QOPENGLF_APIENTRYP BufferStorageFunc)(GLenum, GLsizeiptr, const void*, GLbitfield);
+    BufferStorageFunc _bufferStorage; // glBufferStorage() if available, or NULL
+    bool _haveTexStorage;       // whether glTexStorage2D() is available
+    unsigned int _pbos[3];      // ring of PBOs for frame upload
+    void* _pboPtrs[3];          // persistent mappings of the PBOs, or NULL
+    int _pboSizes[3];           // allocated sizes of the PBOs
+    GLsync _pboFences[3];       // signaled when the GPU is done reading a PBO
+    int _pboIndex;              // index of the next PBO to use
     unsigned int _rgbTex;
     unsigned int _yuvTex[3];
+    int _texPixelFormat;        // pixel format that the textures are allocated for
+    int _texWidth, _texHeight;  // frame size that the textures are allocated for
     unsigned int _quadVao;
     QOpenGLShaderProgram _colorConvPrg;
     unsigned int _viewFbo;
     unsigned int _depthTex;
     unsigned int _frameTex;
     unsigned int _screenVao;
+    unsigned int _curvedScreenVao; // without vertex attributes, for curved screens
     QOpenGLShaderProgram _prg;
 
     /* Dynamic data for rendering */
     VideoFrame* _frame;
     bool _frameIsNew;
+    /* Dynamic data for rendering in child decode mode: the playback state of
+     * the main process, which the child processes follow */
+    QUrl _mainUrl;
+    QUrl _mainNextUrl;
+    bool _mainIsPlaying;
+    qint64 _mainPresentationTime; // start time of the current frame in microseconds, or -1
+    int _mainStereoLayout;
+    QElapsedTimer _childSeekTimer;
+
+    /* Child decode mode: make the local player follow the main process */
+    void followMainPlayback();
+
+    /* Let the video surfaces receive frames in their own thread */
+    void startSurfaceThread();
+
+    /* Playlist prefetching: the next player opens and pre-rolls the next
+     * item in paused state, and switching swaps the players at a frame
+     * boundary in update() */
+    QMediaPlayer* createPlayer(VideoSurface* surface);
+    void prefetch(const QUrl& url);
+    void requestSwitch(int playlistIndex);
+    void swapPlayers();
+
+    /* Replace textures with new textures of the given size. These are immutable
+     * if glTexStorage2D() is available; otherwise format and type are used to
+     * allocate the levels with glTexImage2D(). */
+    void reallocateTexture(unsigned int* tex, unsigned int internalFormat,
+            unsigned int format, unsigned int type, int w, int h, int levels, int filter);
+    void reallocateFrameTex(int w, int h);
 
     /* Interaction functions */
     void playlistNext();
@@ -86,9 +142,14 @@ public:
     void serializeDynamicData(QDataStream& ds) const override;
     void deserializeDynamicData(QDataStream& ds) override;
 
+    void processRejoined(QVRProcess* p) override;
+
     bool wantExit() override;
 
+    void update(const QList<QVRObserver*>& observers) override;
+
     bool initProcess(QVRProcess* p) override;
+    void exitProcess(QVRProcess* p) override;
 
     void preRenderProcess(QVRProcess* p) override;
 
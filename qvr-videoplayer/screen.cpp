@@ -55,6 +55,7 @@ Screen::Screen(const QVector3D& bottomLeftCorner,
     float height = (topLeftCorner - bottomLeftCorner).length();
     aspectRatio = width / height;
     isPlanar = true;
+    isCurved = false;
 }
 
 Screen::Screen(const QString& objFileName, float aspectRatio)
@@ -118,16 +119,27 @@ Screen::Screen(const QString& objFileName, float aspectRatio)
 
     this->aspectRatio = aspectRatio;
     isPlanar = false;
+    isCurved = false;
+}
+
+Screen::Screen(const QVRCurvedScreen& curvedScreen) :
+    aspectRatio(curvedScreen.aspectRatio()),
+    isPlanar(false),
+    isCurved(true),
+    curvedScreen(curvedScreen)
+{
 }
 
 QDataStream &operator<<(QDataStream& ds, const Screen& s)
 {
-    ds << s.positions << s.texCoords << s.indices << s.aspectRatio << s.isPlanar;
+    ds << s.positions << s.texCoords << s.indices << s.aspectRatio << s.isPlanar
+        << s.isCurved << s.curvedScreen;
     return ds;
 }
 
 QDataStream &operator>>(QDataStream& ds, Screen& s)
 {
-    ds >> s.positions >> s.texCoords >> s.indices >> s.aspectRatio >> s.isPlanar;
+    ds >> s.positions >> s.texCoords >> s.indices >> s.aspectRatio >> s.isPlanar
+        >> s.isCurved >> s.curvedScreen;
     return ds;
 }
@@ -27,6 +27,8 @@
 #include <QVector>
 #include <QVector3D>
 
+#include <qvr/curvedscreen.hpp>
+
 class Screen
 {
 public:
@@ -35,8 +37,10 @@ public:
     QVector<unsigned short> indices;
     float aspectRatio;
     bool isPlanar;
+    bool isCurved;             // if true, the geometry is generated from curvedScreen
+    QVRCurvedScreen curvedScreen;
 
-    Screen() : aspectRatio(0.0f), isPlanar(false) {}
+    Screen() : aspectRatio(0.0f), isPlanar(false), isCurved(false) {}
 
     // Construct a planar screen.
     // The aspect ratio is inferred from the screen corners.
@@ -51,6 +55,11 @@ public:
     // after constructing the screen in this way, then loading
     // the OBJ file failed.
     Screen(const QString& objFileName, float aspectRatio);
+
+    // Construct a curved screen (cylinder, sphere section, or dome).
+    // Its geometry is generated in the vertex shader with a tessellation
+    // that fits each view, so positions, texCoords and indices remain empty.
+    Screen(const QVRCurvedScreen& curvedScreen);
 };
 
 QDataStream &operator<<(QDataStream& ds, const Screen& f);
@@ -21,7 +21,10 @@
  * SOFTWARE.
  */
 
+// The QVRCurvedScreen functions are prepended at runtime
+
 uniform mat4 projection_model_view_matrix;
+uniform bool curved_screen;
 
 layout(location = 0) in vec4 pos;
 layout(location = 1) in vec2 texcoord;
@@ -30,6 +33,12 @@ smooth out vec2 vtexcoord;
 
 void main(void)
 {
-    vtexcoord = texcoord;
-    gl_Position = projection_model_view_matrix * pos;
+    if (curved_screen) {
+        vec2 tc;
+        gl_Position = projection_model_view_matrix * qvr_curved_screen_vertex(tc);
+        vtexcoord = tc;
+    } else {
+        vtexcoord = texcoord;
+        gl_Position = projection_model_view_matrix * pos;
+    }
 }
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Micro benchmark: distribution of VNC framebuffer updates to child processes.
+ * Replays a trace of VNC update rectangles that was recorded with
+ * qvr-vncviewer --record-updates, and compares the bytes per frame and the CPU
+ * cost per frame of the serialized updates
+ * - with every update rectangle sent as received from the VNC server,
+ * - with merged dirty rectangles (addDirtyRectangle()),
+ * - with merged dirty rectangles and qCompress() at level 1.
+ * The trace contains no pixel data. The framebuffer content is taken from the
+ * optional image (e.g. a screenshot of the VNC desktop, scaled to the
+ * framebuffer size); without it, a synthetic desktop-like pattern is used,
+ * which makes the compression results less meaningful. */
+
+#include <cstdio>
+#include <cstring>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QVector>
+
+#include "dirtyrectangles.hpp"
+
+struct TraceFrame
+{
+    int width;
+    int height;
+    QVector<QRect> rects;
+};
+
+static bool readTrace(const char* fileName, QList<TraceFrame>& frames)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    while (!file.atEnd()) {
+        QList<QByteArray> fields = file.readLine().simplified().split(' ');
+        if (fields.size() < 2)
+            continue;
+        TraceFrame frame;
+        frame.width = fields[0].toInt();
+        frame.height = fields[1].toInt();
+        for (int i = 2; i < fields.size(); i++) {
+            QList<QByteArray> v = fields[i].split(',');
+            if (v.size() == 4)
+                frame.rects.append(QRect(v[0].toInt(), v[1].toInt(), v[2].toInt(), v[3].toInt()));
+        }
+        frames.append(frame);
+    }
+    return true;
+}
+
+static void createFramebuffer(QVector<unsigned int>& fb, int width, int height, const QImage& image)
+{
+    fb.resize(width * height);
+    if (!image.isNull()) {
+        QImage img = image.convertToFormat(QImage::Format_RGB32).scaled(width, height);
+        for (int y = 0; y < height; y++)
+            std::memcpy(&fb[y * width], img.constScanLine(y), width * sizeof(unsigned int));
+    } else {
+        // A uniform background with windows that contain lines of "text"
+        unsigned int seed = 1;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                bool inWindow = ((x / 400) % 2 == (y / 300) % 2);
+                unsigned int color = (inWindow ? 0xffffffffu : 0xff3465a4u);
+                if (inWindow && y % 16 < 10) {
+                    seed = seed * 1103515245u + 12345u;
+                    if ((seed >> 16) % 4 == 0)
+                        color = 0xff000000u;
+                }
+                fb[y * width + x] = color;
+            }
+        }
+    }
+}
+
+static qint64 serializeUpdate(QByteArray& buf, const QVector<unsigned int>& fb, int width,
+        const QVector<QRect>& rects, bool compress)
+{
+    buf.resize(0);
+    QDataStream ds(&buf, QIODevice::WriteOnly);
+    ds << width << (fb.size() / width);
+    ds << rects;
+    QByteArray pixels;
+    packDirtyRectangles(pixels, fb.constData(), width, rects);
+    if (compress)
+        ds << qCompress(pixels, 1);
+    else
+        ds.writeRawData(pixels.constData(), pixels.size());
+    return buf.size();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3) {
+        std::fprintf(stderr, "Usage: %s <update-trace> [<framebuffer-image>]\n", argv[0]);
+        return 1;
+    }
+    QList<TraceFrame> frames;
+    if (!readTrace(argv[1], frames) || frames.size() == 0) {
+        std::fprintf(stderr, "Cannot read update trace %s\n", argv[1]);
+        return 1;
+    }
+    QImage image;
+    if (argc == 3 && !image.load(argv[2])) {
+        std::fprintf(stderr, "Cannot read framebuffer image %s\n", argv[2]);
+        return 1;
+    }
+
+    const char* methodNames[3] = {
+        "unmerged rectangles:         ",
+        "merged rectangles:           ",
+        "merged rectangles, qCompress:"
+    };
+    qint64 bytes[3] = { 0, 0, 0 };
+    qint64 nsecs[3] = { 0, 0, 0 };
+    qint64 rectCount[3] = { 0, 0, 0 };
+    QVector<unsigned int> fb;
+    int fbWidth = -1, fbHeight = -1;
+    QVector<QRect> merged;
+    QByteArray buf;
+    QElapsedTimer timer;
+    for (int f = 0; f < frames.size(); f++) {
+        const TraceFrame& frame = frames[f];
+        if (frame.width != fbWidth || frame.height != fbHeight) {
+            fbWidth = frame.width;
+            fbHeight = frame.height;
+            createFramebuffer(fb, fbWidth, fbHeight, image);
+        }
+        QRect bounds(0, 0, fbWidth, fbHeight);
+        QVector<QRect> unmerged;
+        for (int i = 0; i < frame.rects.size(); i++) {
+            QRect r = frame.rects[i].intersected(bounds);
+            if (!r.isEmpty())
+                unmerged.append(r);
+        }
+        for (int method = 0; method < 3; method++) {
+            timer.start();
+            const QVector<QRect>* rects = &unmerged;
+            if (method > 0) {
+                merged.clear();
+                for (int i = 0; i < frame.rects.size(); i++)
+                    addDirtyRectangle(merged, frame.rects[i], bounds);
+                rects = &merged;
+            }
+            bytes[method] += serializeUpdate(buf, fb, fbWidth, *rects, method == 2);
+            nsecs[method] += timer.nsecsElapsed();
+            rectCount[method] += rects->size();
+        }
+    }
+
+    std::printf("%d frames with updates, %s framebuffer content:\n", frames.size(),
+            image.isNull() ? "synthetic" : "image");
+    for (int method = 0; method < 3; method++) {
+        std::printf("  %s %.1f rectangles, %.1f KiB, %.1f us per frame\n", methodNames[method],
+                rectCount[method] / double(frames.size()),
+                bytes[method] / 1024.0 / frames.size(),
+                nsecs[method] / 1000.0 / frames.size());
+    }
+    return 0;
+}
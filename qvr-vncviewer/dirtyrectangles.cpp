@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dirtyrectangles.hpp"
+
+
+static const int mergeSlackPixels = 1024;
+
+void addDirtyRectangle(QVector<QRect>& rects, const QRect& rect, const QRect& bounds)
+{
+    QRect r = rect.intersected(bounds);
+    if (r.isEmpty())
+        return;
+    // The merged rectangle may in turn be mergeable with others, so repeat
+    // until nothing changes
+    bool changed;
+    do {
+        changed = false;
+        for (int j = 0; j < rects.size(); j++) {
+            const QRect& s = rects[j];
+            QRect u = r.united(s);
+            QRect i = r.intersected(s);
+            qint64 covered = qint64(r.width()) * r.height() + qint64(s.width()) * s.height()
+                - (i.isEmpty() ? 0 : qint64(i.width()) * i.height());
+            if (i.isValid() || qint64(u.width()) * u.height() - covered <= mergeSlackPixels) {
+                r = u;
+                rects.remove(j);
+                changed = true;
+                break;
+            }
+        }
+    } while (changed);
+    rects.append(r);
+}
+
+void packDirtyRectangles(QByteArray& pixels, const unsigned int* frame, int frameWidth,
+        const QVector<QRect>& rects)
+{
+    for (int i = 0; i < rects.size(); i++) {
+        QRect r = rects[i];
+        for (int y = r.y(); y < r.y() + r.height(); y++) {
+            pixels.append(reinterpret_cast<const char *>(&frame[y * frameWidth + r.x()]),
+                    r.width() * sizeof(unsigned int));
+        }
+    }
+}
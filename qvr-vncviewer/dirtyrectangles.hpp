@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Computer Graphics Group, University of Siegen
+ * Written by Martin Lambers <martin.lambers@uni-siegen.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DIRTYRECTANGLES_HPP
+#define DIRTYRECTANGLES_HPP
+
+#include <QVector>
+#include <QRect>
+#include <QByteArray>
+
+/* Add a dirty rectangle to a list of dirty rectangles.
+ * The rectangle is clipped to the given bounds and greedily merged with the
+ * rectangles in the list: two rectangles are merged if the merged rectangle
+ * does not cover more than mergeSlackPixels pixels that neither of them
+ * covers. This handles overlapping and adjacent updates, and avoids the
+ * overhead of many small rectangles. No pixel is part of two rectangles in
+ * the resulting list. */
+void addDirtyRectangle(QVector<QRect>& rects, const QRect& rect, const QRect& bounds);
+
+/* Append the pixels of the given rectangles of a framebuffer with the given
+ * width to an array, rectangle by rectangle and row by row. */
+void packDirtyRectangles(QByteArray& pixels, const unsigned int* frame, int frameWidth,
+        const QVector<QRect>& rects);
+
+#endif
@@ -22,17 +22,23 @@
  */
 
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <cstdint>
 
 #include <QGuiApplication>
 #include <QKeyEvent>
 #include <QtMath>
+#include <QThread>
+#include <QMutexLocker>
+#include <QFile>
 
 #include <qvr/manager.hpp>
 #include <qvr/process.hpp>
 #include <qvr/config.hpp>
 
 #include "qvr-vncviewer.hpp"
+#include "dirtyrectangles.hpp"
 
 
 /* Global QVR application instance.
@@ -40,7 +46,27 @@
 
 static QVRVNCViewer* _qvrApp = NULL;
 
-/* VNC client callbacks */
+/* The thread that handles the VNC protocol */
+
+class VNCClientThread : public QThread
+{
+private:
+    QVRVNCViewer* _app;
+
+public:
+    VNCClientThread(QVRVNCViewer* app) : _app(app)
+    {
+        setObjectName("VNC client");
+    }
+
+    void run() override
+    {
+        _app->vncLoop();
+    }
+};
+
+/* VNC client callbacks. These are called from the VNC client thread, except
+ * during initialization. */
 
 rfbBool vncResizeCallback(rfbClient* client)
 {
@@ -100,6 +126,10 @@ static void removeArgs(int& argc, char* argv[], int i, int n)
     argc -= n;
 }
 
+/* The maximum deviation of the tessellated curved screen from the true
+ * surface, in pixels. The tessellation is chosen per view accordingly. */
+static const float maxPixelError = 0.5f;
+
 /* The VNC Viewer application */
 
 QVRVNCViewer::QVRVNCViewer(int& argc, char* argv[]) :
@@ -107,8 +137,18 @@ QVRVNCViewer::QVRVNCViewer(int& argc, char* argv[]) :
     _argc(argc),
     _argv(argv),
     _vncClient(NULL),
+    _vncThread(NULL),
+    _vncThreadQuit(0),
+    _vncBackWidth(0),
+    _vncBackHeight(0),
     _vncWidth(0),
-    _vncHeight(0)
+    _vncHeight(0),
+    _vncTexWidth(0),
+    _vncTexHeight(0),
+    _pboIndex(0),
+    _compressUpdates(false),
+    _recordUpdatesFileName(),
+    _recordUpdatesFile(NULL)
 {
     _qvrApp = this;
     bool haveScreenDef = false;
@@ -134,6 +174,15 @@ QVRVNCViewer::QVRVNCViewer(int& argc, char* argv[]) :
             haveValidScreenDef = parseCylinder(_argv[i] + 11, _screenCylinder);
             _screenType = screenTypeCylinder;
             removeArgs(_argc, _argv, i, 1);
+        } else if (strcmp(_argv[i], "--compress-updates") == 0) {
+            _compressUpdates = true;
+            removeArgs(_argc, _argv, i, 1);
+        } else if (strcmp(_argv[i], "--record-updates") == 0 && i < _argc - 1) {
+            _recordUpdatesFileName = _argv[i + 1];
+            removeArgs(_argc, _argv, i, 2);
+        } else if (strncmp(_argv[i], "--record-updates=", 17) == 0) {
+            _recordUpdatesFileName = _argv[i] + 17;
+            removeArgs(_argc, _argv, i, 1);
         }
     }
     if (!haveScreenDef)
@@ -152,21 +201,54 @@ QVRVNCViewer::QVRVNCViewer(int& argc, char* argv[]) :
         _screenWall[7] = +1.0f + QVRObserverConfig::defaultEyeHeight;
         _screenWall[8] = -3.0f;
     }
+    if (_screenType == screenTypeCylinder) {
+        _curvedScreen = QVRCurvedScreen::cylinder(
+                QVector3D(_screenCylinder[0], _screenCylinder[1], _screenCylinder[2]),
+                QVector3D(_screenCylinder[3], _screenCylinder[4], _screenCylinder[5]),
+                _screenCylinder[6], _screenCylinder[7], _screenCylinder[8], _screenCylinder[9]);
+    }
 }
 
 unsigned int* QVRVNCViewer::vncResize(int width, int height)
 {
-    _vncWidth = width;
-    _vncHeight = height;
-    _vncFrame.resize(_vncWidth * _vncHeight);
-    _vncDirtyRectangles.clear();
-    _vncDirtyRectangles.append(QRect(0, 0, _vncWidth, _vncHeight));
-    return _vncFrame.data();
+    QMutexLocker locker(&_vncMutex);
+    _vncBackWidth = width;
+    _vncBackHeight = height;
+    _vncBackFrame.resize(_vncBackWidth * _vncBackHeight);
+    _vncBackDirtyRectangles.clear();
+    _vncBackDirtyRectangles.append(QRect(0, 0, _vncBackWidth, _vncBackHeight));
+    return _vncBackFrame.data();
 }
 
 void QVRVNCViewer::vncUpdate(const QRect& r)
 {
-    _vncDirtyRectangles.append(r);
+    QMutexLocker locker(&_vncMutex);
+    addDirtyRectangle(_vncBackDirtyRectangles, r, QRect(0, 0, _vncBackWidth, _vncBackHeight));
+    if (_recordUpdatesFile)
+        _vncBackRecordedRectangles.append(r);
+}
+
+void QVRVNCViewer::processRejoined(QVRProcess*)
+{
+    // The rejoined process has none of the previous updates, so send the
+    // complete framebuffer in the next frame.
+    QMutexLocker locker(&_vncMutex);
+    _vncBackDirtyRectangles.clear();
+    _vncBackDirtyRectangles.append(QRect(0, 0, _vncBackWidth, _vncBackHeight));
+}
+
+void QVRVNCViewer::vncLoop()
+{
+    while (!_vncThreadQuit.loadAcquire()) {
+        int i = WaitForMessage(_vncClient, 100000); // wait at most 100 ms
+        if (i < 0) {
+            qWarning("VNC connection failed");
+            break;
+        }
+        if (i > 0 && !HandleRFBServerMessage(_vncClient)) {
+            qWarning("VNC event handling failed");
+        }
+    }
 }
 
 void QVRVNCViewer::createSceneGeometry(QVector<QVector3D>& positions,
@@ -191,53 +273,36 @@ void QVRVNCViewer::createSceneGeometry(QVector<QVector3D>& positions,
         indices.append(1);
         indices.append(2);
         indices.append(3);
-    } else if (_screenType == screenTypeCylinder) {
-        QVector3D center(_screenCylinder[0], _screenCylinder[1], _screenCylinder[2]);
-        QVector3D up(_screenCylinder[3], _screenCylinder[4], _screenCylinder[5]);
-        float radius = _screenCylinder[6];
-        float phiCenter = _screenCylinder[7];
-        float phiRange = _screenCylinder[8];
-        float thetaRange = _screenCylinder[9];
-        float py = radius * std::tan(thetaRange / 2.0f);
-        QVector3D rotAxis = QVector3D::crossProduct(QVector3D(0.0f, 1.0f, 0.0f), up);
-        float rotAngle = qRadiansToDegrees(
-                std::acos(QVector3D::dotProduct(QVector3D(0.0f, 1.0f, 0.0f), up)
-                    / std::sqrt(QVector3D::dotProduct(up, up))));
-        QMatrix4x4 M;
-        M.rotate(90.0f, 0.0f, 1.0f, 0.0f);
-        M.rotate(rotAngle, rotAxis);
-        M.translate(center);
-        const int N = 1000;
-        for (int x = 0; x <= N; x++) {
-            float xf = x / static_cast<float>(N);
-            float phi = phiCenter + (xf - 0.5f) * phiRange;
-            float px = radius * std::cos(phi);
-            float pz = radius * std::sin(phi);
-            positions.append(M * QVector3D(px, py, pz));
-            texcoords.append(QVector2D(xf, 0.0f));
-            positions.append(M * QVector3D(px, -py, pz));
-            texcoords.append(QVector2D(xf, 1.0f));
-            if (x > 0) {
-                indices.append(2 * (x - 1));
-                indices.append(2 * (x - 1) + 1);
-                indices.append(2 * x + 1);
-                indices.append(2 * (x - 1));
-                indices.append(2 * x + 1);
-                indices.append(2 * x);
-            }
-        }
     }
 }
 
+void QVRVNCViewer::serializeStaticData(QDataStream& ds) const
+{
+    ds << _compressUpdates;
+}
+
+void QVRVNCViewer::deserializeStaticData(QDataStream& ds)
+{
+    ds >> _compressUpdates;
+}
+
 void QVRVNCViewer::serializeDynamicData(QDataStream& ds) const
 {
     ds << _vncWidth << _vncHeight;
     ds << _vncDirtyRectangles;
-    for (int i = 0; i < _vncDirtyRectangles.size(); i++) {
-        QRect r = _vncDirtyRectangles[i];
-        for (int y = r.y(); y < r.y() + r.height(); y++) {
-            ds.writeRawData(reinterpret_cast<const char *>(&_vncFrame[y * _vncWidth]),
-                    r.width() * sizeof(unsigned int));
+    if (_compressUpdates) {
+        if (_vncDirtyRectangles.size() > 0) {
+            QByteArray pixels;
+            packDirtyRectangles(pixels, _vncFrame.constData(), _vncWidth, _vncDirtyRectangles);
+            ds << qCompress(pixels, 1);
+        }
+    } else {
+        for (int i = 0; i < _vncDirtyRectangles.size(); i++) {
+            QRect r = _vncDirtyRectangles[i];
+            for (int y = r.y(); y < r.y() + r.height(); y++) {
+                ds.writeRawData(reinterpret_cast<const char *>(&_vncFrame[y * _vncWidth + r.x()]),
+                        r.width() * sizeof(unsigned int));
+            }
         }
     }
 }
@@ -247,21 +312,66 @@ void QVRVNCViewer::deserializeDynamicData(QDataStream& ds)
     ds >> _vncWidth >> _vncHeight;
     _vncFrame.resize(_vncWidth * _vncHeight);
     ds >> _vncDirtyRectangles;
-    for (int i = 0; i < _vncDirtyRectangles.size(); i++) {
-        QRect r = _vncDirtyRectangles[i];
-        for (int y = r.y(); y < r.y() + r.height(); y++) {
-            ds.readRawData(reinterpret_cast<char *>(&_vncFrame[y * _vncWidth]),
-                    r.width() * sizeof(unsigned int));
+    if (_compressUpdates) {
+        if (_vncDirtyRectangles.size() > 0) {
+            QByteArray compressedPixels;
+            ds >> compressedPixels;
+            QByteArray pixels = qUncompress(compressedPixels);
+            const char* src = pixels.constData();
+            for (int i = 0; i < _vncDirtyRectangles.size(); i++) {
+                QRect r = _vncDirtyRectangles[i];
+                for (int y = r.y(); y < r.y() + r.height(); y++) {
+                    std::memcpy(&_vncFrame[y * _vncWidth + r.x()], src,
+                            r.width() * sizeof(unsigned int));
+                    src += r.width() * sizeof(unsigned int);
+                }
+            }
+        }
+    } else {
+        for (int i = 0; i < _vncDirtyRectangles.size(); i++) {
+            QRect r = _vncDirtyRectangles[i];
+            for (int y = r.y(); y < r.y() + r.height(); y++) {
+                ds.readRawData(reinterpret_cast<char *>(&_vncFrame[y * _vncWidth + r.x()]),
+                        r.width() * sizeof(unsigned int));
+            }
         }
     }
 }
 
 void QVRVNCViewer::update(const QList<QVRObserver*>&)
 {
+    // Take over the updates that the VNC client thread decoded into the back
+    // framebuffer since the last frame. Only the dirty rectangles are copied.
+    // The VNC client thread may already decode the next update of a region
+    // while we copy it; that region is then reported again, so any tearing
+    // is gone in the next frame.
     _vncDirtyRectangles.clear();
-    int i = WaitForMessage(_vncClient, 1);
-    if (i > 0 && !HandleRFBServerMessage(_vncClient)) {
-        qWarning("VNC event handling failed");
+    QMutexLocker locker(&_vncMutex);
+    if (_vncBackWidth != _vncWidth || _vncBackHeight != _vncHeight) {
+        _vncWidth = _vncBackWidth;
+        _vncHeight = _vncBackHeight;
+        _vncFrame.resize(_vncWidth * _vncHeight);
+    }
+    for (int i = 0; i < _vncBackDirtyRectangles.size(); i++) {
+        QRect r = _vncBackDirtyRectangles[i];
+        for (int y = r.y(); y < r.y() + r.height(); y++) {
+            std::memcpy(&_vncFrame[y * _vncWidth + r.x()], &_vncBackFrame[y * _vncWidth + r.x()],
+                    r.width() * sizeof(unsigned int));
+        }
+    }
+    _vncDirtyRectangles.swap(_vncBackDirtyRectangles);
+    if (_recordUpdatesFile && _vncBackRecordedRectangles.size() > 0) {
+        // One line per frame: the framebuffer size and the update rectangles
+        // as received from the VNC server; see benchmarks/bench-updates.cpp
+        _vncRecordedRectangles.swap(_vncBackRecordedRectangles);
+        _vncBackRecordedRectangles.clear();
+        locker.unlock();
+        std::fprintf(_recordUpdatesFile, "%d %d", _vncWidth, _vncHeight);
+        for (int i = 0; i < _vncRecordedRectangles.size(); i++) {
+            QRect r = _vncRecordedRectangles[i];
+            std::fprintf(_recordUpdatesFile, " %d,%d,%d,%d", r.x(), r.y(), r.width(), r.height());
+        }
+        std::fprintf(_recordUpdatesFile, "\n");
     }
 }
 
@@ -286,6 +396,14 @@ bool QVRVNCViewer::initProcess(QVRProcess* p)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _vncWidth, _vncHeight, 0,
             GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+    _vncTexWidth = _vncWidth;
+    _vncTexHeight = _vncHeight;
+
+    glGenBuffers(3, _pbos);
+    for (int i = 0; i < 3; i++) {
+        _pboSizes[i] = 0;
+        _pboFences[i] = 0;
+    }
 
     glGenVertexArrays(1, &_screenVao);
     glBindVertexArray(_screenVao);
@@ -308,8 +426,15 @@ bool QVRVNCViewer::initProcess(QVRProcess* p)
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
     _screenIndices = indices.size();
-
-    _prg.addShaderFromSourceFile(QOpenGLShader::Vertex, ":vertex-shader.glsl");
+    // Curved screens are generated in the vertex shader and need no vertex
+    // attributes, so they are drawn with a VAO that has none enabled.
+    glGenVertexArrays(1, &_curvedScreenVao);
+
+    QFile vsFile(":vertex-shader.glsl");
+    vsFile.open(QIODevice::ReadOnly);
+    QString vs = QString("#version 330\n") + QVRCurvedScreen::glslFunctions()
+        + QString::fromUtf8(vsFile.readAll());
+    _prg.addShaderFromSourceCode(QOpenGLShader::Vertex, vs);
     _prg.addShaderFromSourceFile(QOpenGLShader::Fragment, ":fragment-shader.glsl");
     _prg.link();
 
@@ -329,23 +454,93 @@ bool QVRVNCViewer::initProcess(QVRProcess* p)
             qCritical("Cannot initialize VNC client");
             return false;
         }
+        if (!_recordUpdatesFileName.isEmpty()) {
+            _recordUpdatesFile = std::fopen(qPrintable(_recordUpdatesFileName), "w");
+            if (!_recordUpdatesFile)
+                qWarning("Cannot open %s", qPrintable(_recordUpdatesFileName));
+        }
+        _vncThread = new VNCClientThread(this);
+        _vncThread->start();
     }
 
     return true;
 }
 
+void QVRVNCViewer::exitProcess(QVRProcess* /* p */)
+{
+    if (_vncThread) {
+        _vncThreadQuit.storeRelease(1);
+        _vncThread->wait();
+        delete _vncThread;
+        _vncThread = NULL;
+    }
+    if (_recordUpdatesFile) {
+        std::fclose(_recordUpdatesFile);
+        _recordUpdatesFile = NULL;
+    }
+}
+
 void QVRVNCViewer::preRenderProcess(QVRProcess* /* p */)
 {
-    GLint vncTexWidth, vncTexHeight;
+    // Only upload what changed. After a resize, that is everything.
+    QRect bounds(0, 0, _vncWidth, _vncHeight);
+    QVector<QRect> rects;
     glBindTexture(GL_TEXTURE_2D, _vncTex);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &vncTexWidth);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &vncTexHeight);
-    if (vncTexWidth != _vncWidth || vncTexHeight != _vncHeight) {
+    if (_vncTexWidth != _vncWidth || _vncTexHeight != _vncHeight) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _vncWidth, _vncHeight, 0,
                 GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+        _vncTexWidth = _vncWidth;
+        _vncTexHeight = _vncHeight;
+        rects.append(bounds);
+    } else {
+        rects = _vncDirtyRectangles; // already merged and clipped
+    }
+    if (rects.isEmpty() || bounds.isEmpty())
+        return;
+
+    // Pack the rectangles into the next PBO of the ring, one after the other.
+    // The GPU may still read from the other PBOs while we write into this one.
+    int size = 0;
+    for (int r = 0; r < rects.size(); r++)
+        size += rects[r].width() * rects[r].height() * sizeof(unsigned int);
+    const int i = _pboIndex;
+    _pboIndex = (_pboIndex + 1) % 3;
+    if (_pboFences[i]) {
+        glClientWaitSync(_pboFences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(_pboFences[i]);
+        _pboFences[i] = 0;
     }
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _vncWidth, _vncHeight,
-            GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, _vncFrame.data());
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbos[i]);
+    if (size > _pboSizes[i]) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        _pboSizes[i] = size;
+    }
+    char* ptr = static_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    Q_ASSERT(ptr);
+    QVector<int> offsets(rects.size());
+    int offset = 0;
+    for (int r = 0; r < rects.size(); r++) {
+        const QRect& rect = rects[r];
+        offsets[r] = offset;
+        for (int y = rect.y(); y < rect.y() + rect.height(); y++) {
+            std::memcpy(ptr + offset, &_vncFrame[y * _vncWidth + rect.x()],
+                    rect.width() * sizeof(unsigned int));
+            offset += rect.width() * sizeof(unsigned int);
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int r = 0; r < rects.size(); r++) {
+        const QRect& rect = rects[r];
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rect.width());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(offsets[r])));
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    _pboFences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 void QVRVNCViewer::render(QVRWindow* /* w */,
@@ -364,10 +559,21 @@ void QVRVNCViewer::render(QVRWindow* /* w */,
         glUseProgram(_prg.programId());
         _prg.setUniformValue("pmv_matrix", P * V);
         _prg.setUniformValue("vnc_tex", 0);
+        _prg.setUniformValue("curved_screen", _screenType != screenTypeWall);
         // Render
-        glBindVertexArray(_screenVao);
         glBindTexture(GL_TEXTURE_2D, _vncTex);
-        glDrawElements(GL_TRIANGLES, _screenIndices, GL_UNSIGNED_INT, 0);
+        if (_screenType == screenTypeWall) {
+            glBindVertexArray(_screenVao);
+            glDrawElements(GL_TRIANGLES, _screenIndices, GL_UNSIGNED_INT, 0);
+        } else {
+            glBindVertexArray(_curvedScreenVao);
+            // Tessellate the curved screen just finely enough for this view
+            int columns, rows;
+            _curvedScreen.tessellation(QVRCurvedScreen::pixelsPerRadian(context, view),
+                    maxPixelError, &columns, &rows);
+            _curvedScreen.setUniforms(_prg, columns, rows);
+            glDrawArrays(GL_TRIANGLES, 0, QVRCurvedScreen::vertexCount(columns, rows));
+        }
     }
 }
 
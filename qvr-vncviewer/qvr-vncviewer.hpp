@@ -24,13 +24,19 @@
 #ifndef QVR_VNCVIEWER_HPP
 #define QVR_VNCVIEWER_HPP
 
+#include <cstdio>
+
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLShaderProgram>
+#include <QMutex>
+#include <QAtomicInt>
 
 #include <qvr/app.hpp>
+#include <qvr/curvedscreen.hpp>
 
 #include <rfb/rfbclient.h>
 
+class VNCClientThread;
 
 class QVRVNCViewer : public QVRApp, protected QOpenGLExtraFunctions
 {
@@ -48,38 +54,69 @@ private:
     int _screenType;
     float _screenWall[9];
     float _screenCylinder[10];
-    // VNC objects
+    QVRCurvedScreen _curvedScreen;
+    // VNC objects. The VNC client thread decodes into the back framebuffer,
+    // and update() copies the dirty rectangles to the front framebuffer,
+    // which is used for serialization and rendering.
     rfbClient* _vncClient;
+    VNCClientThread* _vncThread;
+    QAtomicInt _vncThreadQuit;
+    QMutex _vncMutex;            // protects the back framebuffer and its dirty list
+    int _vncBackWidth;
+    int _vncBackHeight;
+    QVector<unsigned int> _vncBackFrame;
+    QVector<QRect> _vncBackDirtyRectangles;
+    QVector<QRect> _vncBackRecordedRectangles; // unmerged, only with --record-updates
     int _vncWidth;
     int _vncHeight;
     QVector<unsigned int> _vncFrame; // 32 bit BGRA pixels
     QVector<QRect> _vncDirtyRectangles;
+    QVector<QRect> _vncRecordedRectangles;
     // OpenGL objects
     unsigned int _fbo;
     unsigned int _vncTex;
+    int _vncTexWidth;
+    int _vncTexHeight;
+    unsigned int _pbos[3];      // ring of PBOs for dirty rectangle upload
+    int _pboSizes[3];           // allocated sizes of the PBOs
+    GLsync _pboFences[3];       // signaled when the GPU is done reading a PBO
+    int _pboIndex;              // index of the next PBO to use
+    // Distribution of framebuffer updates to child processes
+    bool _compressUpdates;
+    QString _recordUpdatesFileName;
+    FILE* _recordUpdatesFile;   // record of the VNC updates, for benchmarks
     unsigned int _screenVao;
-    unsigned int _screenIndices;
+    unsigned int _screenIndices; // only for walls; curved screens are generated in the vertex shader
+    unsigned int _curvedScreenVao; // without vertex attributes, for curved screens
     QOpenGLShaderProgram _prg;
 
     /* Helper functions for VNC callbacks */
     unsigned int* vncResize(int width, int height);
     void vncUpdate(const QRect& r);
+    void vncLoop();
+    friend class VNCClientThread;
     friend rfbBool vncResizeCallback(rfbClient* client);
     friend void vncUpdateCallback(rfbClient* client, int x, int y, int w, int h);
 
-    /* Helper function to create the screen geometry */
+    /* Helper function to create the wall geometry */
     void createSceneGeometry(QVector<QVector3D>& positions,
             QVector<QVector2D>& texcoords, QVector<unsigned int>& indices);
 
 public:
+    void serializeStaticData(QDataStream& ds) const override;
+    void deserializeStaticData(QDataStream& ds) override;
+
     void serializeDynamicData(QDataStream& ds) const override;
     void deserializeDynamicData(QDataStream& ds) override;
 
+    void processRejoined(QVRProcess* p) override;
+
     void update(const QList<QVRObserver*>& observers) override;
 
     bool wantExit() override;
 
     bool initProcess(QVRProcess* p) override;
+    void exitProcess(QVRProcess* p) override;
 
     void preRenderProcess(QVRProcess* p) override;
 
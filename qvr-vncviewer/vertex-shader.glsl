@@ -21,9 +21,10 @@
  * SOFTWARE.
  */
 
-#version 330
+// The #version line and the QVRCurvedScreen functions are prepended at runtime
 
 uniform mat4 pmv_matrix;
+uniform bool curved_screen;
 
 layout(location = 0) in vec4 pos;
 layout(location = 1) in vec2 texcoord;
@@ -32,6 +33,13 @@ smooth out vec2 vtexcoord;
 
 void main(void)
 {
-    vtexcoord = texcoord;
-    gl_Position = pmv_matrix * pos;
+    if (curved_screen) {
+        vec2 tc;
+        gl_Position = pmv_matrix * qvr_curved_screen_vertex(tc);
+        // the top row of the VNC framebuffer has texture coordinate 0
+        vtexcoord = vec2(tc.s, 1.0 - tc.t);
+    } else {
+        vtexcoord = texcoord;
+        gl_Position = pmv_matrix * pos;
+    }
 }